@@ -0,0 +1,228 @@
+
+#include "App/IngestPipeline.h"
+
+#include <g3log/g3log.hpp>
+
+#include "util/Timer.h"
+#include "util/settings.h"
+
+#include "IOWrapper/RawFrameSource.h"
+
+namespace lsd_slam {
+
+  IngestPipeline::IngestPipeline( const Configuration &conf,
+                                  const std::shared_ptr<libvideoio::ImageSource> &dataSource,
+                                  const std::shared_ptr<libvideoio::Undistorter> &undistorter,
+                                  const std::shared_ptr<UndistortMap> &undistortMap )
+    : _conf( conf ),
+      _dataSource( dataSource ),
+      _undistorter( undistorter ),
+      _undistortMap( undistortMap ),
+      _slots( std::max( 2, conf.ingestQueueDepth ) ),
+      _nextToPrepare( 0 ),
+      _nextToHandOut( 0 ),
+      _endOfInput( false ),
+      _stop( false ),
+      _prepared( 0 ),
+      _highWater( 0 )
+  {
+    for( auto &s : _slots ) {
+      s.state = FREE;
+      s.seq = 0;
+      s.view = nullptr;
+    }
+
+    _reader = std::thread( &IngestPipeline::readerLoop, this );
+    for( int i = 0; i < std::max( 1, conf.ingestThreads ); ++i )
+      _workers.push_back( std::thread( &IngestPipeline::workerLoop, this ) );
+  }
+
+  IngestPipeline::~IngestPipeline()
+  {
+    stop();
+  }
+
+  void IngestPipeline::stop()
+  {
+    _stop = true;
+    _slotFreed.notifyAll();
+    _slotRead.notifyAll();
+    _slotDone.notifyAll();
+
+    if( _reader.joinable() ) _reader.join();
+    for( auto &w : _workers )
+      if( w.joinable() ) w.join();
+  }
+
+  template< typename Pred >
+  bool IngestPipeline::waitUntil( EventCount &ec, Pred pred )
+  {
+    while( !pred() ) {
+      if( _stop ) return false;
+
+      uint32_t key = ec.prepareWait();
+      if( pred() || _stop )
+        ec.cancelWait();
+      else
+        ec.wait( key );
+    }
+    return true;
+  }
+
+  void IngestPipeline::readerLoop()
+  {
+    const float fps = _dataSource->fps();
+    const int numFrames = _dataSource->numFrames();
+
+    // raw frame files carry their timestamps
+    auto rawSource = std::dynamic_pointer_cast<RawFrameSource>( _dataSource );
+
+    int frameId = 0;
+    double fakeTimeStamp = 0;
+
+    size_t seq = 0;
+    for( ; (numFrames < 0) || (seq < (size_t)numFrames); ++seq )
+    {
+      Slot &s = slot( seq );
+      if( !waitUntil( _slotFreed, [&]() { return s.state.load() == FREE; } ) ) return;
+
+      Timer timer;
+      s.view = nullptr;
+      if( !_dataSource->grab() )
+        s.status = -1;
+      else if( rawSource && _undistortMap ) {
+        // the fused undistortion only reads the image, straight from the mapping.
+        s.view = rawSource->data();
+        s.status = 1;
+      } else if( _dataSource->getImage( s.raw ) < 0 )
+        s.status = 0;
+      else {
+        CHECK(s.raw.type() == CV_8UC1);
+        s.status = 1;
+      }
+
+      if( s.status > 0 ) {
+        s.frameId = frameId++;
+        s.timestamp = rawSource ? rawSource->timestamp() : fakeTimeStamp;
+        fakeTimeStamp += (fps > 0) ? (1.0/fps) : 0.03;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock( _statsMutex );
+        _readMs.update( timer );
+      }
+
+      s.seq = seq;
+      s.state = READ;
+      _slotRead.notifyAll();
+
+      if( s.status < 0 && _conf.stopOnFailedRead ) { ++seq; break; }
+    }
+
+    Slot &s = slot( seq );
+    if( !waitUntil( _slotFreed, [&]() { return s.state.load() == FREE; } ) ) return;
+
+    s.status = Item::EndOfInput;
+    s.seq = seq;
+    s.state = READ;
+    _slotRead.notifyAll();
+  }
+
+  void IngestPipeline::workerLoop()
+  {
+    while( !_stop )
+    {
+      size_t seq = _nextToPrepare.fetch_add( 1 );
+      Slot &s = slot( seq );
+      if( !waitUntil( _slotRead, [&]() { return s.state.load() == READ && s.seq == seq; } ) ) return;
+
+      if( s.status > 0 ) {
+        Timer timer;
+        if( _undistortMap ) {
+          s.frame.reset( new Frame( s.frameId, _conf, s.timestamp, s.view ? s.view : s.raw.data, *_undistortMap ) );
+          {
+            std::lock_guard<std::mutex> lock( _statsMutex );
+            _undistortMs.update( timer );
+          }
+          timer.reset();
+        } else {
+          _undistorter->undistort( s.raw, s.image );
+          {
+            std::lock_guard<std::mutex> lock( _statsMutex );
+            _undistortMs.update( timer );
+          }
+          timer.reset();
+          s.frame.reset( new Frame( s.frameId, _conf, s.timestamp, s.image.data ) );
+        }
+
+        // what tracking (levels SE3TRACKING_MIN_LEVEL and up) and mapping
+        // (level 0) will ask for first.
+        if( _conf.ingestPrebuildPyramids ) {
+          for( int level = 0; level < SE3TRACKING_MAX_LEVEL; ++level ) {
+            s.frame->image( level );
+            s.frame->gradients( level );
+          }
+          s.frame->maxGradients( 0 );
+        }
+
+        std::lock_guard<std::mutex> lock( _statsMutex );
+        _prepareMs.update( timer );
+      }
+
+      s.state = DONE;
+
+      int prepared = ++_prepared;
+      int highWater = _highWater;
+      while( prepared > highWater && !_highWater.compare_exchange_weak( highWater, prepared ) )
+        ;
+
+      _slotDone.notifyAll();
+    }
+  }
+
+  bool IngestPipeline::next( Item &item )
+  {
+    if( _endOfInput ) return false;
+
+    Slot &s = slot( _nextToHandOut );
+
+    Timer timer;
+    if( !waitUntil( _slotDone, [&]() { return s.state.load() == DONE && s.seq == _nextToHandOut; } ) ) return false;
+
+    {
+      std::lock_guard<std::mutex> lock( _statsMutex );
+      _waitMs.update( timer );
+    }
+
+    // the end marker was counted as prepared like any other slot.
+    if( s.status == Item::EndOfInput ) {
+      --_prepared;
+      _endOfInput = true;
+      return false;
+    }
+
+    item.status = s.status;
+    item.frame = std::move( s.frame );
+    s.frame.reset();
+
+    // the caller may hold on to the image, so the slot gets a new one.
+    item.image = s.image;
+    s.image.release();
+
+    --_prepared;
+    ++_nextToHandOut;
+    s.state = FREE;
+    _slotFreed.notifyAll();
+
+    return true;
+  }
+
+  void IngestPipeline::logStats()
+  {
+    std::lock_guard<std::mutex> lock( _statsMutex );
+    LOGF(INFO, "Ingest: %d frames ready (max %d), %d workers; read %.1fms, undistort %.1fms, prepare %.1fms, tracking waited %.1fms",
+         (int)_prepared, (int)_highWater, (int)_workers.size(),
+         _readMs.value(), _undistortMs.value(), _prepareMs.value(), _waitMs.value() );
+  }
+
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+#include "util/EventCount.h"
+#include "util/MovingAverage.h"
+#include "util/Configuration.h"
+#include "util/UndistortMap.h"
+
+#include "DataStructures/Frame.h"
+
+#include "libvideoio/ImageSource.h"
+#include "libvideoio/Undistorter.h"
+
+namespace lsd_slam {
+
+  // Prepares input frames ahead of tracking.
+  //
+  // One reader thread grabs (and decodes) images from the ImageSource in
+  // order. Worker threads undistort them, convert them into Frames and
+  // optionally build their pyramids. Given an UndistortMap, the workers
+  // undistort straight into the Frames' float images instead. next() hands the prepared frames out
+  // in input order, from a reorder buffer of Configuration::ingestQueueDepth
+  // slots that also bounds how far ahead the reader may run.
+  class IngestPipeline {
+  public:
+
+    struct Item {
+      enum { EndOfInput = -2 };
+
+      Frame::SharedPtr frame;
+      cv::Mat image;            // undistorted 8 bit image, empty with an UndistortMap
+      int status;               // 1: frame prepared, 0: no image, -1: grab failed
+    };
+
+    IngestPipeline( const Configuration &conf,
+                    const std::shared_ptr<libvideoio::ImageSource> &dataSource,
+                    const std::shared_ptr<libvideoio::Undistorter> &undistorter,
+                    const std::shared_ptr<UndistortMap> &undistortMap = nullptr );
+    ~IngestPipeline();
+
+    IngestPipeline( const IngestPipeline & ) = delete;
+    IngestPipeline &operator=( const IngestPipeline & ) = delete;
+
+    // Blocks until the next item in input order is ready. Returns false
+    // at the end of the input.
+    bool next( Item &item );
+
+    // Stops and joins all threads. Called by the destructor.
+    void stop();
+
+    // number of prepared frames waiting for next(), and its maximum.
+    int queued() const { return _prepared; }
+    int highWater() const { return _highWater; }
+
+    // Logs queue depth and the mean time per frame spent in each stage.
+    void logStats();
+
+  private:
+
+    enum SlotState { FREE = 0, READ, DONE };
+
+    struct Slot {
+      std::atomic<int> state;
+      std::atomic<size_t> seq;
+
+      cv::Mat raw;
+      const unsigned char *view;    // read-only frame of a RawFrameSource, instead of raw
+      cv::Mat image;
+      int status;
+      int frameId;
+      double timestamp;
+      Frame::SharedPtr frame;
+    };
+
+    void readerLoop();
+    void workerLoop();
+
+    Slot &slot( size_t seq ) { return _slots[seq % _slots.size()]; }
+
+    // waits on ec until pred() holds. Returns false if stopped meanwhile.
+    template< typename Pred >
+    bool waitUntil( EventCount &ec, Pred pred );
+
+    const Configuration &_conf;
+    std::shared_ptr<libvideoio::ImageSource> _dataSource;
+    std::shared_ptr<libvideoio::Undistorter> _undistorter;
+    std::shared_ptr<UndistortMap> _undistortMap;
+
+    std::vector<Slot> _slots;
+
+    std::atomic<size_t> _nextToPrepare;   // claimed by workers
+    size_t _nextToHandOut;                // consumer only
+    bool _endOfInput;                     // consumer only: EndOfInput handed out
+
+    std::atomic<bool> _stop;
+    EventCount _slotFreed, _slotRead, _slotDone;
+
+    std::thread _reader;
+    std::vector<std::thread> _workers;
+
+    std::atomic<int> _prepared;
+    std::atomic<int> _highWater;
+
+    std::mutex _statsMutex;
+    MsAverage _readMs, _undistortMs, _prepareMs, _waitMs;
+  };
+
+}
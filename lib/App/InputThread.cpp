@@ -12,7 +12,8 @@ namespace lsd_slam {
     : system( sys ), dataSource( src ), undistorter( und ),
     inputDone( false ),
     inputReady(),
-    output( nullptr )
+    output( nullptr ),
+    undistortMap( nullptr )
     {
       ;
     }
@@ -22,6 +23,11 @@ namespace lsd_slam {
       output = out;
     }
 
+    void InputThread::setUndistortMap( const std::shared_ptr<UndistortMap> &map )
+    {
+      undistortMap = map;
+    }
+
     void InputThread::operator()() {
       // get HZ
       float fps = dataSource->fps();
@@ -35,9 +41,16 @@ namespace lsd_slam {
       int numFrames = dataSource->numFrames();
       LOG_IF( INFO, numFrames > 0 ) << "Running for " << numFrames << " frames at " << fps << " fps";
 
-      cv::Mat image = cv::Mat(system->conf().slamImage.cvSize(), CV_8U);
       int runningIdx=0;
-      float fakeTimeStamp = 0;
+
+      // Images are read, undistorted and converted to Frames ahead of
+      // tracking by the ingest pipeline, which hands them out in order.
+      IngestPipeline ingest( system->conf(), dataSource, undistorter, undistortMap );
+      IngestPipeline::Item next;
+
+      const bool pipelined = (fps == 0) && system->conf().offlinePipelined;
+
+      Timer wallTime, statsTime;
 
       for(unsigned int i = 0; (numFrames < 0) || (i < (unsigned int)numFrames); ++i)
       {
@@ -45,25 +58,26 @@ namespace lsd_slam {
 
         std::chrono::time_point<std::chrono::steady_clock> start(std::chrono::steady_clock::now());
 
-        if( dataSource->grab() ) {
-          if( dataSource->getImage( image ) >= 0 ) {
-            CHECK(image.type() == CV_8UC1);
+        if( !ingest.next( next ) ) break;
 
-            cv::Mat imageUndist;
-            undistorter->undistort(image, imageUndist);
+        if( next.status > 0 ) {
+          system->trackFrame( next.frame, fps == 0 );
 
-            system->trackFrame( new Frame( runningIdx, system->conf(), fakeTimeStamp, imageUndist.data ), fps == 0 );
+          runningIdx++;
 
-            runningIdx++;
-            fakeTimeStamp += (fps > 0) ? (1.0/fps) : 0.03;
-
-            if( output ) {
-              output->updateFrameNumber( runningIdx );
-              output->updateLiveImage( imageUndist );
-            }
+          if( output ) {
+            // the fused undistortion only produces the float image.
+            if( next.image.empty() )
+              cv::Mat( system->conf().slamImage.cvSize(), CV_32F, next.frame->image(0) ).convertTo( next.image, CV_8U );
 
+            output->updateFrameNumber( runningIdx );
+            output->updateLiveImage( next.image );
           }
+          next.frame.reset();
+          next.image.release();
+        }
 
+        if( next.status >= 0 ) {
           if(fullResetRequested)
           {
             LOG(WARNING) << "FULL RESET!";
@@ -78,9 +92,21 @@ namespace lsd_slam {
           if( system->conf().stopOnFailedRead ) break;
         }
 
+        if( statsTime.stop() > 1.0 ) {
+          ingest.logStats();
+          statsTime.reset();
+        }
+
         if( dt_us > 0 ) std::this_thread::sleep_until( start + std::chrono::microseconds( dt_us + dt_wiggle ) );
       }
 
+      ingest.stop();
+      ingest.logStats();
+      float seconds = wallTime.stop();
+      LOG(INFO) << "Processed " << runningIdx << " frames in " << seconds << " s: "
+                << (seconds > 0 ? runningIdx / seconds : 0) << " frames/second end to end"
+                << (pipelined ? " (pipelined)" : "");
+
       LOG(INFO) << "Have processed all input frames.";
       inputDone.assignValue(true);
     }
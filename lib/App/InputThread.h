@@ -5,6 +5,7 @@
 #include "util/ThreadMutexObject.h"
 
 #include "SlamSystem.h"
+#include "App/IngestPipeline.h"
 
 #include "libvideoio/ImageSource.h"
 #include "libvideoio/Undistorter.h"
@@ -20,6 +21,9 @@ namespace lsd_slam {
 
     void setIOOutputWrapper( const std::shared_ptr<lsd_slam::OutputIOWrapper> &out );
 
+    // Undistort through this map instead of the libvideoio undistorter.
+    void setUndistortMap( const std::shared_ptr<UndistortMap> &map );
+
     // Entry point for boost::thread
     void operator()();
 
@@ -32,6 +36,6 @@ namespace lsd_slam {
 
   protected:
     std::shared_ptr<lsd_slam::OutputIOWrapper> output;
-
+    std::shared_ptr<UndistortMap> undistortMap;
   };
 }
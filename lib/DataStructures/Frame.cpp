@@ -25,13 +25,15 @@
 
 #include "DataStructures/FramePoseStruct.h"
 
+#include <atomic>
 #include <g3log/g3log.hpp>
 
 
 namespace lsd_slam
 {
 
-int privateFrameAllocCount = 0;
+// Frames are built concurrently on the IngestPipeline workers.
+std::atomic<int> privateFrameAllocCount( 0 );
 
 Frame::Frame(int frameId, const Configuration &conf,
 							double timestamp, const unsigned char* image )
@@ -83,6 +85,29 @@ Frame::Frame(int frameId, const Configuration &conf,
 						<< ", now there are " << privateFrameAllocCount;
 }
 
+Frame::Frame(int frameId, const Configuration &conf,
+							double timestamp, const unsigned char* rawImage, const UndistortMap &undistort )
+	: 	pose( new FramePoseStruct(*this) ),
+			data( frameId, timestamp, conf.camera, conf.slamImage ),
+			_trackingParent( nullptr ),
+			_conf( conf )
+{
+	initialize(timestamp);
+
+	CHECK( undistort.outputSize().width == data.width[0] && undistort.outputSize().height == data.height[0] )
+					<< "Undistortion map doesn't produce the slam image size";
+
+	data.image[0] = FrameMemory::getInstance().getFloatBuffer(data.width[0]*data.height[0]);
+	undistort.remap( rawImage, data.image[0], conf.undistortThreads );
+	data.imageValid[0] = true;
+
+	privateFrameAllocCount++;
+
+	LOG_IF(INFO, enablePrintDebugInfo && printMemoryDebugInfo)
+						<< "ALLOCATED frame " << id()
+						<< ", now there are " << privateFrameAllocCount;
+}
+
 
 
 void Frame::initialize(double timestamp)
@@ -100,6 +125,7 @@ void Frame::initialize(double timestamp)
 	// data.cyInv[0] = data.KInv[0](1,2);
 
 	depthHasBeenUpdatedFlag = false;
+	depthVersion = 0;
 
 	referenceID = -1;
 	referenceLevel = -1;
@@ -107,10 +133,6 @@ void Frame::initialize(double timestamp)
 	numMappablePixels = -1;
 
 
-	permaRefNumPts = 0;
-	permaRef_colorAndVarData = 0;
-	permaRef_posData = 0;
-
 	meanIdepth = 1;
 	numPoints = 0;
 
@@ -151,13 +173,10 @@ Frame::~Frame()
 	FrameMemory::getInstance().returnBuffer(data.idepth_reAct);
 	FrameMemory::getInstance().returnBuffer(data.idepthVar_reAct);
 
-	if(permaRef_colorAndVarData != 0)
-		delete permaRef_colorAndVarData;
-	if(permaRef_posData != 0)
-		delete permaRef_posData;
+	permaRef.release();
 
 	privateFrameAllocCount--;
-	LOGF_IF(DEBUG, enablePrintDebugInfo && printMemoryDebugInfo, "DELETED frame %d, now there are %d\n", this->id(), privateFrameAllocCount);
+	LOGF_IF(DEBUG, enablePrintDebugInfo && printMemoryDebugInfo, "DELETED frame %d, now there are %d\n", this->id(), (int)privateFrameAllocCount);
 }
 
 bool Frame::isTrackingParent( const SharedPtr &other )
@@ -215,24 +234,7 @@ void Frame::setPermaRef(TrackingReference* reference)
 	reference->makePointCloud(QUICK_KF_CHECK_LVL);
 
 	permaRef_mutex.lock();
-
-	if(permaRef_colorAndVarData != 0)
-		delete permaRef_colorAndVarData;
-	if(permaRef_posData != 0)
-		delete permaRef_posData;
-
-	permaRefNumPts = reference->numData[QUICK_KF_CHECK_LVL];
-	permaRef_colorAndVarData = new Eigen::Vector2f[permaRefNumPts];
-	permaRef_posData = new Eigen::Vector3f[permaRefNumPts];
-
-	memcpy(permaRef_colorAndVarData,
-			reference->colorAndVarData[QUICK_KF_CHECK_LVL],
-			sizeof(Eigen::Vector2f) * permaRefNumPts);
-
-	memcpy(permaRef_posData,
-			reference->posData[QUICK_KF_CHECK_LVL],
-			sizeof(Eigen::Vector3f) * permaRefNumPts);
-
+	permaRef.copyFrom(reference->points[QUICK_KF_CHECK_LVL]);
 	permaRef_mutex.unlock();
 }
 
@@ -303,6 +305,38 @@ void Frame::setDepth(const DepthMapPixelHypothesis* newDepth)
 	release(IDEPTH | IDEPTH_VAR, true, true);
 	data.hasIDepthBeenSet = true;
 	depthHasBeenUpdatedFlag = true;
+	depthVersion++;
+}
+
+Frame::SharedPtr Frame::snapshot()
+{
+	boost::shared_lock<boost::shared_mutex> lock = getActiveLock();
+
+	SharedPtr copy( new Frame( id(), _conf, timestamp(), image(0) ) );
+	copy->pose->setFixed( getCamToWorld() );
+
+	if( !hasIDepthBeenSet() ) return copy;
+
+	// builds level 0 if it was minimized, before taking buildMutex.
+	idepth(0);
+	idepthVar(0);
+
+	const int size = data.width[0]*data.height[0];
+	copy->data.idepth[0] = FrameMemory::getInstance().getFloatBuffer(size);
+	copy->data.idepthVar[0] = FrameMemory::getInstance().getFloatBuffer(size);
+
+	// setDepth() writes level 0 while holding buildMutex.
+	boost::unique_lock<boost::mutex> lock2(buildMutex);
+	memcpy(copy->data.idepth[0], data.idepth[0], size*sizeof(float));
+	memcpy(copy->data.idepthVar[0], data.idepthVar[0], size*sizeof(float));
+	copy->meanIdepth = meanIdepth;
+	copy->numPoints = numPoints;
+
+	copy->data.idepthValid[0] = true;
+	copy->data.idepthVarValid[0] = true;
+	copy->data.hasIDepthBeenSet = true;
+
+	return copy;
 }
 
 void Frame::setDepthFromGroundTruth(const float* depth, float cov_scale)
@@ -353,6 +387,7 @@ void Frame::setDepthFromGroundTruth(const float* depth, float cov_scale)
 	// Invalidate higher levels, they need to be updated with the new data
 	release(IDEPTH | IDEPTH_VAR, true, true);
 	data.hasIDepthBeenSet = true;
+	depthVersion++;
 }
 
 void Frame::prepareForStereoWith(Frame* other, Sim3 thisToOther, const Eigen::Matrix3f& K, const int level)
@@ -25,9 +25,11 @@
 #include <boost/thread/shared_mutex.hpp>
 #include "DataStructures/FramePoseStruct.h"
 #include "DataStructures/FrameMemory.h"
+#include "Tracking/TrackingPointCloud.h"
 #include "unordered_set"
 #include "util/settings.h"
 #include "util/Configuration.h"
+#include "util/UndistortMap.h"
 
 namespace lsd_slam
 {
@@ -51,12 +53,19 @@ public:
 
 	Frame(int id, const Configuration &conf, double timestamp, const float* image );
 
+	/** Undistorts the raw (input sized) image straight into level 0. */
+	Frame(int id, const Configuration &conf, double timestamp, const unsigned char* rawImage, const UndistortMap &undistort );
+
 	~Frame();
 
 
 	/** Sets or updates idepth and idepthVar on level zero. Invalidates higher levels. */
 	void setDepth(const DepthMapPixelHypothesis* newDepth);
 
+	/** Returns a copy of the level-0 image and depth and of the current pose,
+	  * which later mapping doesn't change, for output on other threads. */
+	SharedPtr snapshot();
+
 	/** Calculates mean information for statistical purposes. */
 	void calculateMeanInformation();
 
@@ -172,13 +181,15 @@ public:
 	// flag set when depth is updated.
 	bool depthHasBeenUpdatedFlag;
 
+	// incremented whenever depth is set, so data derived from it can tell
+	// whether it is stale.
+	int depthVersion;
+
 
 	// Tracking Reference for quick test. Always available, never taken out of memory.
 	// this is used for re-localization and re-Keyframe positioning.
 	boost::mutex permaRef_mutex;
-	Eigen::Vector3f* permaRef_posData;	// (x,y,z)
-	Eigen::Vector2f* permaRef_colorAndVarData;	// (I, Var)
-	int permaRefNumPts;
+	TrackingPointCloud permaRef;	// copy of the QUICK_KF_CHECK_LVL point cloud
 
 
 
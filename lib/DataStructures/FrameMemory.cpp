@@ -20,6 +20,8 @@
 
 #include "DataStructures/FrameMemory.h"
 #include "DataStructures/Frame.h"
+#include <stdlib.h>
+#include <new>
 
 namespace lsd_slam
 {
@@ -27,6 +29,7 @@ namespace lsd_slam
 
 
 FrameMemory::FrameMemory()
+	: _bytesInUse(0)
 {
 }
 
@@ -51,7 +54,7 @@ void FrameMemory::releaseBuffes()
 
 		for(unsigned int i=0;i<p.second.size();i++)
 		{
-			delete (char*)p.second[i];
+			free(p.second[i]);
 			bufferSizes.erase(p.second[i]);
 		}
 
@@ -67,6 +70,7 @@ void FrameMemory::releaseBuffes()
 void* FrameMemory::getBuffer(unsigned int sizeInByte)
 {
 	boost::unique_lock<boost::mutex> lock(accessMutex);
+	_bytesInUse += sizeInByte;
 
 	if (availableBuffers.count(sizeInByte) > 0)
 	{
@@ -106,6 +110,7 @@ void FrameMemory::returnBuffer(void* buffer)
 	boost::unique_lock<boost::mutex> lock(accessMutex);
 
 	unsigned int size = bufferSizes.at(buffer);
+	_bytesInUse -= size;
 	//printf("returnFloatBuffer(%d)\n", size);
 	if (availableBuffers.count(size) > 0)
 		availableBuffers.at(size).push_back(buffer);
@@ -117,11 +122,24 @@ void FrameMemory::returnBuffer(void* buffer)
 	}
 }
 
+size_t FrameMemory::bytesInUse()
+{
+	boost::unique_lock<boost::mutex> lock(accessMutex);
+	return _bytesInUse;
+}
+
+bool FrameMemory::overBudget()
+{
+	return frameMemoryBudgetMB > 0 && bytesInUse() > frameMemoryBudgetMB * 1000000.0f;
+}
+
 void* FrameMemory::allocateBuffer(unsigned int size)
 {
 	//printf("allocateFloatBuffer(%d)\n", size);
 
-	void* buffer = (void*)(new char[size]);
+	void* buffer = 0;
+	if(posix_memalign(&buffer, FRAME_MEMORY_ALIGNMENT, size) != 0)
+		throw std::bad_alloc();
 	bufferSizes.insert(std::make_pair(buffer, size));
 	return buffer;
 }
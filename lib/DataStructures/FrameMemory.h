@@ -30,6 +30,10 @@
 namespace lsd_slam
 {
 
+/** Alignment (in bytes) of every buffer handed out by FrameMemory.
+  * 32 covers both SSE and AVX aligned loads. */
+#define FRAME_MEMORY_ALIGNMENT 32
+
 /** Singleton class for re-using buffers in the Frame class. */
 class Frame;
 class FrameMemory
@@ -49,6 +53,13 @@ public:
 	/** Returns an allocated buffer back to the global storage for re-use.
 	  * Corresponds to "delete[] buffer". */
 	void returnBuffer(void* buffer);
+
+	/** Bytes currently handed out, i.e. not counting returned buffers kept for re-use. */
+	size_t bytesInUse();
+
+	/** True if bytesInUse() exceeds frameMemoryBudgetMB. Caches built on
+	  * FrameMemory buffers shrink while this holds. */
+	bool overBudget();
 	
 
 	boost::shared_lock<boost::shared_mutex> activateFrame(Frame* frame);
@@ -63,6 +74,7 @@ private:
 	boost::mutex accessMutex;
 	std::unordered_map< void*, unsigned int > bufferSizes;
 	std::unordered_map< unsigned int, std::vector< void* > > availableBuffers;
+	size_t _bytesInUse;
 
 
 	boost::mutex activeFramesMutex;
@@ -22,10 +22,13 @@
 #include <DataStructures/FramePoseStruct.h>
 #include "DataStructures/Frame.h"
 
+#include <vector>
+
 namespace lsd_slam
 {
 
-int FramePoseStruct::cacheValidCounter = 0;
+std::atomic<int> FramePoseStruct::cacheValidCounter(0);
+std::atomic<int> FramePoseStruct::rawChangeCounter(0);
 
 
 int privateFramePoseStructAllocCount = 0;
@@ -34,6 +37,7 @@ FramePoseStruct::FramePoseStruct( Frame &f )
 	:frame( f )
 {
 	cacheValidFor = -1;
+	_rawVersion = 0;
 	isOptimized = false;
 	thisToParent_raw = camToWorld = camToWorld_new = Sim3();
 	isRegisteredToGraph = false;
@@ -77,29 +81,61 @@ void FramePoseStruct::applyPoseGraphOptResult()
 }
 void FramePoseStruct::invalidateCache()
 {
-	cacheValidFor = -1;
+	// the cached poses of frames tracked on this one are stale as well.
+	cacheValidCounter++;
+	_rawVersion++;
+	rawChangeCounter++;
 }
 
-Sim3 FramePoseStruct::getCamToWorld(int recursionDepth)
+void FramePoseStruct::setFixed(const Sim3 &fixedCamToWorld)
 {
-	// prevent stack overflow
-	assert(recursionDepth < 5000);
+	camToWorld = fixedCamToWorld;
+	isOptimized = true;
+}
 
+Sim3 FramePoseStruct::getCamToWorld()
+{
 	// if the node is in the graph, it's absolute pose is only changed by optimization.
 	if(isOptimized) return camToWorld;
 
+	int valid = cacheValidCounter;
 
 	// return chached pose, if still valid.
-	if(cacheValidFor == cacheValidCounter)
+	if(cacheValidFor == valid)
 		return camToWorld;
 
-	// return id if there is no parent (very first frame)
-	if( frame.hasTrackingParent() ) {
-			// abs. pose is computed from the parent's abs. pose, and cached.
-			cacheValidFor = cacheValidCounter;
-			return camToWorld = frame.trackingParent()->getCamToWorld(recursionDepth+1) * thisToParent_raw;
-	} else {
-		return camToWorld = Sim3();}
+	// walk up to the first pose that is known, then compute and cache the
+	// ones below it on the way back.
+	std::vector<FramePoseStruct*> chain;
+	FramePoseStruct* p = this;
+	Sim3 pCamToWorld;
+	while(true)
+	{
+		if(p->isOptimized || p->cacheValidFor == valid)
+		{
+			pCamToWorld = p->camToWorld;
+			break;
+		}
+
+		// id if there is no parent (very first frame)
+		if(!p->frame.hasTrackingParent())
+		{
+			pCamToWorld = p->camToWorld = Sim3();
+			break;
+		}
+
+		chain.push_back(p);
+		p = p->frame.trackingParent()->pose.get();
+	}
+
+	for(int i=chain.size()-1;i>=0;i--)
+	{
+		pCamToWorld = pCamToWorld * chain[i]->thisToParent_raw;
+		chain[i]->camToWorld = pCamToWorld;
+		chain[i]->cacheValidFor = valid;
+	}
+
+	return pCamToWorld;
 }
 
 }
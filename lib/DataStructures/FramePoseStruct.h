@@ -20,6 +20,7 @@
 
 #pragma once
 #include <memory>
+#include <atomic>
 
 #include "util/SophusUtil.h"
 #include "GlobalMapping/g2oTypeSim3Sophus.h"
@@ -60,12 +61,24 @@ public:
 	void setPoseGraphOptResult(Sim3 camToWorld);
 	void applyPoseGraphOptResult();
 
-	Sim3 getCamToWorld(int recursionDepth = 0);
+	Sim3 getCamToWorld();
+
+	/** Call after changing thisToParent_raw. */
 	void invalidateCache();
 
+	/** Pins the pose to camToWorld, for frames outside the graph (snapshots). */
+	void setFixed(const Sim3 &camToWorld);
+
+	/** Number of invalidateCache() calls on this pose / on all poses. */
+	int rawVersion() const { return _rawVersion; }
+	static int rawChanges() { return rawChangeCounter; }
+
 private:
-	int cacheValidFor;
-	static int cacheValidCounter;
+	std::atomic<int> cacheValidFor;
+	static std::atomic<int> cacheValidCounter;
+
+	std::atomic<int> _rawVersion;
+	static std::atomic<int> rawChangeCounter;
 
 	// absolute position (camToWorld).
 	// can change when optimization offset is merged.
@@ -0,0 +1,180 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DataStructures/TrackedFrameQueue.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace lsd_slam
+{
+
+static size_t ringCapacity(int bound)
+{
+	size_t capacity = 2;
+	while(capacity < 2*(size_t)std::max(1, bound))
+		capacity *= 2;
+	return capacity;
+}
+
+
+TrackedFrameQueue::TrackedFrameQueue(int bound, Policy policy)
+	: _bound(std::max(1, bound)),
+	  _policy(policy),
+	  slots(ringCapacity(bound)),
+	  mask(slots.size()-1),
+	  head(0),
+	  tail(0),
+	  waiting(0),
+	  _highWater(0),
+	  _pushed(0),
+	  _dropped(0),
+	  _blockedUs(0)
+{
+}
+
+bool TrackedFrameQueue::push(const Frame::SharedPtr &frame, bool mayBlock)
+{
+	size_t t = tail.load(std::memory_order_relaxed);
+	size_t h = head.load();
+
+	bool block = mayBlock && _policy == Configuration::MAPPING_QUEUE_BLOCK;
+	size_t limit = block ? _bound : slots.size();
+	if(t - h >= limit)
+	{
+		if(!block)
+		{
+			_dropped++;
+			return false;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		{
+			std::unique_lock<std::mutex> lock(waitMutex);
+			waiting++;
+			while(t - (h = head.load()) >= limit)
+				waitSignal.wait(lock);
+			waiting--;
+		}
+		_blockedUs += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	slots[t & mask] = frame;
+	tail.store(t+1);
+	_pushed++;
+
+	int depth = t+1 - h;
+	int highWater = _highWater;
+	while(depth > highWater && !_highWater.compare_exchange_weak(highWater, depth))
+		;
+
+	return true;
+}
+
+int TrackedFrameQueue::trim()
+{
+	size_t h = head.load(std::memory_order_relaxed);
+	size_t t = tail.load();
+	int excess = (int)(t - h) - _bound;
+	if(excess <= 0 || _policy == Configuration::MAPPING_QUEUE_BLOCK)
+		return 0;
+
+	if(_policy == Configuration::MAPPING_QUEUE_BEST_BASELINE)
+	{
+		// drop the frames closest to their keyframe, but always keep the
+		// newest. Kept frames move to the back, in order.
+		std::vector<std::pair<double, size_t> > baselines;
+		for(size_t i=h;i+1<t;i++)
+			baselines.push_back(std::make_pair(slots[i & mask]->pose->thisToParent_raw.translation().squaredNorm(), i));
+		std::nth_element(baselines.begin(), baselines.begin() + excess, baselines.end());
+
+		for(int i=0;i<excess;i++)
+		{
+			slots[baselines[i].second & mask]->clear_refPixelWasGood();
+			slots[baselines[i].second & mask].reset();
+		}
+
+		size_t write = t;
+		for(size_t read = t; read-- > h; )
+			if(slots[read & mask])
+			{
+				write--;
+				if(write != read)
+					slots[write & mask].swap(slots[read & mask]);
+			}
+	}
+	else
+	{
+		for(size_t i=h;i<h+excess;i++)
+			slots[i & mask]->clear_refPixelWasGood();
+	}
+
+	_dropped += excess;
+	advanceHead(h + excess);
+	return excess;
+}
+
+TrackedFrameQueue::Batch TrackedFrameQueue::batch() const
+{
+	size_t h = head.load(std::memory_order_relaxed);
+	return Batch(slots.data(), mask, h, tail.load() - h);
+}
+
+Frame::SharedPtr TrackedFrameQueue::popFront()
+{
+	size_t h = head.load(std::memory_order_relaxed);
+	if(h == tail.load())
+		return Frame::SharedPtr();
+
+	Frame::SharedPtr frame;
+	frame.swap(slots[h & mask]);
+	advanceHead(h+1);
+	return frame;
+}
+
+void TrackedFrameQueue::clear()
+{
+	advanceHead(tail.load());
+}
+
+void TrackedFrameQueue::waitUntilEmpty()
+{
+	std::unique_lock<std::mutex> lock(waitMutex);
+	waiting++;
+	while(!empty())
+		waitSignal.wait(lock);
+	waiting--;
+}
+
+void TrackedFrameQueue::advanceHead(size_t newHead)
+{
+	for(size_t i=head.load(std::memory_order_relaxed);i<newHead;i++)
+		slots[i & mask].reset();
+	head.store(newHead);
+
+	if(waiting > 0)
+	{
+		// pairs with the check under the lock in the waiting thread.
+		{ std::lock_guard<std::mutex> lock(waitMutex); }
+		waitSignal.notify_all();
+	}
+}
+
+}
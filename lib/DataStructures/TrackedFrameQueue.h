@@ -0,0 +1,158 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <stddef.h>
+
+#include "DataStructures/Frame.h"
+#include "util/Configuration.h"
+
+
+namespace lsd_slam
+{
+
+/**
+ * Bounded single-producer / single-consumer ring of tracked frames
+ * waiting to be mapped.
+ *
+ * push() and the consumer side never lock; only blocking waits use the
+ * mutex. One thread pushes at a time (tracking, or mapping while it hands
+ * over a relocalization result) and one thread consumes (mapping).
+ *
+ * With MAPPING_QUEUE_BLOCK, push() waits while bound frames are queued.
+ * With the other policies it never waits: the consumer trims the queue
+ * back to bound with trim(), and push() only drops the new frame if the
+ * ring (2 x bound) is full because trim() has not run for that long.
+ */
+class TrackedFrameQueue
+{
+public:
+	typedef Configuration::MappingQueuePolicy Policy;
+
+	/** Zero-copy view of the queued frames, oldest first. Only valid on the
+	 *  consumer thread, until it calls popFront(), trim() or clear(). */
+	class Batch
+	{
+	public:
+		class const_iterator
+		{
+		public:
+			const_iterator(const Batch* batch, size_t i) : batch(batch), i(i) {}
+			const Frame::SharedPtr &operator*() const { return (*batch)[i]; }
+			const Frame::SharedPtr *operator->() const { return &(*batch)[i]; }
+			const_iterator &operator++() { i++; return *this; }
+			bool operator!=(const const_iterator &other) const { return i != other.i; }
+			bool operator==(const const_iterator &other) const { return i == other.i; }
+		private:
+			const Batch* batch;
+			size_t i;
+		};
+
+		size_t size() const { return num; }
+		bool empty() const { return num == 0; }
+
+		const Frame::SharedPtr &operator[](size_t i) const { return slots[(first + i) & mask]; }
+		const Frame::SharedPtr &front() const { return (*this)[0]; }
+		const Frame::SharedPtr &back() const { return (*this)[num-1]; }
+
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, num); }
+
+	private:
+		friend class TrackedFrameQueue;
+		Batch(const Frame::SharedPtr* slots, size_t mask, size_t first, size_t num)
+			: slots(slots), mask(mask), first(first), num(num) {}
+
+		const Frame::SharedPtr* slots;
+		size_t mask;
+		size_t first;
+		size_t num;
+	};
+
+	TrackedFrameQueue(int bound, Policy policy);
+
+	//=== producer ===
+
+	/** Queues frame. Returns false if it was dropped. With mayBlock false,
+	 *  the blocking policy only drops frames once the ring is full. */
+	bool push(const Frame::SharedPtr &frame, bool mayBlock = true);
+
+	//=== consumer ===
+
+	/** Drops frames down to bound according to the policy. Returns the
+	 *  number of frames dropped. */
+	int trim();
+
+	Batch batch() const;
+	Frame::SharedPtr popFront();
+	void clear();
+
+	//=== any thread ===
+
+	/** Blocks until the consumer has emptied the queue. */
+	void waitUntilEmpty();
+
+	/** Frames queued. head is loaded first: it never passes tail, and tail
+	 *  only grows, so the difference can't wrap on other threads. */
+	size_t size() const
+	{
+		const size_t h = head.load(std::memory_order_acquire);
+		const size_t t = tail.load(std::memory_order_acquire);
+		return t > h ? t - h : 0;
+	}
+	bool empty() const { return size() == 0; }
+
+	int bound() const { return _bound; }
+	Policy policy() const { return _policy; }
+
+	// metrics
+	int highWater() const { return _highWater; }
+	int pushed() const { return _pushed; }
+	int dropped() const { return _dropped; }
+	float blockedMs() const { return _blockedUs * 0.001f; }
+
+private:
+	// release popped slots and wake waiting threads.
+	void advanceHead(size_t newHead);
+
+	const int _bound;
+	const Policy _policy;
+
+	std::vector<Frame::SharedPtr> slots;
+	const size_t mask;
+
+	std::atomic<size_t> head;	// written by the consumer
+	std::atomic<size_t> tail;	// written by the producer
+
+	std::mutex waitMutex;
+	std::condition_variable waitSignal;
+	std::atomic<int> waiting;
+
+	std::atomic<int> _highWater;
+	std::atomic<int> _pushed;
+	std::atomic<int> _dropped;
+	std::atomic<long> _blockedUs;
+};
+
+}
@@ -23,6 +23,7 @@
 #include <stdio.h>
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include <g3log/g3log.hpp>
@@ -49,6 +50,9 @@ DepthMap::DepthMap( const Configuration &conf )
 
 	activeKeyFrameIsReactivated = false;
 
+	observeStride = 1;
+	observePhase = 0;
+
 	const ImageSize &imgSize( _conf.slamImage );
 	const size_t imgArea( imgSize.area() );
 	const cv::Size imgCvSize( imgSize.cvSize() );
@@ -60,7 +64,6 @@ DepthMap::DepthMap( const Configuration &conf )
 	debugImageHypothesisHandling = cv::Mat( imgCvSize, CV_8UC3);
 	debugImageHypothesisPropagation = cv::Mat(imgCvSize, CV_8UC3);
 	debugImageStereoLines = cv::Mat(imgCvSize, CV_8UC3);
-	debugImageDepth = cv::Mat(imgCvSize, CV_8UC3);
 
 	reset();
 
@@ -83,7 +86,6 @@ DepthMap::~DepthMap()
 	debugImageHypothesisHandling.release();
 	debugImageHypothesisPropagation.release();
 	debugImageStereoLines.release();
-	debugImageDepth.release();
 
 	delete[] otherDepthMap;
 	delete[] currentDepthMap;
@@ -109,6 +111,11 @@ void DepthMap::observeDepthRow(int yMin, int yMax, RunningStats* stats)
 
 	int successes = 0;
 
+	// pixels (x,y) with x + rowShift*y + observePhase divisible by the stride
+	// are observed; a checkerboard for a stride of 2.
+	const int stride = observeStride;
+	const int rowShift = std::max(1, stride/2);
+
 	for(int y=yMin;y<yMax; y++)
 		for(int x=3;x<_conf.slamImage.width-3;x++)
 		{
@@ -126,6 +133,8 @@ void DepthMap::observeDepthRow(int yMin, int yMax, RunningStats* stats)
 			if(keyFrameMaxGradBuf[idx] < MIN_ABS_GRAD_CREATE || target->blacklisted < MIN_BLACKLIST)
 				continue;
 
+			if(stride > 1 && (x + rowShift*y + observePhase) % stride != 0)
+				continue;
 
 			bool success;
 			if(!hasHypothesis)
@@ -143,6 +152,7 @@ void DepthMap::observeDepth()
 {
 
 	threadReducer.reduce(boost::bind(&DepthMap::observeDepthRow, this, _1, _2, _3), 3, _conf.slamImage.height-3, 10);
+	observePhase = (observePhase + 1) % observeStride;
 
 	LOGF_IF(DEBUG, printObserveStatistics, "OBSERVE (%d): %d / %d created; %d / %d updated; %d skipped; %d init-blacklisted",
 			activeKeyFrame->id(),
@@ -1073,7 +1083,7 @@ void DepthMap::resetCounters()
 
 
 
-void DepthMap::updateKeyframe(std::deque< Frame::SharedPtr > referenceFrames)
+void DepthMap::updateKeyframe(const TrackedFrameQueue::Batch &referenceFrames)
 {
 	assert(isValid());
 
@@ -1086,7 +1096,7 @@ void DepthMap::updateKeyframe(std::deque< Frame::SharedPtr > referenceFrames)
 	referenceFrameByID.clear();
 	referenceFrameByID_offset = oldest_referenceFrame->id();
 
-	for(std::shared_ptr<Frame> frame : referenceFrames)
+	for(const Frame::SharedPtr &frame : referenceFrames)
 	{
 		assert(frame->hasTrackingParent());
 
@@ -1362,35 +1372,28 @@ void DepthMap::finalizeKeyFrame()
 
 
 
-int DepthMap::debugPlotDepthMap()
+bool DepthMap::snapshotForDisplay( DepthMapRenderer::Snapshot &snap )
 {
-	if(activeKeyFrame == 0) return 1;
-
-	cv::Mat keyFrameImage(activeKeyFrame->height(), activeKeyFrame->width(), CV_32F, const_cast<float*>(activeKeyFrameImageData));
-	cv::Mat keyFrameGray( keyFrameImage.size(), CV_8UC1 );
-	keyFrameImage.convertTo(keyFrameGray, CV_8UC1);
-	cv::cvtColor(keyFrameGray, debugImageDepth, CV_GRAY2RGB);
-
-	// debug plot & publish sparse version?
-	int refID = referenceFrameByID_offset;
+	if(activeKeyFrame == 0) return false;
 
+	const int size = _conf.slamImage.area();
+	snap.resize( _conf.slamImage.width, _conf.slamImage.height );
+	snap.mode = _conf.debugDisplay;
+	snap.markBlacklisted = (_conf.debugDisplay == 2);
 
-	for(int y=0;y<(_conf.slamImage.height);y++)
-		for(int x=0;x<(_conf.slamImage.width);x++)
-		{
-			int idx = x + y*_conf.slamImage.width;
+	memcpy(snap.image.data(), activeKeyFrameImageData, size*sizeof(float));
 
-			if(currentDepthMap[idx].blacklisted < MIN_BLACKLIST && _conf.debugDisplay == 2)
-				debugImageDepth.at<cv::Vec3b>(y,x) = cv::Vec3b(0,0,255);
-
-			if(!currentDepthMap[idx].isValid) continue;
-
-			cv::Vec3b color = currentDepthMap[idx].getVisualizationColor(refID);
-			debugImageDepth.at<cv::Vec3b>(y,x) = color;
-		}
+	int refID = referenceFrameByID_offset;
+	const float invalid = std::numeric_limits<float>::quiet_NaN();
 
+	for(int idx=0;idx<size;idx++)
+	{
+		const DepthMapPixelHypothesis &hyp = currentDepthMap[idx];
+		snap.blacklisted[idx] = hyp.blacklisted < MIN_BLACKLIST;
+		snap.value[idx] = hyp.isValid ? DepthMapRenderer::displayValue( hyp, snap.mode, refID ) : invalid;
+	}
 
-	return 1;
+	return true;
 }
 
 
@@ -29,6 +29,8 @@
 #include "util/Timer.h"
 
 #include "DataStructures/Frame.h"
+#include "DataStructures/TrackedFrameQueue.h"
+#include "DepthEstimation/DepthMapRenderer.h"
 
 
 
@@ -57,7 +59,13 @@ public:
 	/**
 	 * does obervation and regularization only.
 	 **/
-	void updateKeyframe(std::deque< std::shared_ptr<Frame> > referenceFrames);
+	void updateKeyframe(const TrackedFrameQueue::Batch &referenceFrames);
+
+	/**
+	 * Only runs stereo on every stride-th pixel per update, on a pattern
+	 * that shifts with each update so all pixels are covered over time.
+	 **/
+	void setObserveStride(int stride) { observeStride = std::max(1, stride); }
 
 	/**
 	 * does propagation and whole-filling-regularization (no observation, for that need to call updateKeyframe()!)
@@ -72,13 +80,13 @@ public:
 	void invalidate();
 	inline bool isValid() {return (bool)activeKeyFrame;};
 
-	int debugPlotDepthMap();
+	/** Copies what DepthMapRenderer needs to draw the current depth map. Returns false without a keyframe. */
+	bool snapshotForDisplay( DepthMapRenderer::Snapshot &snap );
 
 	// ONLY for debugging, their memory is managed (created & deleted) by this object.
 	cv::Mat debugImageHypothesisHandling;
 	cv::Mat debugImageHypothesisPropagation;
 	cv::Mat debugImageStereoLines;
-	cv::Mat debugImageDepth;
 
 	void initializeFromGTDepth( const std::shared_ptr<Frame> &new_frame);
 	void initializeRandomly( const std::shared_ptr<Frame> &new_frame);
@@ -124,6 +132,10 @@ private:
 	std::vector< Frame::SharedPtr > referenceFrameByID;
 	int referenceFrameByID_offset;
 
+	// see setObserveStride().
+	int observeStride;
+	int observePhase;
+
 	// ============= internally used buffers for intermediate calculations etc. =============
 	// for internal depth tracking, their memory is managed (created & deleted) by this object.
 	DepthMapPixelHypothesis* otherDepthMap;
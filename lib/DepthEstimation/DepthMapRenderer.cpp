@@ -0,0 +1,274 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DepthEstimation/DepthMapRenderer.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "util/globalFuncs.h"
+
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace lsd_slam
+{
+
+void DepthMapRenderer::Snapshot::resize( int w, int h )
+{
+	width = w;
+	height = h;
+	image.resize( w*h );
+	value.resize( w*h );
+	blacklisted.resize( w*h );
+}
+
+DepthMapRenderer::DepthMapRenderer( const Configuration &conf, const PublishFunc &publish )
+	: _conf( conf ),
+		_publish( publish ),
+		_image( conf.slamImage.cvSize(), CV_8UC3 ),
+		_lutMode( -1 ),
+		_lutLog( false ),
+		_lutMin( 0 ),
+		_lutScale( 1 ),
+		_filling( false ),
+		_pending( false ),
+		_running( true ),
+		_rendered( 0 )
+{
+	_thread = std::thread( &DepthMapRenderer::renderLoop, this );
+}
+
+DepthMapRenderer::~DepthMapRenderer()
+{
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_running = false;
+	}
+	_cond.notify_all();
+	_thread.join();
+}
+
+DepthMapRenderer::Snapshot *DepthMapRenderer::beginSnapshot()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+
+	if( _filling || _pending ) return nullptr;
+	if( _conf.depthMapDisplayHz > 0 && _rendered > 0 && _lastRender.stop() < 1.0 / _conf.depthMapDisplayHz ) return nullptr;
+
+	_filling = true;
+	return &_snapshot;
+}
+
+void DepthMapRenderer::submit()
+{
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_filling = false;
+		_pending = true;
+	}
+	_cond.notify_all();
+}
+
+void DepthMapRenderer::cancel()
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	_filling = false;
+}
+
+float DepthMapRenderer::renderMs() const
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	return _renderMs.value();
+}
+
+void DepthMapRenderer::renderLoop()
+{
+	while( true )
+	{
+		{
+			std::unique_lock<std::mutex> lock( _mutex );
+			_cond.wait( lock, [this]() { return _pending || !_running; } );
+			if( !_running ) return;
+			_lastRender.reset();
+		}
+
+		// the mapping thread doesn't touch the snapshot while it is pending.
+		Timer timer;
+		render( _snapshot, _image );
+
+		if( _conf.onSceenInfoDisplay )
+			printMessageOnCVImage( _image, _snapshot.info, "" );
+
+		_publish( _image );
+
+		std::lock_guard<std::mutex> lock( _mutex );
+		_renderMs.update( timer );
+		_pending = false;
+		++_rendered;
+	}
+}
+
+// colour of a hypothesis showing value in the given mode.
+static uint32_t visualizationColor( int mode, float value )
+{
+	DepthMapPixelHypothesis h( value, value, value, value, (int)value, mode );
+	h.nextStereoFrameMinID = value;
+
+	cv::Vec3b c = h.getVisualizationColor( 0 );
+	return c[0] | (c[1] << 8) | (c[2] << 16);
+}
+
+void DepthMapRenderer::buildLut( int mode )
+{
+	_lutMode = mode;
+	_lutLog = (mode == 3 || mode == 4);
+
+	if( _lutLog ) {
+		// variances: colour depends on log10, so 7 mantissa bits are plenty.
+		_lut.resize( 1 << 15 );
+		for( uint32_t i = 0; i < _lut.size(); ++i ) {
+			uint32_t bits = (i << 16) | 0x8000;
+			float v;
+			memcpy( &v, &bits, sizeof(v) );
+			_lut[i] = visualizationColor( mode, v );
+		}
+		return;
+	}
+
+	// inverse depths change colour every 1/255, the others are integers.
+	int bins;
+	bool integral = true;
+	switch( mode ) {
+		case 0: case 1: _lutScale = 256; bins = 4*256; integral = false; break;
+		case 2: _lutScale = 1; bins = VALIDITY_COUNTER_MAX + VALIDITY_COUNTER_MAX_VARIABLE + 1; break;
+		case 5: _lutScale = 1; bins = 101; break;
+		default: _lutScale = 1; bins = 1; break;
+	}
+	_lutMin = 0;
+
+	_lut.resize( bins + 1 );
+	_lut[0] = visualizationColor( mode, _lutMin - 1 );
+	for( int i = 0; i < bins; ++i )
+		_lut[i+1] = visualizationColor( mode, _lutMin + (i + (integral ? 0.0f : 0.5f)) / _lutScale );
+}
+
+void DepthMapRenderer::render( const Snapshot &snap, cv::Mat &out )
+{
+	if( snap.mode != _lutMode ) buildLut( snap.mode );
+
+	if( out.rows != snap.height || out.cols != snap.width )
+		out.create( snap.height, snap.width, CV_8UC3 );
+
+	const int size = snap.width * snap.height;
+	const uint32_t red = 255 << 16;			// cv::Vec3b(0,0,255)
+	const int lastBin = _lut.size() - 1;
+
+	unsigned char *dst = out.data;
+	uint32_t colours[8];
+
+	int i = 0;
+
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+	const __m256 lutMin = _mm256_set1_ps( _lutMin );
+	const __m256 lutScale = _mm256_set1_ps( _lutScale );
+	const __m256 maxBin = _mm256_set1_ps( lastBin - 1 );
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256i one = _mm256_set1_epi32( 1 );
+	const __m256i grayScale = _mm256_set1_epi32( 0x010101 );
+	const __m256i redColour = _mm256_set1_epi32( snap.markBlacklisted ? red : 0 );
+	const __m256i byteMax = _mm256_set1_epi32( 255 );
+
+	for( ; i + 8 <= size; i += 8 )
+	{
+		__m256 v = _mm256_loadu_ps( &snap.value[i] );
+		__m256i valid = _mm256_castps_si256( _mm256_cmp_ps( v, v, _CMP_ORD_Q ) );
+
+		__m256i idx;
+		if( _lutLog ) {
+			// negative values (sign bit set) get entry 0, like zero.
+			__m256i bits = _mm256_castps_si256( v );
+			idx = _mm256_srli_epi32( bits, 16 );
+			idx = _mm256_andnot_si256( _mm256_srai_epi32( bits, 31 ), idx );
+		} else {
+			__m256 below = _mm256_cmp_ps( v, lutMin, _CMP_LT_OQ );
+			__m256 t = _mm256_mul_ps( _mm256_sub_ps( v, lutMin ), lutScale );
+			t = _mm256_min_ps( _mm256_max_ps( t, zero ), maxBin );
+			idx = _mm256_add_epi32( _mm256_cvttps_epi32( t ), one );
+			idx = _mm256_andnot_si256( _mm256_castps_si256( below ), idx );
+		}
+		idx = _mm256_and_si256( idx, valid );
+
+		__m256i colour = _mm256_i32gather_epi32( (const int *)_lut.data(), idx, 4 );
+
+		// gray keyframe image where there is no valid hypothesis, red where
+		// blacklisted pixels are marked.
+		__m256i g = _mm256_cvtps_epi32( _mm256_loadu_ps( &snap.image[i] ) );
+		g = _mm256_min_epi32( _mm256_max_epi32( g, _mm256_setzero_si256() ), byteMax );
+		__m256i gray = _mm256_mullo_epi32( g, grayScale );
+
+		__m256i black = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i *)&snap.blacklisted[i] ) );
+		black = _mm256_cmpgt_epi32( black, _mm256_setzero_si256() );
+		black = _mm256_and_si256( black, _mm256_cmpgt_epi32( redColour, _mm256_setzero_si256() ) );
+		gray = _mm256_blendv_epi8( gray, redColour, black );
+
+		colour = _mm256_blendv_epi8( gray, colour, valid );
+		_mm256_storeu_si256( (__m256i *)colours, colour );
+
+		for( int k = 0; k < 8; ++k, dst += 3 ) {
+			dst[0] = colours[k];
+			dst[1] = colours[k] >> 8;
+			dst[2] = colours[k] >> 16;
+		}
+	}
+#endif
+
+	for( ; i < size; ++i, dst += 3 )
+	{
+		const float v = snap.value[i];
+		uint32_t colour;
+
+		if( v == v ) {
+			int idx;
+			if( _lutLog ) {
+				uint32_t bits;
+				memcpy( &bits, &v, sizeof(bits) );
+				idx = (bits & 0x80000000) ? 0 : (bits >> 16);
+			} else if( v < _lutMin ) {
+				idx = 0;
+			} else {
+				idx = 1 + (int)std::min( (v - _lutMin) * _lutScale, (float)(lastBin - 1) );
+			}
+			colour = _lut[idx];
+		} else if( snap.markBlacklisted && snap.blacklisted[i] ) {
+			colour = red;
+		} else {
+			int g = std::max( 0, std::min( 255, (int)lrintf( snap.image[i] ) ) );
+			colour = g * 0x010101;
+		}
+
+		dst[0] = colour;
+		dst[1] = colour >> 8;
+		dst[2] = colour >> 16;
+	}
+}
+
+}
@@ -0,0 +1,133 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+#include <opencv2/core/core.hpp>
+
+#include "util/Configuration.h"
+#include "util/Timer.h"
+#include "util/MovingAverage.h"
+#include "DepthEstimation/DepthMapPixelHypothesis.h"
+
+namespace lsd_slam
+{
+
+/**
+ * Renders the depth map visualization (keyframe image with the hypotheses
+ * coloured as by DepthMapPixelHypothesis::getVisualizationColor) on its
+ * own thread, from a snapshot the mapping thread takes with
+ * DepthMap::snapshotForDisplay().
+ *
+ * The colours come from a lookup table built per debugDisplay mode, the
+ * conversion runs eight pixels at a time with AVX2. Renderings are
+ * limited to Configuration::depthMapDisplayHz and skipped while the
+ * previous one is still in progress, so mapping never waits.
+ */
+class DepthMapRenderer
+{
+public:
+
+	struct Snapshot
+	{
+		int width, height;
+		int mode;							// debugDisplay
+		bool markBlacklisted;
+
+		std::vector<float> image;					// keyframe image
+		std::vector<float> value;					// what mode colours (see displayValue()), NaN if invalid
+		std::vector<unsigned char> blacklisted;
+
+		std::string info;					// printed on the image if onSceenInfoDisplay
+
+		void resize( int w, int h );
+	};
+
+	typedef std::function<void(cv::Mat &)> PublishFunc;
+
+	DepthMapRenderer( const Configuration &conf, const PublishFunc &publish );
+	~DepthMapRenderer();
+
+	/** Returns the snapshot to fill if a rendering is due, nullptr otherwise.
+	 *  Has to be followed by submit() or cancel(). */
+	Snapshot *beginSnapshot();
+	void submit();
+	void cancel();
+
+	/** The quantity getVisualizationColor() colours in the given mode. */
+	static inline float displayValue( const DepthMapPixelHypothesis &h, int mode, int lastFrameID )
+	{
+		switch( mode ) {
+			case 0: return h.idepth_smoothed;
+			case 1: return h.idepth;
+			case 2: return h.validity_counter;
+			case 3: return h.idepth_var_smoothed;
+			case 4: return h.idepth_var;
+			case 5: return h.nextStereoFrameMinID - lastFrameID;
+			default: return 0;
+		}
+	}
+
+	int rendered() const { return _rendered; }
+	float renderMs() const;
+
+private:
+
+	void renderLoop();
+
+	void buildLut( int mode );
+	void render( const Snapshot &snap, cv::Mat &out );
+
+	const Configuration &_conf;
+	PublishFunc _publish;
+
+	Snapshot _snapshot;
+	cv::Mat _image;
+
+	// packed colours (bytes 0..2 as in cv::Vec3b). Linear tables map values
+	// below _lutMin to entry 0 and [_lutMin, ...) in steps of 1/_lutScale to
+	// the entries after it; log tables are indexed by the upper 16 bits of
+	// the float value.
+	std::vector<uint32_t> _lut;
+	int _lutMode;
+	bool _lutLog;
+	float _lutMin, _lutScale;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _cond;
+	bool _filling, _pending, _running;
+	Timer _lastRender;
+
+	std::atomic<int> _rendered;
+	MsAverage _renderMs;		// under _mutex
+
+	std::thread _thread;
+};
+
+}
@@ -46,6 +46,7 @@
 // for iterating over files in a directory
 #include <dirent.h>
 #include <queue>
+#include <unordered_set>
 
 #include <iostream>
 #include <fstream>
@@ -62,13 +63,40 @@ KFConstraintStruct::~KFConstraintStruct()
 		delete edge;
 }
 
+/**
+ * CSparse solver that can keep its symbolic factorization (ordering and
+ * elimination tree) from one optimize() call to the next. Only valid while
+ * the optimizer's active vertices and edges are unchanged.
+ */
+class CachedLinearSolver : public g2o::LinearSolverCSparse<g2o::BlockSolver_7_3::PoseMatrixType>
+{
+public:
+	CachedLinearSolver() : reuseSymbolic(false) {}
+
+	void setReuseSymbolic(bool reuse) { reuseSymbolic = reuse; }
+
+	virtual bool init()
+	{
+		if(reuseSymbolic)
+			return true;
+		return g2o::LinearSolverCSparse<g2o::BlockSolver_7_3::PoseMatrixType>::init();
+	}
+
+private:
+	bool reuseSymbolic;
+};
+
+
 KeyFrameGraph::KeyFrameGraph()
-: nextEdgeId(0)
+: structureChanged(true),
+	globalOptimizationRequested(false),
+	nextEdgeId(0)
 {
 	typedef g2o::BlockSolver_7_3 BlockSolver;
-	typedef g2o::LinearSolverCSparse<BlockSolver::PoseMatrixType> LinearSolver;
+	typedef CachedLinearSolver LinearSolver;
 	//typedef g2o::LinearSolverPCG<BlockSolver::PoseMatrixType> LinearSolver;
 	LinearSolver* solver = new LinearSolver();
+	linearSolver = solver;
 	BlockSolver* blockSolver = new BlockSolver( std::unique_ptr<LinearSolver>(solver));
 	g2o::OptimizationAlgorithmLevenberg* algorithm = new g2o::OptimizationAlgorithmLevenberg(std::unique_ptr<BlockSolver>(blockSolver));
 	graph.setAlgorithm(algorithm);
@@ -83,6 +111,8 @@ KeyFrameGraph::KeyFrameGraph()
 	totalEdges=0;
 	totalVertices=0;
 
+	currentPoses = std::make_shared<PoseSnapshot>(0);
+
 
 }
 
@@ -106,9 +136,16 @@ void KeyFrameGraph::addFrame(const Frame::SharedPtr &frame)
 
 	allFramePosesMutex.lock();
 	allFramePoses.push_back(frame->pose);
+	trajectory.add(frame->pose);
 	allFramePosesMutex.unlock();
 }
 
+void KeyFrameGraph::getTrajectory(std::vector<Sim3, Eigen::aligned_allocator<Sim3> > &out)
+{
+	trajectory.update(*poseSnapshot());
+	trajectory.getAll(out);
+}
+
 void KeyFrameGraph::dumpMap(std::string folder)
 {
 	printf("DUMP MAP: dumping to %s\n", folder.c_str());
@@ -293,6 +330,9 @@ bool KeyFrameGraph::addElementsFromBuffer()
 
 	bool added = false;
 
+	// new keyframes are connected to their tracking parent for the loop closure check.
+	std::unordered_multimap<g2o::HyperGraph::Vertex*, g2o::HyperGraph::Vertex*> parentLinks;
+
 	keyframesForRetrackMutex.lock();
 	for (auto newKF : newKeyframesBuffer)
 	{
@@ -301,22 +341,54 @@ bool KeyFrameGraph::addElementsFromBuffer()
 		newKF->pose->isInGraph = true;
 
 		keyframesForRetrack.push_back(newKF);
+		windowSeeds.insert(newKF->pose->graphVertex);
+
+		if(newKF->hasTrackingParent() && newKF->trackingParent()->pose->graphVertex != nullptr)
+		{
+			g2o::HyperGraph::Vertex* parent = newKF->trackingParent()->pose->graphVertex;
+			parentLinks.insert(std::make_pair(newKF->pose->graphVertex, parent));
+			parentLinks.insert(std::make_pair(parent, newKF->pose->graphVertex));
+		}
 
 		added = true;
 	}
 	keyframesForRetrackMutex.unlock();
 
 	newKeyframesBuffer.clear();
+
+	// check against the graph before any of the buffered edges is added.
+	if(poseGraphLocalWindow > 0 && !globalOptimizationRequested)
+		for (auto edge : newEdgeBuffer)
+			if(isLoopClosure(edge->edge, parentLinks))
+			{
+				if(enablePrintDebugInfo && printOptimizationInfo)
+					printf("loop closure %d - %d, optimizing the whole graph.\n",
+							edge->firstFrame->id(), edge->secondFrame->id());
+				globalOptimizationRequested = true;
+				break;
+			}
+
 	for (auto edge : newEdgeBuffer)
 	{
 		graph.addEdge(edge->edge);
+		windowSeeds.insert(edge->edge->vertices()[0]);
+		windowSeeds.insert(edge->edge->vertices()[1]);
 		added = true;
 	}
 	newEdgeBuffer.clear();
 
+	if(added)
+		structureChanged = true;
+
 	return added;
 }
 
+void KeyFrameGraph::requestGlobalOptimization()
+{
+	globalOptimizationRequested = true;
+	structureChanged = true;
+}
+
 int KeyFrameGraph::optimize(int num_iterations)
 {
 	// Abort if graph is empty, g2o shows an error otherwise
@@ -324,11 +396,111 @@ int KeyFrameGraph::optimize(int num_iterations)
 		return 0;
 
 	graph.setVerbose(false); // printOptimizationInfo
-	graph.initializeOptimization();
 
+	bool online = !structureChanged;
+	if(structureChanged)
+	{
+		releaseLocalWindow();
+
+		if(globalOptimizationRequested || poseGraphLocalWindow <= 0)
+			graph.initializeOptimization();
+		else
+			initializeLocalWindow();
 
-	return graph.optimize(num_iterations, false);
+		if(enablePrintDebugInfo && printOptimizationInfo)
+			printf("optimizing %d of %d keyframes (%d constraints)%s.\n",
+					(int)graph.activeVertices().size(), (int)graph.vertices().size(),
+					(int)graph.activeEdges().size(), globalOptimizationRequested ? ", global" : "");
 
+		windowSeeds.clear();
+		structureChanged = false;
+		globalOptimizationRequested = false;
+	}
+
+	// everything in the window is fixed.
+	if (graph.activeEdges().size() == 0)
+		return 0;
+
+	// same active subgraph as in the last call: keep the Hessian structure
+	// and the symbolic factorization.
+	linearSolver->setReuseSymbolic(online);
+	return graph.optimize(num_iterations, online);
+
+}
+
+bool KeyFrameGraph::isLoopClosure(EdgeSim3* edge, const std::unordered_multimap<g2o::HyperGraph::Vertex*, g2o::HyperGraph::Vertex*> &parentLinks) const
+{
+	g2o::HyperGraph::Vertex* from = edge->vertices()[0];
+	g2o::HyperGraph::Vertex* to = edge->vertices()[1];
+
+	// breadth-first search up to poseGraphLocalWindow edges deep.
+	std::unordered_set<g2o::HyperGraph::Vertex*> visited;
+	std::vector<g2o::HyperGraph::Vertex*> ring, nextRing;
+	visited.insert(from);
+	ring.push_back(from);
+
+	for(int hops=0; hops<poseGraphLocalWindow && !ring.empty(); hops++)
+	{
+		nextRing.clear();
+		for(g2o::HyperGraph::Vertex* v : ring)
+		{
+			for(g2o::HyperGraph::Edge* e : v->edges())
+				for(g2o::HyperGraph::Vertex* n : e->vertices())
+					if(visited.insert(n).second)
+						nextRing.push_back(n);
+
+			auto range = parentLinks.equal_range(v);
+			for(auto link = range.first; link != range.second; ++link)
+				if(visited.insert(link->second).second)
+					nextRing.push_back(link->second);
+		}
+
+		if(visited.count(to))
+			return false;
+		ring.swap(nextRing);
+	}
+
+	return true;
+}
+
+void KeyFrameGraph::initializeLocalWindow()
+{
+	// all vertices within poseGraphLocalWindow edges of the seeds.
+	g2o::HyperGraph::VertexSet window = windowSeeds;
+	std::vector<g2o::HyperGraph::Vertex*> ring(windowSeeds.begin(), windowSeeds.end()), nextRing;
+
+	for(int hops=0; hops<=poseGraphLocalWindow && !ring.empty(); hops++)
+	{
+		nextRing.clear();
+		for(g2o::HyperGraph::Vertex* v : ring)
+			for(g2o::HyperGraph::Edge* e : v->edges())
+				for(g2o::HyperGraph::Vertex* n : e->vertices())
+					if(window.insert(n).second)
+						nextRing.push_back(n);
+
+		// the last ring is the boundary: it anchors the window to the rest of the graph.
+		if(hops == poseGraphLocalWindow)
+			for(g2o::HyperGraph::Vertex* n : nextRing)
+			{
+				VertexSim3* vertex = static_cast<VertexSim3*>(n);
+				if(!vertex->fixed())
+				{
+					vertex->setFixed(true);
+					windowFixed.push_back(vertex);
+				}
+			}
+
+		ring.swap(nextRing);
+	}
+
+	graph.initializeOptimization(window);
+}
+
+void KeyFrameGraph::releaseLocalWindow()
+{
+	for(VertexSim3* vertex : windowFixed)
+		vertex->setFixed(false);
+	windowFixed.clear();
 }
 
 
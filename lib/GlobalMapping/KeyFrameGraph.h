@@ -23,6 +23,7 @@
 #include <unordered_map>
 #include <mutex>
 #include <deque>
+#include <memory>
 
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
@@ -33,6 +34,8 @@
 #include "util/SophusUtil.h"
 
 #include "DataStructures/Frame.h"
+#include "GlobalMapping/PoseSnapshot.h"
+#include "GlobalMapping/TrajectoryStore.h"
 
 namespace lsd_slam
 {
@@ -42,6 +45,7 @@ class KeyFrameGraph;
 class VertexSim3;
 class EdgeSim3;
 class FramePoseStruct;
+class CachedLinearSolver;
 
 struct KFConstraintStruct
 {
@@ -119,10 +123,19 @@ public:
 	int size() const { return keyframesAll.size(); }
 
 	/** Optimizes the graph. Does not update the keyframe poses,
-	 *  only the vertex poses. You must call updateKeyFramePoses() afterwards. */
+	 *  only the vertex poses. You must call updateKeyFramePoses() afterwards.
+	 *
+	 *  Only the keyframes within poseGraphLocalWindow edges of the elements
+	 *  added since the last call are optimized, with the ring around them held
+	 *  fixed. The whole graph is optimized after a loop closure and when
+	 *  requested. While nothing is added, calls continue on the same subgraph
+	 *  and reuse its structure and symbolic factorization. */
 	int optimize(int num_iterations);
 	bool addElementsFromBuffer();
 
+	/** Makes the next optimize() run over the whole graph. */
+	void requestGlobalOptimization();
+
 
 	/**
 	 * Creates a hash map of keyframe -> distance to given frame.
@@ -145,6 +158,16 @@ public:
 	boost::shared_mutex keyframesAllMutex;
 	std::vector< Frame::SharedPtr > keyframesAll;
 
+	/** The poses applied by the last optimization merge. Lock-free. */
+	PoseSnapshot::ConstPtr poseSnapshot() const { return std::atomic_load(&currentPoses); }
+	void publishPoseSnapshot(const PoseSnapshot::ConstPtr &poses) { std::atomic_store(&currentPoses, poses); }
+
+	/** Hands an optimization result to the merge. A result that has not been
+	 *  taken yet is replaced. */
+	void setOptimizationResult(const PoseSnapshot::ConstPtr &poses) { std::atomic_store(&unmergedPoses, poses); }
+	/** Returns the latest optimization result once, nullptr if there is none. */
+	PoseSnapshot::ConstPtr takeOptimizationResult() { return std::atomic_exchange(&unmergedPoses, PoseSnapshot::ConstPtr()); }
+
 
 	/** Maps frame ids to keyframes. Contains ALL Keyframes allocated, including the one that currently being created. */
 	/* this is where the shared pointers of Keyframe Frames are kept, so they are not deleted ever */
@@ -164,6 +187,12 @@ public:
 	boost::shared_mutex allFramePosesMutex;
 	std::vector< FramePoseStruct::SharedPtr  > allFramePoses;
 
+	// absolute poses of allFramePoses, in the same order. Has own lock.
+	TrajectoryStore trajectory;
+
+	/** Up-to-date camToWorld of all frames in allFramePoses. */
+	void getTrajectory(std::vector<Sim3, Eigen::aligned_allocator<Sim3> > &out);
+
 
 	// contains all keyframes in graph, in some arbitrary (random) order. if a frame is re-tracked,
 	// it is put to the end of this list; frames for re-tracking are always chosen from the first third of
@@ -184,6 +213,27 @@ private:
 	std::vector< Frame::SharedPtr > newKeyframesBuffer;
 	std::vector< KFConstraintStruct* > newEdgeBuffer;
 
+	/** Whether the endpoints of edge are more than poseGraphLocalWindow
+	 *  edges apart in the graph without the buffered edges. */
+	bool isLoopClosure(EdgeSim3* edge, const std::unordered_multimap<g2o::HyperGraph::Vertex*, g2o::HyperGraph::Vertex*> &parentLinks) const;
+	void initializeLocalWindow();
+	void releaseLocalWindow();
+
+	// owned by graph.
+	CachedLinearSolver* linearSolver;
+
+	// vertices touched by elements added since the active subgraph was set up.
+	g2o::HyperGraph::VertexSet windowSeeds;
+	bool structureChanged;
+	bool globalOptimizationRequested;
+
+	// window boundary, fixed while the local window is active.
+	std::vector<VertexSim3*> windowFixed;
+
+	// only accessed through the std::atomic_* shared_ptr functions.
+	PoseSnapshot::ConstPtr currentPoses;
+	PoseSnapshot::ConstPtr unmergedPoses;
+
 
 	int nextEdgeId;
 };
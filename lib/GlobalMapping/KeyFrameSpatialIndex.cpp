@@ -0,0 +1,152 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GlobalMapping/KeyFrameSpatialIndex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace lsd_slam
+{
+
+
+KeyFrameSpatialIndex::KeyFrameSpatialIndex()
+	: version(-1)
+{
+}
+
+void KeyFrameSpatialIndex::update(const std::vector<Frame::SharedPtr> &keyframes, const PoseSnapshot &poses)
+{
+	if(poses.version != version || keyframes.size() < entries.size())
+	{
+		entries.clear();
+		grids.clear();
+		ungridded.clear();
+		version = poses.version;
+	}
+
+	for(int i=entries.size();i<(int)keyframes.size();i++)
+		insert(i, keyframes[i], poses);
+}
+
+void KeyFrameSpatialIndex::insert(int idx, const Frame::SharedPtr &keyframe, const PoseSnapshot &poses)
+{
+	Sim3 camToWorld = poses.getCamToWorld(*keyframe->pose);
+
+	entries.push_back(Entry());
+	Entry &e = entries.back();
+	e.position = camToWorld.translation();
+	e.viewingDir = camToWorld.rotationMatrix().rightCols<1>();
+	e.distFac = keyframe->meanIdepth / camToWorld.scale();
+
+	if(!(e.distFac > 0) || !std::isfinite(e.distFac))
+	{
+		ungridded.push_back(idx);
+		return;
+	}
+
+	int octave = (int)std::floor(std::log2(e.distFac));
+	Grid &grid = grids[octave];
+	if(grid.members.empty())
+		grid.cellSize = std::ldexp(1.0, -octave);
+
+	grid.members.push_back(idx);
+	grid.cells[cellKey(
+			(int64_t)std::floor(e.position[0] / grid.cellSize),
+			(int64_t)std::floor(e.position[1] / grid.cellSize),
+			(int64_t)std::floor(e.position[2] / grid.cellSize))].push_back(idx);
+}
+
+bool KeyFrameSpatialIndex::matches(const Entry &e, const Eigen::Vector3d &pos, const Eigen::Vector3d &viewingDir,
+		float distanceTH, float cosAngleTH, bool checkBothScales, float distFacReciprocal) const
+{
+	float distFac = e.distFac;
+	if(checkBothScales && distFacReciprocal < distFac) distFac = distFacReciprocal;
+	Eigen::Vector3d dist = (pos - e.position) * distFac;
+	if(dist.dot(dist) > distanceTH) return false;
+
+	return e.viewingDir.dot(viewingDir) >= cosAngleTH;
+}
+
+void KeyFrameSpatialIndex::query(const Eigen::Vector3d &pos, const Eigen::Vector3d &viewingDir,
+		float distanceTH, float cosAngleTH,
+		bool checkBothScales, float distFacReciprocal,
+		std::vector<int> &out) const
+{
+	out.clear();
+
+	for(int idx : ungridded)
+		if(matches(entries[idx], pos, viewingDir, distanceTH, cosAngleTH, checkBothScales, distFacReciprocal))
+			out.push_back(idx);
+
+	for(auto &g : grids)
+	{
+		const Grid &grid = g.second;
+
+		// smallest distFac in this grid bounds the world radius.
+		double minDistFac = std::ldexp(1.0, g.first);
+		if(checkBothScales && distFacReciprocal < minDistFac) minDistFac = distFacReciprocal;
+		double radius = std::sqrt(std::max(0.0f, distanceTH)) / minDistFac;
+
+		double numCells = 1;
+		for(int k=0;k<3;k++)
+			numCells *= std::floor((pos[k] + radius) / grid.cellSize) - std::floor((pos[k] - radius) / grid.cellSize) + 1;
+
+		// visiting the cells would be more work than checking all members
+		// (or the radius is unbounded).
+		if(!(radius >= 0 && numCells < grid.members.size()))
+		{
+			for(int idx : grid.members)
+				if(matches(entries[idx], pos, viewingDir, distanceTH, cosAngleTH, checkBothScales, distFacReciprocal))
+					out.push_back(idx);
+			continue;
+		}
+
+		int64_t lo[3], hi[3];
+		for(int k=0;k<3;k++)
+		{
+			lo[k] = (int64_t)std::floor((pos[k] - radius) / grid.cellSize);
+			hi[k] = (int64_t)std::floor((pos[k] + radius) / grid.cellSize);
+		}
+
+		for(int64_t x=lo[0];x<=hi[0];x++)
+			for(int64_t y=lo[1];y<=hi[1];y++)
+				for(int64_t z=lo[2];z<=hi[2];z++)
+				{
+					auto cell = grid.cells.find(cellKey(x,y,z));
+					if(cell == grid.cells.end()) continue;
+
+					for(int idx : cell->second)
+						if(matches(entries[idx], pos, viewingDir, distanceTH, cosAngleTH, checkBothScales, distFacReciprocal))
+							out.push_back(idx);
+				}
+	}
+
+	std::sort(out.begin(), out.end());
+}
+
+int64_t KeyFrameSpatialIndex::cellKey(int64_t x, int64_t y, int64_t z)
+{
+	// 21 bits per axis.
+	const int64_t mask = (1 << 21) - 1;
+	return ((x & mask) << 42) | ((y & mask) << 21) | (z & mask);
+}
+
+}
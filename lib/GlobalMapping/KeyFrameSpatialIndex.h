@@ -0,0 +1,98 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "util/EigenCoreInclude.h"
+#include "DataStructures/Frame.h"
+#include "GlobalMapping/PoseSnapshot.h"
+
+
+namespace lsd_slam
+{
+
+/**
+ * Hash grid over keyframe positions for the euclidean overlap search.
+ *
+ * Keyframe distances are scaled by the keyframe's own distFac
+ * (meanIdepth / scale), so keyframes are binned into one grid per power of
+ * two of distFac. In the grid of [2^o, 2^(o+1)) a cell is 2^-o wide, which
+ * is about one unit of scaled distance; a query only visits the cells its
+ * radius covers in each grid.
+ *
+ * Positions, viewing directions and distFacs are taken from the
+ * PoseSnapshot passed to update(). Everything is re-inserted when its
+ * version changes.
+ *
+ * Not thread-safe.
+ */
+class KeyFrameSpatialIndex
+{
+public:
+	KeyFrameSpatialIndex();
+
+	/** Brings the index up to date with keyframes, which may only have grown
+	 *  at the back since the last call unless the version of poses changed. */
+	void update(const std::vector<Frame::SharedPtr> &keyframes, const PoseSnapshot &poses);
+
+	/** Returns the indices (into the keyframes passed to update()) of all
+	 *  keyframes with distFac-scaled squared distance to pos <= distanceTH and
+	 *  viewing direction dot product >= cosAngleTH, in ascending order.
+	 *  With checkBothScales, the smaller of distFacReciprocal and the
+	 *  keyframe's distFac scales the distance. */
+	void query(const Eigen::Vector3d &pos, const Eigen::Vector3d &viewingDir,
+			float distanceTH, float cosAngleTH,
+			bool checkBothScales, float distFacReciprocal,
+			std::vector<int> &out) const;
+
+	int size() const { return entries.size(); }
+
+private:
+	struct Entry
+	{
+		Eigen::Vector3d position;
+		Eigen::Vector3d viewingDir;
+		float distFac;
+	};
+
+	struct Grid
+	{
+		double cellSize;
+		std::vector<int> members;
+		std::unordered_map<int64_t, std::vector<int> > cells;
+	};
+
+	void insert(int idx, const Frame::SharedPtr &keyframe, const PoseSnapshot &poses);
+	bool matches(const Entry &e, const Eigen::Vector3d &pos, const Eigen::Vector3d &viewingDir,
+			float distanceTH, float cosAngleTH, bool checkBothScales, float distFacReciprocal) const;
+
+	static int64_t cellKey(int64_t x, int64_t y, int64_t z);
+
+	std::vector<Entry> entries;
+	std::map<int, Grid> grids;	// by floor(log2(distFac))
+	std::vector<int> ungridded;	// distFac not positive and finite; always checked.
+	int version;
+};
+
+}
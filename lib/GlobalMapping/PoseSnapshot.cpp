@@ -0,0 +1,67 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GlobalMapping/PoseSnapshot.h"
+
+#include "DataStructures/Frame.h"
+
+namespace lsd_slam
+{
+
+
+PoseSnapshot::PoseSnapshot(int version)
+	: version(version)
+{
+}
+
+void PoseSnapshot::set(int keyframeId, const Sim3 &camToWorld)
+{
+	poses[keyframeId] = camToWorld;
+}
+
+bool PoseSnapshot::find(int keyframeId, Sim3 &camToWorld) const
+{
+	auto it = poses.find(keyframeId);
+	if(it == poses.end())
+		return false;
+
+	camToWorld = it->second;
+	return true;
+}
+
+Sim3 PoseSnapshot::getCamToWorld(const FramePoseStruct &pose) const
+{
+	Sim3 camToWorld;
+	if(find(pose.frame.id(), camToWorld))
+		return camToWorld;
+
+	// id if there is no parent (very first frame)
+	if(!pose.frame.hasTrackingParent())
+		return Sim3();
+
+	// tracking parents are keyframes.
+	FramePoseStruct &parent = *pose.frame.trackingParent()->pose;
+	if(!find(parent.frame.id(), camToWorld))
+		camToWorld = parent.getCamToWorld();
+
+	return camToWorld * pose.thisToParent_raw;
+}
+
+}
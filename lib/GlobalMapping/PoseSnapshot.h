@@ -0,0 +1,71 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <memory>
+#include <unordered_map>
+
+#include "util/EigenCoreInclude.h"
+#include "util/SophusUtil.h"
+
+
+namespace lsd_slam
+{
+
+class FramePoseStruct;
+
+/**
+ * Immutable set of optimized keyframe poses (camToWorld), one per merged
+ * pose-graph optimization result.
+ *
+ * The optimizer fills a new snapshot, and the mapping thread publishes it
+ * by swapping the KeyFrameGraph's pointer once the poses are applied.
+ * Readers keep the pointer they loaded for as long as they need a
+ * consistent set of poses; no graph lock is involved.
+ */
+class PoseSnapshot
+{
+public:
+	typedef std::shared_ptr<const PoseSnapshot> ConstPtr;
+
+	explicit PoseSnapshot(int version);
+
+	/** Sets the pose of a keyframe. Only before the snapshot is published. */
+	void set(int keyframeId, const Sim3 &camToWorld);
+
+	/** Looks up the pose of a keyframe that was in the graph. */
+	bool find(int keyframeId, Sim3 &camToWorld) const;
+
+	/** Pose of any frame in this version: its snapshot pose, or its tracking
+	 *  parent's times thisToParent_raw. A parent that isn't in the snapshot
+	 *  yet (no optimization since it was made, or SLAM disabled) contributes
+	 *  its cached FramePoseStruct pose, so this never walks the chain. */
+	Sim3 getCamToWorld(const FramePoseStruct &pose) const;
+
+	int size() const { return poses.size(); }
+
+	const int version;
+
+private:
+	std::unordered_map<int, Sim3, std::hash<int>, std::equal_to<int>,
+			Eigen::aligned_allocator< std::pair<const int, Sim3> > > poses;
+};
+
+}
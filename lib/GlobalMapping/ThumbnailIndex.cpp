@@ -0,0 +1,164 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GlobalMapping/ThumbnailIndex.h"
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+
+namespace lsd_slam
+{
+
+
+ThumbnailIndex::ThumbnailIndex()
+	: num(0)
+{
+}
+
+void ThumbnailIndex::computeDescriptor(Frame* frame, Descriptor &out)
+{
+	boost::shared_lock<boost::shared_mutex> lock = frame->getActiveLock();
+
+	// coarsest level that still has 2x2 pixels per thumbnail cell.
+	int level = PYRAMID_LEVELS-1;
+	while(level > 0 && (frame->width(level) < 2*THUMBNAIL_WIDTH || frame->height(level) < 2*THUMBNAIL_HEIGHT))
+		level--;
+
+	const int w = frame->width(level);
+	const int h = frame->height(level);
+	const float* image = frame->image(level);
+
+	for(int ty=0;ty<THUMBNAIL_HEIGHT;ty++)
+	{
+		int y0 = (ty*h) / THUMBNAIL_HEIGHT;
+		int y1 = ((ty+1)*h) / THUMBNAIL_HEIGHT;
+		for(int tx=0;tx<THUMBNAIL_WIDTH;tx++)
+		{
+			int x0 = (tx*w) / THUMBNAIL_WIDTH;
+			int x1 = ((tx+1)*w) / THUMBNAIL_WIDTH;
+
+			float sum = 0;
+			for(int y=y0;y<y1;y++)
+				for(int x=x0;x<x1;x++)
+					sum += image[x+y*w];
+
+			out[tx+ty*THUMBNAIL_WIDTH] = sum / ((x1-x0)*(y1-y0));
+		}
+	}
+
+	// zero mean, unit length: the dot product becomes the NCC.
+	out.array() -= out.mean();
+	float norm = out.norm();
+	if(norm > 1e-6f)
+		out /= norm;
+	else
+		out.setZero();
+}
+
+void ThumbnailIndex::add(const Frame::SharedPtr &keyframe)
+{
+	{
+		boost::shared_lock<boost::shared_mutex> lock(mutex);
+		if(idToColumn.count(keyframe->id()))
+			return;
+	}
+
+	Descriptor descriptor;
+	computeDescriptor(keyframe.get(), descriptor);
+
+	boost::unique_lock<boost::shared_mutex> lock(mutex);
+	if(!idToColumn.count(keyframe->id()))
+		addLocked(keyframe, descriptor);
+}
+
+std::vector<ThumbnailIndex::Match> ThumbnailIndex::query(const Descriptor &descriptor, int maxResults, float minSimilarity) const
+{
+	boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+	Eigen::VectorXf similarities;
+	similaritiesLocked(descriptor, similarities);
+
+	std::vector<int> columns;
+	for(int c=0;c<num;c++)
+		if(similarities[c] >= minSimilarity)
+			columns.push_back(c);
+
+	int numResults = std::min<int>(maxResults, columns.size());
+	std::partial_sort(columns.begin(), columns.begin() + numResults, columns.end(),
+			[&similarities](int a, int b) { return similarities[a] > similarities[b]; });
+
+	std::vector<Match> matches(numResults);
+	for(int i=0;i<numResults;i++)
+	{
+		matches[i].keyframe = keyframes[columns[i]];
+		matches[i].similarity = similarities[columns[i]];
+	}
+	return matches;
+}
+
+Frame::SharedPtr ThumbnailIndex::compareAndAdd(const Frame::SharedPtr &keyframe, float minSimilarity, int minAge)
+{
+	Descriptor descriptor;
+	computeDescriptor(keyframe.get(), descriptor);
+
+	boost::unique_lock<boost::shared_mutex> lock(mutex);
+
+	Eigen::VectorXf similarities;
+	similaritiesLocked(descriptor, similarities);
+
+	int best = -1;
+	for(int c=0;c<num-minAge;c++)
+	{
+		if(similarities[c] < minSimilarity || keyframes[c] == keyframe || keyframe->neighbors.count(keyframes[c]))
+			continue;
+		if(best < 0 || similarities[c] > similarities[best])
+			best = c;
+	}
+
+	if(!idToColumn.count(keyframe->id()))
+		addLocked(keyframe, descriptor);
+
+	return best < 0 ? nullptr : keyframes[best];
+}
+
+int ThumbnailIndex::size() const
+{
+	boost::shared_lock<boost::shared_mutex> lock(mutex);
+	return num;
+}
+
+void ThumbnailIndex::addLocked(const Frame::SharedPtr &keyframe, const Descriptor &descriptor)
+{
+	if(num == descriptors.cols())
+		descriptors.conservativeResize(Eigen::NoChange, std::max<int>(64, 2*descriptors.cols()));
+
+	descriptors.col(num) = descriptor;
+	keyframes.push_back(keyframe);
+	idToColumn[keyframe->id()] = num;
+	num++;
+}
+
+void ThumbnailIndex::similaritiesLocked(const Descriptor &descriptor, Eigen::VectorXf &out) const
+{
+	// one (vectorized) matrix-vector product over all keyframes.
+	out.noalias() = descriptors.leftCols(num).transpose() * descriptor;
+}
+
+}
@@ -0,0 +1,95 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "util/EigenCoreInclude.h"
+#include "util/settings.h"
+#include "DataStructures/Frame.h"
+
+
+namespace lsd_slam
+{
+
+#define THUMBNAIL_WIDTH 16
+#define THUMBNAIL_HEIGHT 12
+#define THUMBNAIL_SIZE (THUMBNAIL_WIDTH*THUMBNAIL_HEIGHT)
+
+// loop closures to the last keyframes are left to the euclidean search.
+#define THUMBNAIL_LOOP_MIN_AGE 20
+
+
+/**
+ * Dependency-free place recognition on whole-image descriptors.
+ *
+ * Each keyframe is described by a THUMBNAIL_WIDTH x THUMBNAIL_HEIGHT
+ * box-filtered thumbnail of its coarsest usable pyramid level, normalized to
+ * zero mean and unit length. Similarity is the dot product (NCC), so all
+ * keyframes are scored against a query with one matrix-vector product.
+ *
+ * Thread-safe; add() and queries may run concurrently.
+ */
+class ThumbnailIndex
+{
+public:
+	typedef Eigen::Matrix<float, THUMBNAIL_SIZE, 1> Descriptor;
+
+	struct Match
+	{
+		Frame::SharedPtr keyframe;
+		float similarity;
+	};
+
+	ThumbnailIndex();
+
+	/** Computes the descriptor of frame. */
+	static void computeDescriptor(Frame* frame, Descriptor &out);
+
+	/** Adds keyframe. Keyframes that are in the index already are ignored. */
+	void add(const Frame::SharedPtr &keyframe);
+
+	/** Returns up to maxResults keyframes with similarity >= minSimilarity,
+	 *  most similar first. */
+	std::vector<Match> query(const Descriptor &descriptor, int maxResults, float minSimilarity) const;
+
+	/** Returns the most similar keyframe that is neither one of keyframe's
+	 *  neighbours nor among the last minAge keyframes added before it,
+	 *  if its similarity is >= minSimilarity. Then adds keyframe. */
+	Frame::SharedPtr compareAndAdd(const Frame::SharedPtr &keyframe, float minSimilarity, int minAge);
+
+	int size() const;
+
+private:
+	void addLocked(const Frame::SharedPtr &keyframe, const Descriptor &descriptor);
+	void similaritiesLocked(const Descriptor &descriptor, Eigen::VectorXf &out) const;
+
+	mutable boost::shared_mutex mutex;
+
+	// one column per keyframe; the first num columns are used.
+	Eigen::Matrix<float, THUMBNAIL_SIZE, Eigen::Dynamic> descriptors;
+	std::vector<Frame::SharedPtr> keyframes;
+	std::unordered_map<int, int> idToColumn;
+	int num;
+};
+
+}
@@ -55,35 +55,48 @@ std::vector<TrackableKFStruct> TrackableKeyFrameSearch::findEuclideanOverlapFram
 	float cosAngleTH = cosf(angleTH*0.5f*(fowX + fowY));
 
 
-	Eigen::Vector3d pos = frame->getCamToWorld().translation();
-	Eigen::Vector3d viewingDir = frame->getCamToWorld().rotationMatrix().rightCols<1>();
+	// all poses from one snapshot, so they are consistent with each other and the index.
+	PoseSnapshot::ConstPtr poses = graph->poseSnapshot();
+	Sim3 frameCamToWorld = poses->getCamToWorld(*frame->pose);
+
+	Eigen::Vector3d pos = frameCamToWorld.translation();
+	Eigen::Vector3d viewingDir = frameCamToWorld.rotationMatrix().rightCols<1>();
 
 	std::vector<TrackableKFStruct> potentialReferenceFrames;
 
 	float distFacReciprocal = 1;
 	if(checkBothScales)
-		distFacReciprocal = frame->meanIdepth / frame->getCamToWorld().scale();
+		distFacReciprocal = frame->meanIdepth / frameCamToWorld.scale();
 
 	// for each frame, calculate the rough score, consisting of pose, scale and angle overlap.
+	// the index narrows it down to the keyframes within the thresholds.
+	std::vector<int> nearby;
 	graph->keyframesAllMutex.lock_shared();
-	for(unsigned int i=0;i<graph->keyframesAll.size();i++)
 	{
-		Eigen::Vector3d otherPos = graph->keyframesAll[i]->getCamToWorld().translation();
+		boost::unique_lock<boost::mutex> lock(spatialIndexMutex);
+		spatialIndex.update(graph->keyframesAll, *poses);
+		spatialIndex.query(pos, viewingDir, distanceTH, cosAngleTH, checkBothScales, distFacReciprocal, nearby);
+	}
+
+	for(int i : nearby)
+	{
+		Sim3 otherCamToWorld = poses->getCamToWorld(*graph->keyframesAll[i]->pose);
+		Eigen::Vector3d otherPos = otherCamToWorld.translation();
 
 		// get distance between the frames, scaled to fit the potential reference frame.
-		float distFac = graph->keyframesAll[i]->meanIdepth / graph->keyframesAll[i]->getCamToWorld().scale();
+		float distFac = graph->keyframesAll[i]->meanIdepth / otherCamToWorld.scale();
 		if(checkBothScales && distFacReciprocal < distFac) distFac = distFacReciprocal;
 		Eigen::Vector3d dist = (pos - otherPos) * distFac;
 		float dNorm2 = dist.dot(dist);
 		if(dNorm2 > distanceTH) continue;
 
-		Eigen::Vector3d otherViewingDir = graph->keyframesAll[i]->getCamToWorld().rotationMatrix().rightCols<1>();
+		Eigen::Vector3d otherViewingDir = otherCamToWorld.rotationMatrix().rightCols<1>();
 		float dirDotProd = otherViewingDir.dot(viewingDir);
 		if(dirDotProd < cosAngleTH) continue;
 
 		potentialReferenceFrames.push_back(TrackableKFStruct());
 		potentialReferenceFrames.back().ref = graph->keyframesAll[i];
-		potentialReferenceFrames.back().refToFrame = se3FromSim3(graph->keyframesAll[i]->getCamToWorld().inverse() * frame->getCamToWorld()).inverse();
+		potentialReferenceFrames.back().refToFrame = se3FromSim3(otherCamToWorld.inverse() * frameCamToWorld).inverse();
 		potentialReferenceFrames.back().dist = dNorm2;
 		potentialReferenceFrames.back().angle = dirDotProd;
 	}
@@ -106,7 +119,9 @@ Frame::SharedPtr TrackableKeyFrameSearch::findRePositionCandidate( const Frame::
 	SE3 bestRefToFrame = SE3();
 	SE3 bestRefToFrame_tracked = SE3();
 
-	int checkedSecondary = 0;
+	// overlap of all candidates in one batch.
+	std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> > overlaps;
+	std::vector<int> overlapIdx;
 	for(unsigned int i=0;i<potentialReferenceFrames.size();i++)
 	{
 		if(frame->isTrackingParent( potentialReferenceFrames[i].ref ) )
@@ -115,21 +130,29 @@ Frame::SharedPtr TrackableKeyFrameSearch::findRePositionCandidate( const Frame::
 		if(potentialReferenceFrames[i].ref->idxInKeyframes < INITIALIZATION_PHASE_COUNT)
 			continue;
 
-		{
-			Timer time;
-			tracker->checkPermaRefOverlap(potentialReferenceFrames[i].ref.get(), potentialReferenceFrames[i].refToFrame);
-			trackPermaRef.update( time );
-		}
+		overlaps.push_back(PermaRefCandidate(potentialReferenceFrames[i].ref.get(), potentialReferenceFrames[i].refToFrame));
+		overlapIdx.push_back(i);
+	}
 
-		float score = getRefFrameScore(potentialReferenceFrames[i].dist, tracker->pointUsage);
+	{
+		Timer time;
+		tracker->checkPermaRefOverlapBatch(overlaps, true);
+		trackPermaRef.update( time );
+	}
+
+	int checkedSecondary = 0;
+	for(unsigned int j=0;j<overlaps.size();j++)
+	{
+		const TrackableKFStruct &potential = potentialReferenceFrames[overlapIdx[j]];
+		float score = getRefFrameScore(potential.dist, overlaps[j].pointUsage);
 
 		if(score < maxScore)
 		{
-			SE3 RefToFrame_tracked = tracker->trackFrameOnPermaref(potentialReferenceFrames[i].ref.get(), frame.get(), potentialReferenceFrames[i].refToFrame);
-			Sophus::Vector3d dist = RefToFrame_tracked.translation() * potentialReferenceFrames[i].ref->meanIdepth;
+			SE3 RefToFrame_tracked = tracker->trackFrameOnPermaref(potential.ref.get(), frame.get(), potential.refToFrame);
+			Sophus::Vector3d dist = RefToFrame_tracked.translation() * potential.ref->meanIdepth;
 
 			float newScore = getRefFrameScore(dist.dot(dist), tracker->pointUsage);
-			float poseDiscrepancy = (potentialReferenceFrames[i].refToFrame * RefToFrame_tracked.inverse()).log().norm();
+			float poseDiscrepancy = (potential.refToFrame * RefToFrame_tracked.inverse()).log().norm();
 			float goodVal = tracker->pointUsage * tracker->lastGoodCount() / (tracker->lastGoodCount()+tracker->lastBadCount());
 			checkedSecondary++;
 
@@ -137,8 +160,8 @@ Frame::SharedPtr TrackableKeyFrameSearch::findRePositionCandidate( const Frame::
 			{
 				bestPoseDiscrepancy = poseDiscrepancy;
 				bestScore = score;
-				bestFrame = potentialReferenceFrames[i].ref;
-				bestRefToFrame = potentialReferenceFrames[i].refToFrame;
+				bestFrame = potential.ref;
+				bestRefToFrame = potential.refToFrame;
 				bestRefToFrame_tracked = RefToFrame_tracked;
 				bestDist = dist.dot(dist);
 				bestUsage = tracker->pointUsage;
@@ -186,6 +209,11 @@ std::unordered_set<Frame::SharedPtr> TrackableKeyFrameSearch::findCandidates(con
 			appearanceBased = 1 + fabMapResult_out->neighbors.size();
 		}
 	}
+	else if(useThumbnailIndex)
+	{
+		// keep the index complete for the relocalizer.
+		thumbnails.add(keyframe);
+	}
 
 	if (enablePrintDebugInfo && printConstraintSearchInfo)
 		printf("Early LoopClosure-Candidates for %d: %d euclidean, %d appearance-based, %d total\n",
@@ -196,31 +224,35 @@ std::unordered_set<Frame::SharedPtr> TrackableKeyFrameSearch::findCandidates(con
 
 Frame::SharedPtr TrackableKeyFrameSearch::findAppearanceBasedCandidate( const Frame::SharedPtr &keyframe)
 {
+	Frame::SharedPtr thumbnailResult(nullptr);
+	if(useThumbnailIndex)
+		thumbnailResult = thumbnails.compareAndAdd(keyframe, thumbnailMatchTH, THUMBNAIL_LOOP_MIN_AGE);
+
 #ifdef HAVE_FABMAP
-	if(!useFabMap) return nullptr;
+	if(!useFabMap) return thumbnailResult;
 
 
 	if (! fabMap.isValid())
 	{
 		printf("Error: called findAppearanceBasedCandidate(), but FabMap instance is not valid!\n");
-		return nullptr;
+		return thumbnailResult;
 	}
 
 
 	int newID, loopID;
 	fabMap.compareAndAdd(keyframe, &newID, &loopID);
 	if (newID < 0)
-		return nullptr;
+		return thumbnailResult;
 
 	fabmapIDToKeyframe.insert(std::make_pair(newID, keyframe));
 	if (loopID >= 0)
 		return fabmapIDToKeyframe.at(loopID);
 	else
-		return nullptr;
+		return thumbnailResult;
 #else
 	if(useFabMap)
 		printf("Warning: Compiled without FabMap, but useFabMap is enabled... ignoring.\n");
-	return nullptr;
+	return thumbnailResult;
 #endif
 }
 
@@ -29,6 +29,8 @@
 	#include "GlobalMapping/FabMap.h"
 #endif
 
+#include "GlobalMapping/ThumbnailIndex.h"
+#include "GlobalMapping/KeyFrameSpatialIndex.h"
 #include "util/MovingAverage.h"
 #include "util/settings.h"
 
@@ -79,11 +81,13 @@ public:
 
 	MsRateAverage trackPermaRef;
 
+	const ThumbnailIndex &thumbnailIndex() const { return thumbnails; }
+
 
 private:
 	/**
 	 * Returns a possible loop closure for the keyframe or nullptr if none is found.
-	 * Uses FabMap internally.
+	 * Uses the thumbnail index, or FabMap if enabled.
 	 */
 	Frame::SharedPtr findAppearanceBasedCandidate(const Frame::SharedPtr &keyframe);
 	std::vector<TrackableKFStruct> findEuclideanOverlapFrames(const Frame::SharedPtr &frame, float distanceTH, float angleTH, bool checkBothScales = false);
@@ -92,6 +96,11 @@ private:
 	std::unordered_map<int, Frame::SharedPtr> fabmapIDToKeyframe;
 	FabMap fabMap;
 #endif
+	ThumbnailIndex thumbnails;
+
+	boost::mutex spatialIndexMutex;
+	KeyFrameSpatialIndex spatialIndex;
+
 	std::shared_ptr<KeyFrameGraph> graph;
 	std::unique_ptr<SE3Tracker> tracker;
 
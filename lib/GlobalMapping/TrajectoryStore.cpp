@@ -0,0 +1,118 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GlobalMapping/TrajectoryStore.h"
+
+#include <algorithm>
+#include <boost/thread/locks.hpp>
+
+#include "DataStructures/Frame.h"
+
+namespace lsd_slam
+{
+
+
+TrajectoryStore::TrajectoryStore()
+	: numValid(0),
+	  snapshotVersion(-1),
+	  rawChanges(-1)
+{
+}
+
+void TrajectoryStore::add(const FramePoseStruct::SharedPtr &pose)
+{
+	boost::unique_lock<boost::shared_mutex> lock(mutex);
+
+	entries.push_back(Entry());
+	Entry &e = entries.back();
+	e.pose = pose;
+	e.frameId = pose->frame.id();
+	e.parent = -1;
+	e.rawVersion = -1;
+
+	if(pose->frame.hasTrackingParent())
+	{
+		auto parent = idToIndex.find(pose->frame.trackingParent()->id());
+		if(parent != idToIndex.end())
+			e.parent = parent->second;
+	}
+
+	idToIndex[e.frameId] = entries.size()-1;
+}
+
+void TrajectoryStore::update(const PoseSnapshot &poses)
+{
+	boost::unique_lock<boost::shared_mutex> lock(mutex);
+
+	int firstInvalid = numValid;
+	if(poses.version != snapshotVersion)
+		firstInvalid = 0;
+
+	// some thisToParent_raw changed: recompute from the first one.
+	int changes = FramePoseStruct::rawChanges();
+	if(changes != rawChanges)
+		for(int i=0;i<firstInvalid;i++)
+			if(entries[i].rawVersion != entries[i].pose->rawVersion())
+			{
+				firstInvalid = i;
+				break;
+			}
+
+	for(int i=firstInvalid;i<(int)entries.size();i++)
+	{
+		Entry &e = entries[i];
+		e.rawVersion = e.pose->rawVersion();
+
+		Sim3 optimized;
+		if(poses.find(e.frameId, optimized))
+			e.camToWorld = optimized;
+		else if(e.parent >= 0)
+			e.camToWorld = entries[e.parent].camToWorld * e.pose->thisToParent_raw;
+		else
+			e.camToWorld = Sim3();
+	}
+
+	numValid = entries.size();
+	snapshotVersion = poses.version;
+	rawChanges = changes;
+}
+
+Sim3 TrajectoryStore::getCamToWorld(int i) const
+{
+	boost::shared_lock<boost::shared_mutex> lock(mutex);
+	return entries[i].camToWorld;
+}
+
+void TrajectoryStore::getAll(std::vector<Sim3, Eigen::aligned_allocator<Sim3> > &out) const
+{
+	boost::shared_lock<boost::shared_mutex> lock(mutex);
+
+	out.resize(numValid);
+	for(int i=0;i<numValid;i++)
+		out[i] = entries[i].camToWorld;
+}
+
+int TrajectoryStore::size() const
+{
+	boost::shared_lock<boost::shared_mutex> lock(mutex);
+	return numValid;
+}
+
+}
@@ -0,0 +1,89 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <vector>
+#include <unordered_map>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "util/EigenCoreInclude.h"
+#include "util/SophusUtil.h"
+#include "DataStructures/FramePoseStruct.h"
+#include "GlobalMapping/PoseSnapshot.h"
+
+
+namespace lsd_slam
+{
+
+/**
+ * Flattened absolute poses (camToWorld) of all tracked frames, in the
+ * order they were added.
+ *
+ * Frames are added after their tracking parent, so one front-to-back pass
+ * computes every pose from its parent's. That pass runs once per
+ * PoseSnapshot version; in between, update() only computes frames added
+ * since, and the ones after a frame whose thisToParent_raw changed
+ * (FramePoseStruct::invalidateCache()). Lookups are O(1).
+ *
+ * The tracking parent is recorded when a frame is added.
+ *
+ * Thread-safe.
+ */
+class TrajectoryStore
+{
+public:
+	TrajectoryStore();
+
+	/** Appends a tracked frame. Its tracking parent, if any, has to be added first. */
+	void add(const FramePoseStruct::SharedPtr &pose);
+
+	/** Brings all absolute poses up to date with poses. */
+	void update(const PoseSnapshot &poses);
+
+	/** camToWorld of the i-th frame added, as of the last update(). */
+	Sim3 getCamToWorld(int i) const;
+
+	/** camToWorld of all frames, as of the last update(). */
+	void getAll(std::vector<Sim3, Eigen::aligned_allocator<Sim3> > &out) const;
+
+	int size() const;
+
+private:
+	struct Entry
+	{
+		FramePoseStruct::SharedPtr pose;
+		int frameId;	// the frame may be gone.
+		int parent;		// index, -1 if none.
+		int rawVersion;	// pose->rawVersion() camToWorld was computed with.
+		Sim3 camToWorld;
+	};
+
+	mutable boost::shared_mutex mutex;
+
+	std::vector<Entry, Eigen::aligned_allocator<Entry> > entries;
+	std::unordered_map<int, int> idToIndex;
+
+	// entries before this are up to date.
+	int numValid;
+	int snapshotVersion;
+	int rawChanges;
+};
+
+}
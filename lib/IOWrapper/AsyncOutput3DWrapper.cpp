@@ -0,0 +1,201 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IOWrapper/AsyncOutput3DWrapper.h"
+
+#include <g3log/g3log.hpp>
+
+#include "DataStructures/Frame.h"
+
+namespace lsd_slam
+{
+
+AsyncOutput3DWrapper::AsyncOutput3DWrapper( const std::shared_ptr<Output3DWrapper> &target, const Configuration &conf,
+																						int maxPendingKeyframes, int maxQueued )
+	: _target( target ),
+		_maxPendingKeyframes( maxPendingKeyframes ),
+		_maxQueued( maxQueued ),
+		_depthImageSize( conf.slamImage.area() * 3 ),		// DepthMapRenderer renders CV_8UC3
+		_running( true ),
+		_publishing( false ),
+		_hasPose( false ),
+		_hasDepthImage( false ),
+		_coalesced( 0 ),
+		_dropped( 0 )
+{
+	CHECK( (bool)_target ) << "AsyncOutput3DWrapper needs a wrapper to publish to";
+	_publisher = std::thread( &AsyncOutput3DWrapper::publisherLoop, this );
+}
+
+AsyncOutput3DWrapper::~AsyncOutput3DWrapper()
+{
+	// what is still pending is published before the thread exits.
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		_running = false;
+	}
+	_workAvailable.notify_all();
+	_publisher.join();
+
+	LOG_IF(INFO, _coalesced > 0 || _dropped > 0) << "Output: " << _coalesced << " publications coalesced, " << _dropped << " dropped";
+}
+
+void AsyncOutput3DWrapper::publishPose( const Sophus::Sim3f &pose )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( _hasPose ) ++_coalesced;
+	_pose = pose;
+	_hasPose = true;
+	_workAvailable.notify_one();
+}
+
+void AsyncOutput3DWrapper::publishKeyframeGraph( const std::shared_ptr<KeyFrameGraph> &graph )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( _graph ) ++_coalesced;
+	_graph = graph;
+	_workAvailable.notify_one();
+}
+
+void AsyncOutput3DWrapper::publishKeyframe( const std::shared_ptr<Frame> &kf )
+{
+	std::unique_lock<std::mutex> lock( _mutex );
+
+	auto it = _keyframes.find( kf->id() );
+	if( it != _keyframes.end() ) {
+		it->second = kf;
+		++_coalesced;
+	} else {
+		// a keyframe is never dropped, the caller waits for the publisher instead.
+		_keyframesTaken.wait( lock, [this]() { return (int)_keyframes.size() < _maxPendingKeyframes; } );
+		_keyframes.insert( std::make_pair( kf->id(), kf ) );
+	}
+	_workAvailable.notify_one();
+}
+
+void AsyncOutput3DWrapper::updateDepthImage( unsigned char * data )
+{
+	// the caller keeps drawing into data, so it is copied right away.
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( _hasDepthImage ) ++_coalesced;
+	_depthImage.assign( data, data + _depthImageSize );
+	_hasDepthImage = true;
+	_workAvailable.notify_one();
+}
+
+void AsyncOutput3DWrapper::publishTrackedFrame( const std::shared_ptr<Frame> &kf )
+{
+	// tracking goes on changing kf, so its image and pose are copied right away.
+	std::shared_ptr<Frame> snapshot = kf->snapshot();
+
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( _trackedFrame ) ++_coalesced;
+	_trackedFrame = snapshot;
+	_workAvailable.notify_one();
+}
+
+void AsyncOutput3DWrapper::publishTrajectory( std::vector<Eigen::Matrix<float, 3, 1>> trajectory, std::string identifier )
+{
+	auto target = _target;
+	enqueue( [target, trajectory, identifier]() { target->publishTrajectory( trajectory, identifier ); } );
+}
+
+void AsyncOutput3DWrapper::publishTrajectoryIncrement( Eigen::Matrix<float, 3, 1> pt, std::string identifier )
+{
+	auto target = _target;
+	enqueue( [target, pt, identifier]() { target->publishTrajectoryIncrement( pt, identifier ); } );
+}
+
+void AsyncOutput3DWrapper::publishDebugInfo( Eigen::Matrix<float, 20, 1> data )
+{
+	auto target = _target;
+	enqueue( [target, data]() { target->publishDebugInfo( data ); } );
+}
+
+void AsyncOutput3DWrapper::enqueue( const std::function<void()> &call )
+{
+	std::lock_guard<std::mutex> lock( _mutex );
+	if( (int)_queue.size() >= _maxQueued ) {
+		_queue.pop_front();
+		++_dropped;
+	}
+	_queue.push_back( call );
+	_workAvailable.notify_one();
+}
+
+bool AsyncOutput3DWrapper::idle() const
+{
+	return !_hasPose && !_trackedFrame && !_graph && !_hasDepthImage && _keyframes.empty() && _queue.empty();
+}
+
+void AsyncOutput3DWrapper::flush()
+{
+	std::unique_lock<std::mutex> lock( _mutex );
+	_workDone.wait( lock, [this]() { return idle() && !_publishing; } );
+}
+
+void AsyncOutput3DWrapper::publisherLoop()
+{
+	std::vector<unsigned char> depthImage;
+
+	while( true )
+	{
+		bool hasPose, hasDepthImage;
+		Sophus::Sim3f pose;
+		std::shared_ptr<Frame> trackedFrame;
+		std::shared_ptr<KeyFrameGraph> graph;
+		std::map< int, std::shared_ptr<Frame> > keyframes;
+		std::deque< std::function<void()> > queue;
+
+		{
+			std::unique_lock<std::mutex> lock( _mutex );
+			_publishing = false;
+			_workDone.notify_all();
+
+			_workAvailable.wait( lock, [this]() { return !idle() || !_running; } );
+			if( idle() && !_running ) return;
+
+			hasPose = _hasPose;
+			pose = _pose;
+			trackedFrame.swap( _trackedFrame );
+			graph.swap( _graph );
+			hasDepthImage = _hasDepthImage;
+			if( hasDepthImage ) depthImage.swap( _depthImage );
+			keyframes.swap( _keyframes );
+			queue.swap( _queue );
+
+			_hasPose = _hasDepthImage = false;
+			_publishing = true;
+		}
+		_keyframesTaken.notify_all();
+
+		for( auto &call : queue ) call();
+
+		for( auto &kf : keyframes )
+			_target->publishKeyframe( kf.second->snapshot() );
+
+		if( graph ) _target->publishKeyframeGraph( graph );
+		if( trackedFrame ) _target->publishTrackedFrame( trackedFrame );
+		if( hasPose ) _target->publishPose( pose );
+		if( hasDepthImage ) _target->updateDepthImage( depthImage.data() );
+	}
+}
+
+}
@@ -0,0 +1,106 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+#include "IOWrapper/Output3DWrapper.h"
+#include "util/Configuration.h"
+
+namespace lsd_slam
+{
+
+/**
+ * Output3DWrapper that hands everything on to another one from its own
+ * publisher thread, so a slow visualizer or logger never stalls tracking
+ * or mapping. The calls only record what is to be published:
+ *
+ * - the pose, tracked frame, keyframe graph and depth image are
+ *   coalesced, only the latest of each is published.
+ * - keyframes are coalesced per id and never dropped: with
+ *   maxPendingKeyframes waiting, publishKeyframe() blocks until the
+ *   publisher takes them. The publisher sends an immutable
+ *   Frame::snapshot() of each, so the receiver may keep it and read it
+ *   while mapping goes on.
+ * - the tracked frame is snapshotted when it is published.
+ * - everything else goes through a bounded queue that drops the oldest
+ *   call when full.
+ */
+class AsyncOutput3DWrapper : public Output3DWrapper
+{
+public:
+	AsyncOutput3DWrapper( const std::shared_ptr<Output3DWrapper> &target, const Configuration &conf,
+												int maxPendingKeyframes = 64, int maxQueued = 256 );
+	virtual ~AsyncOutput3DWrapper();
+
+	const std::shared_ptr<Output3DWrapper> &target() const { return _target; }
+
+	virtual void publishPose( const Sophus::Sim3f &pose );
+	virtual void publishKeyframeGraph( const std::shared_ptr<KeyFrameGraph> &graph );
+	virtual void publishKeyframe( const std::shared_ptr<Frame> &kf );
+	virtual void updateDepthImage( unsigned char * data );
+	virtual void publishTrackedFrame( const std::shared_ptr<Frame> &kf );
+	virtual void publishTrajectory( std::vector<Eigen::Matrix<float, 3, 1>> trajectory, std::string identifier );
+	virtual void publishTrajectoryIncrement( Eigen::Matrix<float, 3, 1> pt, std::string identifier );
+	virtual void publishDebugInfo( Eigen::Matrix<float, 20, 1> data );
+
+	/** Blocks until everything recorded so far has been published. */
+	void flush();
+
+	// calls replaced by a later one before being published / dropped from the full queue.
+	int coalesced() const { return _coalesced; }
+	int dropped() const { return _dropped; }
+
+private:
+	void enqueue( const std::function<void()> &call );
+	bool idle() const;
+
+	void publisherLoop();
+
+	std::shared_ptr<Output3DWrapper> _target;
+	const int _maxPendingKeyframes, _maxQueued;
+	const size_t _depthImageSize;
+
+	mutable std::mutex _mutex;
+	std::condition_variable _workAvailable, _workDone, _keyframesTaken;
+	bool _running, _publishing;
+
+	// pending, guarded by _mutex
+	bool _hasPose;
+	Sophus::Sim3f _pose;
+	std::shared_ptr<Frame> _trackedFrame;
+	std::shared_ptr<KeyFrameGraph> _graph;
+	std::vector<unsigned char> _depthImage;
+	bool _hasDepthImage;
+	std::map< int, std::shared_ptr<Frame> > _keyframes;
+	std::deque< std::function<void()> > _queue;
+
+	int _coalesced, _dropped;
+
+	std::thread _publisher;
+};
+
+}
@@ -21,10 +21,10 @@
 #ifndef _OBJECT_BUFFER_HPP_
 #define _OBJECT_BUFFER_HPP_
 
-#include <deque>
-#include <boost/thread/recursive_mutex.hpp>
 #include <boost/thread/condition.hpp>
 
+#include "util/RingBuffer.h"
+
 
 
 namespace lsd_slam
@@ -50,7 +50,10 @@ protected:
 
 /**
  * Thread-safe limited-size buffer which may notify a specific object when
- * a new item becomes available.
+ * new items become available.
+ *
+ * Lock-free ring (see RingBuffer) for any number of producers and a single
+ * consumer. Objects are moved, not copied, on the way out.
  */
 template< typename T >
 class NotifyBuffer
@@ -60,7 +63,7 @@ public:
 	 * Creates a queue with the given maximum size.
 	 */
 	NotifyBuffer(int bufferSize)
-		: bufferSize(bufferSize)
+		: buffer(bufferSize)
 		, receiver(nullptr)
 	{
 	}
@@ -70,7 +73,7 @@ public:
 	 * which will be notified when a new object becomes available.
 	 */
 	NotifyBuffer(int bufferSize, Notifiable* receiver)
-		: bufferSize(bufferSize)
+		: buffer(bufferSize)
 		, receiver(receiver)
 	{
 	}
@@ -93,19 +96,27 @@ public:
 	 */
 	bool pushBack(const T& object)
 	{
-		boost::unique_lock<boost::recursive_mutex> lock(bufferMutex);
-		
-		if (static_cast<int>(queue.size()) >= bufferSize) {
+		if (!buffer.push(object)) {
 			return false;
 		}
-		queue.push_back(object);
 		
-		lock.unlock();
+		Notifiable* r = receiver;
+		if (r) {
+			r->notify();
+		}
+		return true;
+	}
+	
+	bool pushBack(T&& object)
+	{
+		if (!buffer.push(std::move(object))) {
+			return false;
+		}
 		
-		if (receiver) {
-			receiver->notify();
+		Notifiable* r = receiver;
+		if (r) {
+			r->notify();
 		}
-		bufferNonEmptyCondition.notify_one();
 		return true;
 	}
 	
@@ -114,52 +125,44 @@ public:
 	 */
 	int size()
 	{
-		boost::unique_lock<boost::recursive_mutex> lock(bufferMutex);
-		return queue.size();
+		return buffer.size();
 	}
 	
 	/**
-	 * Returns a copy of the first object.
+	 * Returns the first object, or nullptr if the buffer is empty.
+	 * Consumer thread only; valid until the next popFront().
 	 */
-	T first() {
-		boost::unique_lock<boost::recursive_mutex> lock(bufferMutex);
-		return queue.front();
+	T* first() {
+		return buffer.front();
 	}
 	
 	/**
-	 * Removes the first object and returns a copy of it.
+	 * Removes the first object and moves it into object.
 	 * 
 	 * If there is no object in the queue, blocks until one is available.
 	 */
-	T popFront() {
-		boost::unique_lock<boost::recursive_mutex> lock(bufferMutex);
-		
-		// Block in case there is no object
-		while (!(queue.size() > 0)) {
-			bufferNonEmptyCondition.wait(lock);
-		}
-		
-		T object = queue.front();
-		queue.pop_front();
-		return object;
+	void popFront(T& object) {
+		buffer.pop(object);
 	}
 	
 	/**
-	 * Returns the buffer access mutex. Must be locked when checking size()
-	 * and waiting if size() == 0.
+	 * Non-blocking popFront(). Returns false if the queue is empty.
 	 */
-	boost::recursive_mutex& getMutex() {
-		return bufferMutex;
+	bool tryPopFront(T& object) {
+		return buffer.tryPop(object);
 	}
 	
-private:
-	boost::recursive_mutex bufferMutex;
-	boost::condition bufferNonEmptyCondition;
+	/**
+	 * Number of objects discarded because the queue was full, and the
+	 * most objects it has held at once.
+	 */
+	size_t dropped() const { return buffer.dropped(); }
+	size_t highWater() const { return buffer.highWater(); }
 	
-	int bufferSize;
-	std::deque< T > queue;
+private:
+	RingBuffer< T, true > buffer;
 	
-	Notifiable* receiver;
+	std::atomic<Notifiable*> receiver;
 };
 }
 #endif
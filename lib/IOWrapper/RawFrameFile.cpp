@@ -0,0 +1,124 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IOWrapper/RawFrameFile.h"
+
+#include <cstring>
+
+#include <g3log/g3log.hpp>
+
+namespace lsd_slam
+{
+
+RawFrameWriter::RawFrameWriter()
+	: _file( nullptr ),
+		_pos( 0 )
+{
+	memset( &_header, 0, sizeof(_header) );
+}
+
+RawFrameWriter::~RawFrameWriter()
+{
+	if( _file ) close();
+}
+
+bool RawFrameWriter::open( const std::string &path, int width, int height, double fps )
+{
+	CHECK( _file == nullptr ) << "RawFrameWriter is already open";
+
+	_file = fopen( path.c_str(), "wb" );
+	if( !_file ) {
+		LOG(WARNING) << "Could not open " << path << " for writing";
+		return false;
+	}
+
+	memset( &_header, 0, sizeof(_header) );
+	memcpy( _header.magic, RawFrameMagic, sizeof(RawFrameMagic) );
+	_header.version = RawFrameVersion;
+	_header.width = width;
+	_header.height = height;
+	_header.fps = fps;
+
+	_index.clear();
+
+	// written again with the frame count and index offset by close()
+	if( fwrite( &_header, sizeof(_header), 1, _file ) != 1 ) {
+		LOG(WARNING) << "Could not write to " << path;
+		return false;
+	}
+	_pos = sizeof(_header);
+
+	return true;
+}
+
+bool RawFrameWriter::pad( uint64_t alignment )
+{
+	static const char zeros[RawFrameAlignment] = {0};
+
+	uint64_t padding = (alignment - _pos % alignment) % alignment;
+	if( padding > 0 && fwrite( zeros, 1, padding, _file ) != padding ) return false;
+	_pos += padding;
+	return true;
+}
+
+bool RawFrameWriter::write( const cv::Mat &img, double timestamp )
+{
+	CHECK( _file != nullptr ) << "RawFrameWriter isn't open";
+	CHECK( img.type() == CV_8UC1 && img.cols == (int)_header.width && img.rows == (int)_header.height )
+				<< "Frame doesn't match the sequence's size or isn't 8 bit grayscale";
+
+	if( !pad( RawFrameAlignment ) ) return false;
+
+	RawFrameIndexEntry entry;
+	entry.timestamp = timestamp;
+	entry.offset = _pos;
+
+	for( int y = 0; y < img.rows; ++y )
+		if( fwrite( img.ptr(y), 1, img.cols, _file ) != (size_t)img.cols ) {
+			LOG(WARNING) << "Could not write frame " << _index.size();
+			return false;
+		}
+
+	_pos += img.cols * img.rows;
+	_index.push_back( entry );
+
+	return true;
+}
+
+bool RawFrameWriter::close()
+{
+	if( !_file ) return false;
+
+	bool ok = pad( sizeof(RawFrameIndexEntry) );
+
+	_header.numFrames = _index.size();
+	_header.indexOffset = _pos;
+
+	ok = ok && (_index.empty() || fwrite( _index.data(), sizeof(RawFrameIndexEntry), _index.size(), _file ) == _index.size());
+	ok = ok && (fseek( _file, 0, SEEK_SET ) == 0);
+	ok = ok && (fwrite( &_header, sizeof(_header), 1, _file ) == 1);
+	ok = (fclose( _file ) == 0) && ok;
+	_file = nullptr;
+
+	LOG_IF(WARNING, !ok) << "Error while finishing the raw frame file";
+	return ok;
+}
+
+}
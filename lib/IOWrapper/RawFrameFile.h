@@ -0,0 +1,93 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace lsd_slam
+{
+
+/**
+ * Raw frame sequence: 8 bit grayscale frames stored uncompressed, so a
+ * replay can map the file and hand out the frames without decoding.
+ *
+ * Layout: a RawFrameHeader, then the frames (width*height bytes each,
+ * starting on a RawFrameAlignment boundary), then the index of
+ * numFrames RawFrameIndexEntry at header.indexOffset.
+ */
+static const char RawFrameMagic[8] = { 'L', 'S', 'D', 'R', 'A', 'W', 'F', '\0' };
+static const uint32_t RawFrameVersion = 1;
+static const uint64_t RawFrameAlignment = 4096;
+
+struct RawFrameHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t width, height;
+	uint32_t numFrames;
+	uint64_t indexOffset;
+	double fps;				// nominal rate of the recording, 0 if unknown
+	uint8_t reserved[24];
+};
+
+static_assert( sizeof(RawFrameHeader) == 64, "RawFrameHeader must be 64 bytes" );
+
+struct RawFrameIndexEntry
+{
+	double timestamp;		// seconds
+	uint64_t offset;		// of the frame's first byte in the file
+};
+
+
+/**
+ * Writes a raw frame sequence. The index and the final header are written
+ * by close(), so a file that wasn't closed is not readable.
+ */
+class RawFrameWriter
+{
+public:
+	RawFrameWriter();
+	~RawFrameWriter();
+
+	bool open( const std::string &path, int width, int height, double fps = 0 );
+
+	// img has to be CV_8UC1 of the size given to open().
+	bool write( const cv::Mat &img, double timestamp );
+
+	bool close();
+
+	int numFrames() const { return _index.size(); }
+
+private:
+	bool pad( uint64_t alignment );
+
+	std::FILE *_file;
+	RawFrameHeader _header;
+	uint64_t _pos;
+	std::vector<RawFrameIndexEntry> _index;
+};
+
+}
@@ -0,0 +1,175 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IOWrapper/RawFrameSource.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <g3log/g3log.hpp>
+
+namespace lsd_slam
+{
+
+RawFrameSource::RawFrameSource( int readahead )
+	: _fd( -1 ),
+		_map( nullptr ),
+		_size( 0 ),
+		_index( nullptr ),
+		_readahead( readahead ),
+		_current( -1 )
+{
+	memset( &_header, 0, sizeof(_header) );
+}
+
+RawFrameSource::~RawFrameSource()
+{
+	close();
+}
+
+bool RawFrameSource::open( const std::string &path )
+{
+	close();
+
+	_fd = ::open( path.c_str(), O_RDONLY );
+	if( _fd < 0 ) {
+		LOG(WARNING) << "Could not open " << path << ": " << strerror( errno );
+		return false;
+	}
+
+	struct stat st;
+	if( fstat( _fd, &st ) != 0 || (size_t)st.st_size < sizeof(RawFrameHeader) ) {
+		LOG(WARNING) << path << " is too short for a raw frame file";
+		close();
+		return false;
+	}
+	_size = st.st_size;
+
+	void *map = mmap( nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0 );
+	if( map == MAP_FAILED ) {
+		LOG(WARNING) << "Could not map " << path << ": " << strerror( errno );
+		close();
+		return false;
+	}
+	_map = (const unsigned char *)map;
+
+	memcpy( &_header, _map, sizeof(_header) );
+
+	const char *error = nullptr;
+	const uint64_t frameSize = (uint64_t)_header.width * _header.height;
+	if( memcmp( _header.magic, RawFrameMagic, sizeof(RawFrameMagic) ) != 0 )
+		error = "isn't a raw frame file";
+	else if( _header.version != RawFrameVersion )
+		error = "has an unsupported version";
+	else if( _header.indexOffset > _size ||
+					 (uint64_t)_header.numFrames * sizeof(RawFrameIndexEntry) > _size - _header.indexOffset )
+		error = "has a truncated index";
+	else {
+		_index = (const RawFrameIndexEntry *)(_map + _header.indexOffset);
+		for( unsigned int i = 0; i < _header.numFrames && !error; ++i )
+			if( _index[i].offset > _size || frameSize > _size - _index[i].offset )
+				error = "has a truncated frame";
+	}
+
+	if( error ) {
+		LOG(WARNING) << path << " " << error;
+		close();
+		return false;
+	}
+
+	madvise( (void *)_map, _size, MADV_SEQUENTIAL );
+	for( int i = 0; i < _readahead; ++i ) advise( i, MADV_WILLNEED );
+
+	LOG(INFO) << "Replaying " << _header.numFrames << " frames of " << _header.width << " x " << _header.height << " from " << path;
+	return true;
+}
+
+void RawFrameSource::close()
+{
+	if( _map ) munmap( (void *)_map, _size );
+	if( _fd >= 0 ) ::close( _fd );
+
+	_fd = -1;
+	_map = nullptr;
+	_size = 0;
+	_index = nullptr;
+	_current = -1;
+	memset( &_header, 0, sizeof(_header) );
+}
+
+bool RawFrameSource::isRawFrameFile( const std::string &path )
+{
+	std::ifstream f( path.c_str(), std::ios::binary );
+	char magic[sizeof(RawFrameMagic)];
+	return f.read( magic, sizeof(magic) ) && memcmp( magic, RawFrameMagic, sizeof(magic) ) == 0;
+}
+
+void RawFrameSource::advise( int frame, int advice ) const
+{
+	if( frame < 0 || frame >= (int)_header.numFrames ) return;
+
+	// madvise wants page aligned addresses
+	static const long pageSize = sysconf( _SC_PAGESIZE );
+	uint64_t begin = _index[frame].offset & ~(uint64_t)(pageSize - 1);
+	uint64_t end = _index[frame].offset + (uint64_t)_header.width * _header.height;
+
+	madvise( (void *)(_map + begin), end - begin, advice );
+}
+
+bool RawFrameSource::grab()
+{
+	if( _current + 1 >= (int)_header.numFrames ) return false;
+	++_current;
+
+	advise( _current + _readahead, MADV_WILLNEED );
+
+	// the views of older frames may still be in use; dropped pages are
+	// simply read again from the file.
+	advise( _current - 4*_readahead, MADV_DONTNEED );
+
+	return true;
+}
+
+const unsigned char *RawFrameSource::data() const
+{
+	return (_current < 0) ? nullptr : _map + _index[_current].offset;
+}
+
+int RawFrameSource::getImage( cv::Mat &img )
+{
+	if( _current < 0 ) return -1;
+
+	img.create( _header.height, _header.width, CV_8UC1 );
+	memcpy( img.data, data(), (size_t)_header.width * _header.height );
+	return 0;
+}
+
+double RawFrameSource::timestamp() const
+{
+	return (_current < 0) ? 0 : _index[_current].timestamp;
+}
+
+}
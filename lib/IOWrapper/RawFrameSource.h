@@ -0,0 +1,82 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "libvideoio/ImageSource.h"
+
+#include "IOWrapper/RawFrameFile.h"
+
+namespace lsd_slam
+{
+
+/**
+ * ImageSource replaying a raw frame sequence (see RawFrameFile.h).
+ *
+ * The file is memory-mapped read-only. data() is a view of the frame last
+ * grabbed in the mapping, so nothing is copied or decoded; it stays valid
+ * as long as the source exists. getImage() copies the frame, since its
+ * callers may write to the image. The kernel is asked to read the next
+ * frames ahead and to drop those well behind.
+ */
+class RawFrameSource : public libvideoio::ImageSource
+{
+public:
+	RawFrameSource( int readahead = 8 );
+	virtual ~RawFrameSource();
+
+	// false, with a warning, if path can't be read or isn't a valid raw frame file.
+	bool open( const std::string &path );
+
+	// true if path is a file starting with the raw frame header.
+	static bool isRawFrameFile( const std::string &path );
+
+	virtual bool grab();
+	virtual int getImage( cv::Mat &img );
+	virtual int numFrames() const { return _header.numFrames; }
+	virtual float fps() const { return _header.fps; }
+
+	// width x height bytes of the frame last grabbed, nullptr before the first.
+	const unsigned char *data() const;
+
+	// timestamp of the frame last grabbed, in seconds.
+	double timestamp() const;
+
+	int width() const { return _header.width; }
+	int height() const { return _header.height; }
+
+private:
+	void close();
+	void advise( int frame, int advice ) const;
+
+	int _fd;
+	const unsigned char *_map;
+	size_t _size;
+
+	RawFrameHeader _header;
+	const RawFrameIndexEntry *_index;
+
+	int _readahead;
+	int _current;
+};
+
+}
@@ -0,0 +1,130 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Layout of the POSIX shared memory region written by
+ * SharedMemoryOutput3DWrapper and read by SharedMapReader. Plain structs
+ * without pointers, so that other processes can map it; readers need
+ * nothing but this header and the reader.
+ *
+ * The region holds a SharedMapHeader, then three areas at the offsets it
+ * gives: a ring of PoseSlots, one GraphBlock (edges and keyframe poses)
+ * and a ring of KeyframeSlots with the idepth and idepthVar planes.
+ *
+ * Every item is guarded by a seqlock: the writer makes it odd while it
+ * writes the item and even again when done. A reader copies (or reads in
+ * place) between two loads of the seqlock and discards what it read if
+ * the two differ or were odd. seq numbers the items of each kind as they
+ * are written, starting at 1; 0 marks a slot never written.
+ */
+namespace lsd_slam
+{
+namespace shm
+{
+
+static const uint32_t Magic = 0x314D534C;		// "LSM1"
+static const uint32_t Version = 1;
+
+static_assert( ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+							 "shared memory seqlocks need lock free atomics" );
+
+// camToWorld as a row-major 4x4 Sim(3) matrix.
+typedef float Pose[16];
+
+struct SharedMapHeader
+{
+	uint32_t magic, version;
+	uint64_t size;								// of the whole region
+
+	uint32_t width, height;				// of the keyframe planes
+	float fx, fy, cx, cy;
+
+	uint32_t numPoseSlots;
+	uint32_t numKeyframeSlots;
+	uint32_t maxEdges, maxKeyframes;	// capacity of the GraphBlock
+
+	uint64_t posesOffset;
+	uint64_t graphOffset;
+	uint64_t keyframesOffset;
+	uint64_t keyframeSlotSize;		// stride of the KeyframeSlots
+
+	// number of items of each kind written so far.
+	std::atomic<uint64_t> poseSeq;
+	std::atomic<uint64_t> graphSeq;
+	std::atomic<uint64_t> keyframeSeq;
+};
+
+struct PoseSlot
+{
+	std::atomic<uint32_t> seqlock;
+	uint64_t seq;
+	Pose camToWorld;
+};
+
+struct Edge
+{
+	int32_t firstFrameId, secondFrameId;
+	float meanResidual;
+	float usage;
+};
+
+struct KeyframePose
+{
+	int32_t frameId;
+	Pose camToWorld;
+};
+
+// followed by maxEdges Edges, then maxKeyframes KeyframePoses.
+struct GraphBlock
+{
+	std::atomic<uint32_t> seqlock;
+	uint64_t seq;
+	uint32_t numEdges, numKeyframes;
+
+	Edge *edges() { return (Edge *)(this + 1); }
+	const Edge *edges() const { return (const Edge *)(this + 1); }
+	KeyframePose *keyframes( uint32_t maxEdges ) { return (KeyframePose *)(edges() + maxEdges); }
+	const KeyframePose *keyframes( uint32_t maxEdges ) const { return (const KeyframePose *)(edges() + maxEdges); }
+};
+
+// followed by the idepth and idepthVar planes, width*height floats each,
+// starting at the next multiple of 64 bytes.
+struct KeyframeSlot
+{
+	std::atomic<uint32_t> seqlock;
+	uint64_t seq;
+	int32_t frameId;
+	double timestamp;
+	Pose camToWorld;
+	uint32_t numPoints;
+
+	static size_t planesOffset() { return (sizeof(KeyframeSlot) + 63) & ~(size_t)63; }
+	float *idepth() { return (float *)((char *)this + planesOffset()); }
+	const float *idepth() const { return (const float *)((const char *)this + planesOffset()); }
+};
+
+}
+}
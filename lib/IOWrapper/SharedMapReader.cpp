@@ -0,0 +1,191 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IOWrapper/SharedMapReader.h"
+
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace lsd_slam
+{
+
+using namespace shm;
+
+SharedMapReader::SharedMapReader()
+	: _header( nullptr ),
+		_size( 0 )
+{
+}
+
+SharedMapReader::~SharedMapReader()
+{
+	close();
+}
+
+bool SharedMapReader::open( const std::string &name )
+{
+	close();
+
+	int fd = shm_open( name.c_str(), O_RDONLY, 0 );
+	if( fd < 0 ) return false;
+
+	struct stat st;
+	if( fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof(SharedMapHeader) ) {
+		::close( fd );
+		return false;
+	}
+
+	void *map = mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	::close( fd );
+	if( map == MAP_FAILED ) return false;
+
+	SharedMapHeader *header = (SharedMapHeader *)map;
+	const bool ready = header->magic == Magic;
+	std::atomic_thread_fence( std::memory_order_acquire );
+
+	if( !ready || header->version != Version || header->size != (uint64_t)st.st_size ) {
+		munmap( map, st.st_size );
+		return false;
+	}
+
+	_header = header;
+	_size = st.st_size;
+	return true;
+}
+
+void SharedMapReader::close()
+{
+	if( _header ) munmap( _header, _size );
+	_header = nullptr;
+	_size = 0;
+}
+
+template< typename Copy >
+bool SharedMapReader::readConsistent( const std::atomic<uint32_t> &seqlock, Copy copy, uint32_t *version )
+{
+	for( int tries = 0; tries < 100; ++tries )
+	{
+		uint32_t before = seqlock.load( std::memory_order_acquire );
+		if( before & 1 ) continue;
+
+		copy();
+
+		std::atomic_thread_fence( std::memory_order_acquire );
+		if( seqlock.load( std::memory_order_relaxed ) == before ) {
+			if( version ) *version = before;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool SharedMapReader::KeyframeView::valid() const
+{
+	std::atomic_thread_fence( std::memory_order_acquire );
+	return slot->seqlock.load( std::memory_order_relaxed ) == version;
+}
+
+size_t SharedMapReader::keyframes( std::vector<KeyframeView> &out ) const
+{
+	out.clear();
+	if( !_header ) return 0;
+
+	const size_t planeSize = _header->width * _header->height;
+
+	for( uint32_t i = 0; i < _header->numKeyframeSlots; ++i )
+	{
+		const KeyframeSlot *slot = (const KeyframeSlot *)(at( _header->keyframesOffset ) + i * _header->keyframeSlotSize);
+
+		KeyframeView view;
+		view.slot = slot;
+		bool ok = readConsistent( slot->seqlock, [&]() {
+			view.seq = slot->seq;
+			view.frameId = slot->frameId;
+			view.timestamp = slot->timestamp;
+			memcpy( view.camToWorld, slot->camToWorld, sizeof(Pose) );
+			view.numPoints = slot->numPoints;
+		}, &view.version );
+
+		if( !ok || view.seq == 0 ) continue;
+
+		view.idepth = slot->idepth();
+		view.idepthVar = slot->idepth() + planeSize;
+		out.push_back( view );
+	}
+
+	// keep the newest version of each keyframe.
+	std::sort( out.begin(), out.end(), []( const KeyframeView &a, const KeyframeView &b ) { return a.seq > b.seq; } );
+
+	std::unordered_map<int, bool> seen;
+	out.erase( std::remove_if( out.begin(), out.end(), [&]( const KeyframeView &v ) {
+		return !seen.insert( std::make_pair( v.frameId, true ) ).second;
+	}), out.end() );
+
+	return out.size();
+}
+
+uint64_t SharedMapReader::latestPose( Pose &camToWorld ) const
+{
+	if( !_header ) return 0;
+
+	uint64_t seq = _header->poseSeq.load( std::memory_order_acquire );
+	if( seq == 0 ) return 0;
+
+	const PoseSlot *slot = (const PoseSlot *)at( _header->posesOffset ) + (seq % _header->numPoseSlots);
+
+	uint64_t slotSeq = 0;
+	bool ok = readConsistent( slot->seqlock, [&]() {
+		slotSeq = slot->seq;
+		memcpy( camToWorld, slot->camToWorld, sizeof(Pose) );
+	});
+
+	return ok ? slotSeq : 0;
+}
+
+bool SharedMapReader::graph( uint64_t &seq, std::vector<Edge> &edges, std::vector<KeyframePose> &keyframes ) const
+{
+	if( !_header ) return false;
+	if( seq != 0 && _header->graphSeq.load( std::memory_order_acquire ) == seq ) return false;
+
+	const GraphBlock *block = (const GraphBlock *)at( _header->graphOffset );
+	const uint32_t maxEdges = _header->maxEdges, maxKeyframes = _header->maxKeyframes;
+
+	uint64_t blockSeq = 0;
+	bool ok = readConsistent( block->seqlock, [&]() {
+		blockSeq = block->seq;
+		uint32_t numEdges = std::min( block->numEdges, maxEdges );
+		uint32_t numKeyframes = std::min( block->numKeyframes, maxKeyframes );
+		edges.assign( block->edges(), block->edges() + numEdges );
+		keyframes.assign( block->keyframes( maxEdges ), block->keyframes( maxEdges ) + numKeyframes );
+	});
+
+	if( !ok || blockSeq == 0 || blockSeq == seq ) return false;
+
+	seq = blockSeq;
+	return true;
+}
+
+}
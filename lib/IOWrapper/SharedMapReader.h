@@ -0,0 +1,93 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "IOWrapper/SharedMapFormat.h"
+
+namespace lsd_slam
+{
+
+/**
+ * Reads the map that a SharedMemoryOutput3DWrapper publishes, from another
+ * process. Only depends on SharedMapFormat.h and POSIX, so consumers can
+ * link it without the rest of LSD-SLAM.
+ *
+ * Keyframes are handed out as views into the shared memory. The writer
+ * may reuse a slot at any time, so check valid() after reading a view's
+ * planes and discard what was read if it returns false.
+ */
+class SharedMapReader
+{
+public:
+	SharedMapReader();
+	~SharedMapReader();
+
+	/** Maps the region published under name. Fails until the writer is up. */
+	bool open( const std::string &name );
+	void close();
+
+	bool isOpen() const { return _header != nullptr; }
+	const shm::SharedMapHeader &header() const { return *_header; }
+
+	struct KeyframeView
+	{
+		uint64_t seq;
+		int frameId;
+		double timestamp;
+		shm::Pose camToWorld;
+		int numPoints;
+
+		// width*height floats each, in the shared memory.
+		const float *idepth;
+		const float *idepthVar;
+
+		bool valid() const;
+
+		const shm::KeyframeSlot *slot;
+		uint32_t version;
+	};
+
+	/** The newest version of each keyframe still in the ring, newest first. */
+	size_t keyframes( std::vector<KeyframeView> &out ) const;
+
+	/** Copies the newest pose. Returns its seq, 0 if there is none yet. */
+	uint64_t latestPose( shm::Pose &camToWorld ) const;
+
+	/** Copies the keyframe graph if it changed since seq (0: always), and
+	 *  updates seq. Returns false if there was nothing new. */
+	bool graph( uint64_t &seq, std::vector<shm::Edge> &edges, std::vector<shm::KeyframePose> &keyframes ) const;
+
+private:
+	// copies under the seqlock, retrying while the writer is busy. Returns
+	// false if the writer changed the item too often to get a copy.
+	template< typename Copy >
+	static bool readConsistent( const std::atomic<uint32_t> &seqlock, Copy copy, uint32_t *version = nullptr );
+
+	const char *at( uint64_t offset ) const { return (const char *)_header + offset; }
+
+	shm::SharedMapHeader *_header;
+	size_t _size;
+};
+
+}
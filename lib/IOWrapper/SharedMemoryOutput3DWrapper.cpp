@@ -0,0 +1,236 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "IOWrapper/SharedMemoryOutput3DWrapper.h"
+
+#include <cstring>
+#include <cerrno>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <g3log/g3log.hpp>
+
+#include "DataStructures/Frame.h"
+#include "GlobalMapping/KeyFrameGraph.h"
+
+namespace lsd_slam
+{
+
+using namespace shm;
+
+SharedMemoryOutput3DWrapper::SharedMemoryOutput3DWrapper( const std::string &name, const Configuration &conf,
+																													int numKeyframeSlots, int numPoseSlots,
+																													int maxEdges, int maxKeyframes )
+	: _name( name ),
+		_size( 0 ),
+		_header( nullptr )
+{
+	const size_t planeSize = conf.slamImage.area() * sizeof(float);
+	const size_t keyframeSlotSize = (KeyframeSlot::planesOffset() + 2*planeSize + 63) & ~(size_t)63;
+
+	const size_t posesOffset = (sizeof(SharedMapHeader) + 63) & ~(size_t)63;
+	const size_t graphOffset = (posesOffset + numPoseSlots * sizeof(PoseSlot) + 63) & ~(size_t)63;
+	const size_t keyframesOffset = (graphOffset + sizeof(GraphBlock)
+																	+ maxEdges * sizeof(Edge) + maxKeyframes * sizeof(KeyframePose) + 63) & ~(size_t)63;
+	_size = keyframesOffset + numKeyframeSlots * keyframeSlotSize;
+
+	// a region left over by an earlier run is replaced, readers still
+	// holding it keep their (stale) mapping.
+	shm_unlink( _name.c_str() );
+	int fd = shm_open( _name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644 );
+	if( fd < 0 ) {
+		LOG(WARNING) << "Could not create shared memory " << _name << " (" << strerror( errno ) << "), not publishing the map";
+		return;
+	}
+
+	if( ftruncate( fd, _size ) != 0 ) {
+		LOG(WARNING) << "Could not size shared memory " << _name << " to " << _size << " bytes ("
+								 << strerror( errno ) << "), not publishing the map";
+		close( fd );
+		shm_unlink( _name.c_str() );
+		return;
+	}
+
+	void *map = mmap( nullptr, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	close( fd );
+	if( map == MAP_FAILED ) {
+		LOG(WARNING) << "Could not map shared memory " << _name << " (" << strerror( errno ) << "), not publishing the map";
+		shm_unlink( _name.c_str() );
+		return;
+	}
+
+	// ftruncate zero-fills, so all slots start out never written.
+	_header = new (map) SharedMapHeader;
+	_header->size = _size;
+	_header->width = conf.slamImage.width;
+	_header->height = conf.slamImage.height;
+	_header->fx = conf.camera.fx;
+	_header->fy = conf.camera.fy;
+	_header->cx = conf.camera.cx;
+	_header->cy = conf.camera.cy;
+	_header->numPoseSlots = numPoseSlots;
+	_header->numKeyframeSlots = numKeyframeSlots;
+	_header->maxEdges = maxEdges;
+	_header->maxKeyframes = maxKeyframes;
+	_header->posesOffset = posesOffset;
+	_header->graphOffset = graphOffset;
+	_header->keyframesOffset = keyframesOffset;
+	_header->keyframeSlotSize = keyframeSlotSize;
+	_header->poseSeq = 0;
+	_header->graphSeq = 0;
+	_header->keyframeSeq = 0;
+
+	// readers check the magic last.
+	_header->version = Version;
+	std::atomic_thread_fence( std::memory_order_release );
+	_header->magic = Magic;
+
+	LOG(INFO) << "Publishing the map to shared memory " << _name << " (" << _size / (1024*1024) << " MB)";
+}
+
+SharedMemoryOutput3DWrapper::~SharedMemoryOutput3DWrapper()
+{
+	if( _header ) {
+		munmap( _header, _size );
+		shm_unlink( _name.c_str() );
+	}
+}
+
+void SharedMemoryOutput3DWrapper::beginWrite( std::atomic<uint32_t> &seqlock )
+{
+	seqlock.store( seqlock.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+}
+
+void SharedMemoryOutput3DWrapper::endWrite( std::atomic<uint32_t> &seqlock )
+{
+	seqlock.store( seqlock.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+template< typename T >
+void SharedMemoryOutput3DWrapper::toPose( const T &sim3, Pose &out )
+{
+	Eigen::Matrix4f m = sim3.matrix().template cast<float>();
+	for( int r = 0; r < 4; ++r )
+		for( int c = 0; c < 4; ++c )
+			out[4*r + c] = m(r, c);
+}
+
+void SharedMemoryOutput3DWrapper::publishPose( const Sophus::Sim3f &pose )
+{
+	if( !valid() ) return;
+
+	uint64_t seq = _header->poseSeq.load( std::memory_order_relaxed ) + 1;
+	PoseSlot *slot = (PoseSlot *)at( _header->posesOffset ) + (seq % _header->numPoseSlots);
+
+	beginWrite( slot->seqlock );
+	slot->seq = seq;
+	toPose( pose, slot->camToWorld );
+	endWrite( slot->seqlock );
+
+	_header->poseSeq.store( seq, std::memory_order_release );
+}
+
+void SharedMemoryOutput3DWrapper::publishKeyframeGraph( const std::shared_ptr<KeyFrameGraph> &graph )
+{
+	if( !valid() ) return;
+
+	// one set of poses for the whole block, not some from before and some
+	// from after an optimization.
+	PoseSnapshot::ConstPtr poses = graph->poseSnapshot();
+
+	GraphBlock *block = (GraphBlock *)at( _header->graphOffset );
+	uint64_t seq = _header->graphSeq.load( std::memory_order_relaxed ) + 1;
+
+	beginWrite( block->seqlock );
+	block->seq = seq;
+
+	{
+		boost::shared_lock<boost::shared_mutex> lock( graph->edgesListsMutex );
+
+		uint32_t n = 0;
+		Edge *edges = block->edges();
+		for( KFConstraintStruct *e : graph->edgesAll ) {
+			if( n >= _header->maxEdges ) break;
+			if( !e->firstFrame || !e->secondFrame ) continue;
+
+			edges[n].firstFrameId = e->firstFrame->id();
+			edges[n].secondFrameId = e->secondFrame->id();
+			edges[n].meanResidual = e->meanResidual;
+			edges[n].usage = e->usage;
+			++n;
+		}
+		block->numEdges = n;
+	}
+
+	{
+		boost::shared_lock<boost::shared_mutex> lock( graph->keyframesAllMutex );
+
+		uint32_t n = 0;
+		KeyframePose *keyframes = block->keyframes( _header->maxEdges );
+		for( const Frame::SharedPtr &kf : graph->keyframesAll ) {
+			if( n >= _header->maxKeyframes ) break;
+
+			keyframes[n].frameId = kf->id();
+			toPose( poses->getCamToWorld( *kf->pose ), keyframes[n].camToWorld );
+			++n;
+		}
+		block->numKeyframes = n;
+	}
+
+	LOG_IF(WARNING, block->numEdges == _header->maxEdges || block->numKeyframes == _header->maxKeyframes)
+					<< "Keyframe graph doesn't fit into shared memory " << _name << ", it was cut short";
+
+	endWrite( block->seqlock );
+	_header->graphSeq.store( seq, std::memory_order_release );
+}
+
+void SharedMemoryOutput3DWrapper::publishKeyframe( const std::shared_ptr<Frame> &kf )
+{
+	if( !valid() || !kf->hasIDepthBeenSet() ) return;
+
+	CHECK( kf->width(0) == (int)_header->width && kf->height(0) == (int)_header->height )
+				<< "Keyframe doesn't match the shared memory's image size";
+
+	uint64_t seq = _header->keyframeSeq.load( std::memory_order_relaxed ) + 1;
+	KeyframeSlot *slot = (KeyframeSlot *)(at( _header->keyframesOffset )
+																				+ (seq % _header->numKeyframeSlots) * _header->keyframeSlotSize);
+
+	const size_t planeSize = _header->width * _header->height;
+	const float *idepth = kf->idepth(0);
+	const float *idepthVar = kf->idepthVar(0);
+
+	beginWrite( slot->seqlock );
+	slot->seq = seq;
+	slot->frameId = kf->id();
+	slot->timestamp = kf->timestamp();
+	toPose( kf->getCamToWorld(), slot->camToWorld );
+	slot->numPoints = kf->numPoints;
+	memcpy( slot->idepth(), idepth, planeSize * sizeof(float) );
+	memcpy( slot->idepth() + planeSize, idepthVar, planeSize * sizeof(float) );
+	endWrite( slot->seqlock );
+
+	_header->keyframeSeq.store( seq, std::memory_order_release );
+}
+
+}
@@ -0,0 +1,71 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "IOWrapper/Output3DWrapper.h"
+#include "IOWrapper/SharedMapFormat.h"
+#include "util/Configuration.h"
+
+namespace lsd_slam
+{
+
+/**
+ * Output3DWrapper writing keyframe depth, poses and the keyframe graph into
+ * a POSIX shared memory region (see SharedMapFormat.h), from which other
+ * processes read them through SharedMapReader without any serialization.
+ *
+ * Keyframes and poses go into rings, so a reader that falls behind misses
+ * old items rather than slowing down SLAM. Put it behind an
+ * AsyncOutput3DWrapper (SlamSystem does by default) so keyframes are
+ * copied from snapshots off the mapping thread.
+ */
+class SharedMemoryOutput3DWrapper : public Output3DWrapper
+{
+public:
+	SharedMemoryOutput3DWrapper( const std::string &name, const Configuration &conf,
+															 int numKeyframeSlots = 32, int numPoseSlots = 256,
+															 int maxEdges = 16384, int maxKeyframes = 4096 );
+	virtual ~SharedMemoryOutput3DWrapper();
+
+	// false if the region couldn't be created; nothing is published then.
+	bool valid() const { return _header != nullptr; }
+
+	virtual void publishPose( const Sophus::Sim3f &pose );
+	virtual void publishKeyframeGraph( const std::shared_ptr<KeyFrameGraph> &graph );
+	virtual void publishKeyframe( const std::shared_ptr<Frame> &kf );
+
+private:
+	static void beginWrite( std::atomic<uint32_t> &seqlock );
+	static void endWrite( std::atomic<uint32_t> &seqlock );
+
+	template< typename T >
+	static void toPose( const T &sim3, shm::Pose &out );
+
+	std::string _name;
+	size_t _size;
+	shm::SharedMapHeader *_header;
+
+	char *at( uint64_t offset ) { return (char *)_header + offset; }
+};
+
+}
@@ -41,6 +41,8 @@
 // #include "GlobalMapping/g2oTypeSim3Sophus.h"
 // #include "IOWrapper/ImageDisplay.h"
 // #include "IOWrapper/Output3DWrapper.h"
+#include "IOWrapper/AsyncOutput3DWrapper.h"
+#include "DepthEstimation/DepthMapRenderer.h"
 // #include <g2o/core/robust_kernel_impl.h>
 
 #include "DataStructures/FrameMemory.h"
@@ -69,6 +71,8 @@ SlamSystem::SlamSystem( const Configuration &conf )
 	_initialized( false )
 {
 
+	setTrackingPointBudget( conf.trackingPointBudget );
+
 	// Because some of these rely on conf(), need to explicitly call after
  	// static initialization.  Is this true?
 	optThread.reset( new OptimizationThread( *this, conf.SLAMEnabled ) );
@@ -76,6 +80,8 @@ SlamSystem::SlamSystem( const Configuration &conf )
 	constraintThread.reset( new ConstraintSearchThread( *this, conf.SLAMEnabled ) );
 	trackingThread.reset( new TrackingThread( *this ) );
 
+	depthMapRenderer.reset( new DepthMapRenderer( conf, [this]( cv::Mat &image ) { publishDepthImage( image.data ); } ) );
+
 	timeLastUpdate.start();
 }
 
@@ -94,6 +100,7 @@ SlamSystem::~SlamSystem()
 
 	// newConstraintCreatedSignal.notify_all();
 
+	depthMapRenderer.reset();
 	mapThread.reset();
 	constraintThread.reset();
 	optThread.reset();
@@ -105,6 +112,15 @@ SlamSystem::~SlamSystem()
 	// Util::closeAllWindows();
 }
 
+void SlamSystem::set3DOutputWrapper( const shared_ptr<Output3DWrapper> &outputWrapper )
+{
+	// publish from a separate thread, unless that is already done (e.g. after fullReset()).
+	if( outputWrapper && _conf.asyncOutput && !std::dynamic_pointer_cast<AsyncOutput3DWrapper>( outputWrapper ) )
+		_outputWrapper.reset( new AsyncOutput3DWrapper( outputWrapper, _conf ) );
+	else
+		_outputWrapper = outputWrapper;
+}
+
 SlamSystem *SlamSystem::fullReset( void )
 {
 	SlamSystem *newSystem = new SlamSystem( conf() );
@@ -116,6 +132,9 @@ SlamSystem *SlamSystem::fullReset( void )
 
 void SlamSystem::finalize()
 {
+	// the last frame is still held back in pipelined offline mode.
+	trackingThread->flushPipeline();
+
 	LOG(INFO) << "Finalizing Graph... adding final constraints!!";
 
 	// This happens in the foreground
@@ -157,6 +176,10 @@ void SlamSystem::finalize()
 	// newFrameMapped.wait();
 
 	// usleep(200000);
+	// the final map is published before finalize() returns.
+	auto asyncOutput = std::dynamic_pointer_cast<AsyncOutput3DWrapper>( _outputWrapper );
+	if( asyncOutput ) asyncOutput->flush();
+
 	LOG(INFO) << "Done Finalizing Graph.!!";
 	_finalized.notify();
 
@@ -308,7 +331,7 @@ void SlamSystem::addTimingSamples()
 	if(sPassed > 1.0f)
 	{
 
-		LOGF_IF(INFO, enablePrintDebugInfo && printOverallTiming, "MapIt: %3.1fms (%.1fHz); Track: %3.1fms (%.1fHz); Create: %3.1fms (%.1fHz); FindRef: %3.1fms (%.1fHz); PermaTrk: %3.1fms (%.1fHz); Opt: %3.1fms (%.1fHz); FindConst: %3.1fms (%.1fHz);\n",
+		LOGF_IF(INFO, enablePrintDebugInfo && printOverallTiming, "MapIt: %3.1fms (%.1fHz); Track: %3.1fms (%.1fHz); Create: %3.1fms (%.1fHz); FindRef: %3.1fms (%.1fHz); PermaTrk: %3.1fms (%.1fHz); Opt: %3.1fms (%.1fHz); FindConst: %3.1fms (%.1fHz); RefCache: %.0f%% hits; MapQ: %d (max %d, %d dropped, %.0fms blocked); Shed: %s (lag %.0fms, %d changes, %d untracked, %d unmapped);\n",
 					mapThread->map->_perf.update.ms(), mapThread->map->_perf.update.rate(),
 					trackingThread->perf.ms(), trackingThread->perf.rate(),
 					mapThread->map->_perf.create.ms()+mapThread->map->_perf.finalize.ms(), mapThread->map->_perf.create.rate(),
@@ -316,7 +339,12 @@ void SlamSystem::addTimingSamples()
 					0.0, 0.0,
 					//trackableKeyFrameSearch != 0 ? trackableKeyFrameSearch->trackPermaRef.ms() : 0, trackableKeyFrameSearch != 0 ? trackableKeyFrameSearch->trackPermaRef.rate() : 0,
 					optThread->perf.ms(), optThread->perf.rate(),
-					perf.findConstraint.ms(), perf.findConstraint.rate() );
+					perf.findConstraint.ms(), perf.findConstraint.rate(),
+					100*constraintThread->referenceCache().hitRate(),
+					(int)mapThread->unmappedTrackedFrames.size(), mapThread->unmappedTrackedFrames.highWater(),
+					mapThread->unmappedTrackedFrames.dropped(), mapThread->unmappedTrackedFrames.blockedMs(),
+					LoadController::levelName( mapThread->loadController.level() ), mapThread->loadController.lagMs(),
+					mapThread->loadController.levelChanges(), mapThread->loadController.framesSkipped(), mapThread->loadController.referencesSkipped() );
 	}
 
 }
@@ -325,37 +353,24 @@ void SlamSystem::updateDisplayDepthMap()
 {
 	if( !conf().displayDepthMap ) return;  //&& !depthMapScreenshotFlag)
 
-	mapThread->map->debugPlotDepthMap();
-	double scale = 1;
-	if( (bool)currentKeyFrame()() )
-		scale = currentKeyFrame()()->getCamToWorld().scale();
+	// rendering and publishing happen on the renderer's thread. Nothing is
+	// done while it is busy or the last rendering was too recent.
+	DepthMapRenderer::Snapshot *snapshot = depthMapRenderer->beginSnapshot();
+	if( !snapshot ) return;
 
-	// debug plot depthmap
-	char buf1[200];
-	char buf2[200];
+	if( !mapThread->map->snapshotForDisplay( *snapshot ) ) {
+		depthMapRenderer->cancel();
+		return;
+	}
 
+	char buf1[200];
 	snprintf(buf1,200,"Map: Upd %3.0fms (%2.0fHz); Trk %3.0fms (%2.0fHz); %d / %d",
 			mapThread->map->_perf.update.ms(), mapThread->map->_perf.update.rate(),
 			trackingThread->perf.ms(), trackingThread->perf.rate(),
-			currentKeyFrame()()->numFramesTrackedOnThis, currentKeyFrame()()->numMappedOnThis ); //, (int)unmappedTrackedFrames().size());
-
-	// snprintf(buf2,200,"dens %2.0f%%; good %2.0f%%; scale %2.2f; res %2.1f/; usg %2.0f%%; Map: %d F, %d KF, %d E, %.1fm Pts",
-	// 		100*currentKeyFrame->numPoints/(float)(conf().slamImage.area()),
-	// 		100*tracking_lastGoodPerBad,
-	// 		scale,
-	// 		tracking_lastResidual,
-	// 		100*tracking_lastUsage,
-	// 		(int)keyFrameGraph()->allFramePoses.size(),
-	// 		keyFrameGraph()->totalVertices,
-	// 		(int)keyFrameGraph()->edgesAll.size(),
-	// 		1e-6 * (float)keyFrameGraph()->totalPoints);
-
-
-	if( conf().onSceenInfoDisplay )
-		printMessageOnCVImage(mapThread->map->debugImageDepth, buf1, buf2);
+			currentKeyFrame()()->numFramesTrackedOnThis, currentKeyFrame()()->numMappedOnThis );
+	snapshot->info = buf1;
 
-	CHECK( mapThread->map->debugImageDepth.data != NULL );
-	publishDepthImage( mapThread->map->debugImageDepth.data );
+	depthMapRenderer->submit();
 }
 
 
@@ -364,7 +379,7 @@ SE3 SlamSystem::getCurrentPoseEstimate()
 {
 	boost::shared_lock_guard< boost::shared_mutex > lock( keyFrameGraph()->allFramePosesMutex );
 	if( keyFrameGraph()->allFramePoses.size() > 0)
-		return se3FromSim3(keyFrameGraph()->allFramePoses.back()->getCamToWorld());
+		return se3FromSim3(keyFrameGraph()->poseSnapshot()->getCamToWorld(*keyFrameGraph()->allFramePoses.back()));
 
 	return Sophus::SE3();
 }
@@ -373,12 +388,20 @@ Sophus::Sim3f SlamSystem::getCurrentPoseEstimateScale()
 {
 	boost::shared_lock_guard< boost::shared_mutex > lock( keyFrameGraph()->allFramePosesMutex );
 	if(keyFrameGraph()->allFramePoses.size() > 0)
-		return keyFrameGraph()->allFramePoses.back()->getCamToWorld().cast<float>();
+		return keyFrameGraph()->poseSnapshot()->getCamToWorld(*keyFrameGraph()->allFramePoses.back()).cast<float>();
 
 	return Sophus::Sim3f();
 }
 
 std::vector<FramePoseStruct::SharedPtr> SlamSystem::getAllPoses()
 {
+	boost::shared_lock_guard< boost::shared_mutex > lock( keyFrameGraph()->allFramePosesMutex );
 	return keyFrameGraph()->allFramePoses;
 }
+
+std::vector<Sim3, Eigen::aligned_allocator<Sim3> > SlamSystem::getAllCamToWorld()
+{
+	std::vector<Sim3, Eigen::aligned_allocator<Sim3> > camToWorld;
+	keyFrameGraph()->getTrajectory(camToWorld);
+	return camToWorld;
+}
@@ -63,6 +63,7 @@ namespace lsd_slam
 	class OptimizationThread;
 	class MappingThread;
 	class ConstraintSearchThread;
+	class DepthMapRenderer;
 
 	using std::unique_ptr;
 	using std::shared_ptr;
@@ -113,6 +114,9 @@ public:
 
 	std::vector<FramePoseStruct::SharedPtr> getAllPoses();
 
+	// camToWorld of every tracked frame, in the order of getAllPoses(). O(1) per frame.
+	std::vector<Sim3, Eigen::aligned_allocator<Sim3> > getAllCamToWorld();
+
 	struct PerformanceData {
 		PerformanceData( void ) {;}
 
@@ -125,8 +129,8 @@ public:
 
 	//=== Debugging output functions =====
 	shared_ptr<Output3DWrapper> outputWrapper( void )      { return _outputWrapper; }
-	void set3DOutputWrapper( Output3DWrapper* outputWrapper ) {	_outputWrapper.reset(outputWrapper); }
-	void set3DOutputWrapper( const shared_ptr<Output3DWrapper> &outputWrapper) {	_outputWrapper = outputWrapper; }
+	void set3DOutputWrapper( Output3DWrapper* outputWrapper ) {	set3DOutputWrapper( shared_ptr<Output3DWrapper>(outputWrapper) ); }
+	void set3DOutputWrapper( const shared_ptr<Output3DWrapper> &outputWrapper );
 
 	void publishPose(const Sophus::Sim3f &pose ) 	                 { if( _outputWrapper ) _outputWrapper->publishPose(pose);}
 	void publishTrackedFrame( const Frame::SharedPtr &frame )      { if( _outputWrapper ) _outputWrapper->publishTrackedFrame( frame ); }
@@ -142,10 +146,11 @@ public:
 	unique_ptr<MappingThread> mapThread;
 	unique_ptr<ConstraintSearchThread> constraintThread;
 
-	// mutex to lock frame pose consistency. within a shared lock of this, *->getCamToWorld() is
-	// GUARANTEED to give the same result each call, and to be compatible to each other.
-	// locked exclusively during the pose-update by Mapping.
-	boost::shared_mutex poseConsistencyMutex;
+	// draws updateDisplayDepthMap()'s snapshots off the mapping thread.
+	unique_ptr<DepthMapRenderer> depthMapRenderer;
+
+	// frame poses that are consistent with each other come from one
+	// keyFrameGraph()->poseSnapshot(); it is swapped during the pose-update by Mapping.
 
 
 	const shared_ptr<KeyFrameGraph> &keyFrameGraph() { return _keyFrameGraph; };	  // has own locks
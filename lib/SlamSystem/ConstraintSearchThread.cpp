@@ -17,11 +17,8 @@ namespace lsd_slam {
 
 ConstraintSearchThread::ConstraintSearchThread( SlamSystem &system, bool enabled )
 	: _system( system ),
-		constraintTracker( new Sim3Tracker( system.conf().slamImage ) ),
-		constraintSE3Tracker(  new SE3Tracker( system.conf().slamImage )  ),
+		newKFTrackingReference( nullptr ),
 		_failedToRetrack( 0 ),
-		newKFTrackingReference(  new TrackingReference()  ),
-		candidateTrackingReference(  new TrackingReference()  ),
 	_thread( enabled ? ActiveIdle::createActiveIdle( std::bind( &ConstraintSearchThread::callbackIdle, this ), std::chrono::milliseconds(500)) : NULL )
 {
 }
@@ -30,10 +27,28 @@ ConstraintSearchThread::~ConstraintSearchThread( void )
 {
 	if( _thread) delete _thread.release();
 
-	if(constraintTracker )          delete constraintTracker;
-	if(constraintSE3Tracker )       delete constraintSE3Tracker;
-	if(newKFTrackingReference )     delete newKFTrackingReference;
-	if(candidateTrackingReference ) delete candidateTrackingReference;
+	for( Worker* worker : workers ) delete worker;
+}
+
+
+// workers are created on demand; there are never more than the reducer has threads.
+ConstraintSearchThread::Worker* ConstraintSearchThread::acquireWorker()
+{
+	boost::unique_lock<boost::mutex> lock(idleWorkersMutex);
+	if( idleWorkers.empty() ) {
+		workers.push_back( new Worker( _system.conf().slamImage ) );
+		return workers.back();
+	}
+
+	Worker* worker = idleWorkers.back();
+	idleWorkers.pop_back();
+	return worker;
+}
+
+void ConstraintSearchThread::releaseWorker( Worker* worker )
+{
+	boost::unique_lock<boost::mutex> lock(idleWorkersMutex);
+	idleWorkers.push_back( worker );
 }
 
 
@@ -93,6 +108,9 @@ int ConstraintSearchThread::callbackDoFullReConstraintTrack( void )
 	}
 
 	LOG(INFO) << "Done optimizing Full Map! Added " << added << " constraints.";
+	LOG(INFO) << "TrackingReference cache: " << _referenceCache.hits() << " hits, " << _referenceCache.misses()
+						<< " misses (" << 100*_referenceCache.hitRate() << "%), " << _referenceCache.size() << " entries, "
+						<< _referenceCache.memorySize() / 1000000.0f << " MB.";
 
 	// doFullReConstraintTrack = false;
 	fullReConstraintTrackComplete.notify();
@@ -254,10 +272,11 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 
 	std::unordered_map<Frame::SharedPtr, int> distancesToNewKeyFrame;
 	{
-		boost::shared_lock_guard<boost::shared_mutex> lock(_system.poseConsistencyMutex);
+		PoseSnapshot::ConstPtr poses = _system.keyFrameGraph()->poseSnapshot();
+		Sim3 frameToWorld = poses->getCamToWorld(*newKeyFrame->pose);
 		for (auto candidate : candidates)
 		{
-			Sim3 candidateToFrame_initialEstimate = newKeyFrame->getCamToWorld().inverse() * candidate->getCamToWorld();
+			Sim3 candidateToFrame_initialEstimate = frameToWorld.inverse() * poses->getCamToWorld(*candidate->pose);
 			candidateToFrame_initialEstimateMap[candidate] = candidateToFrame_initialEstimate;
 		}
 
@@ -280,8 +299,8 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 	int closeFailed = 0;
 	int closeInconsistent = 0;
 
-	SO3 disturbance = SO3::exp(Sophus::Vector3d(0.05,0,0));
-
+	// in id order, so results do not depend on the hash order of candidates.
+	CandidateJobs closeChecks;
 	for (auto candidate : candidates)
 	{
 		if (candidate->id() == newKeyFrame->id())
@@ -293,20 +312,19 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 		if(candidate->idxInKeyframes < INITIALIZATION_PHASE_COUNT)
 			continue;
 
-		SE3 c2f_init = se3FromSim3(candidateToFrame_initialEstimateMap[candidate].inverse()).inverse();
-		c2f_init.so3() = c2f_init.so3() * disturbance;
-		SE3 c2f = constraintSE3Tracker->trackFrameOnPermaref(candidate.get(), newKeyFrame.get(), c2f_init);
-		if(!constraintSE3Tracker->trackingWasGood) {closeFailed++; continue;}
-
+		closeChecks.push_back(CandidateJob(candidate, candidateToFrame_initialEstimateMap[candidate], loopclosureStrictness));
+	}
+	std::sort(closeChecks.begin(), closeChecks.end(),
+			[](const CandidateJob &a, const CandidateJob &b) { return a.candidate->id() < b.candidate->id(); });
 
-		SE3 f2c_init = se3FromSim3(candidateToFrame_initialEstimateMap[candidate]).inverse();
-		f2c_init.so3() = disturbance * f2c_init.so3();
-		SE3 f2c = constraintSE3Tracker->trackFrameOnPermaref(newKeyFrame.get(), candidate.get(), f2c_init);
-		if(!constraintSE3Tracker->trackingWasGood) {closeFailed++; continue;}
+	threadReducer.reduce(boost::bind(&ConstraintSearchThread::checkCloseCandidates, this, &newKeyFrame, &closeChecks, _1, _2, _3), 0, closeChecks.size(), 1);
 
-		if((f2c.so3() * c2f.so3()).log().norm() >= 0.09) {closeInconsistent++; continue;}
+	for (const CandidateJob &job : closeChecks)
+	{
+		if(job.closeCheck == CandidateJob::CloseFailed) {closeFailed++; continue;}
+		if(job.closeCheck == CandidateJob::CloseInconsistent) {closeInconsistent++; continue;}
 
-		closeCandidates.insert(candidate);
+		closeCandidates.insert(job.candidate);
 	}
 
 
@@ -436,7 +454,10 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 
 
 	// =============== limit number of far candidates ===============
-	// delete randomly
+	// delete randomly; in id order, so the same rand() sequence deletes the
+	// same candidates.
+	std::sort(farCandidates.begin(), farCandidates.end(),
+			[](const Frame::SharedPtr &a, const Frame::SharedPtr &b) { return a->id() < b->id(); });
 	int maxNumFarCandidates = (maxLoopClosureCandidates +1) / 2;
 	if(maxNumFarCandidates < 5) maxNumFarCandidates = 5;
 	while((int)farCandidates.size() > maxNumFarCandidates)
@@ -454,71 +475,78 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 	// =============== TRACK! ===============
 
 	// make tracking reference for newKeyFrame.
-	newKFTrackingReference->importFrame(newKeyFrame);
+	newKFTrackingReference = _referenceCache.acquire(newKeyFrame);
 
 
+	CandidateJobs closeJobs;
 	for (auto candidate : closeCandidates)
-	{
-		KFConstraintStruct* e1=0;
-		KFConstraintStruct* e2=0;
+		closeJobs.push_back(CandidateJob(candidate, candidateToFrame_initialEstimateMap[candidate], loopclosureStrictness));
+	std::sort(closeJobs.begin(), closeJobs.end(),
+			[](const CandidateJob &a, const CandidateJob &b) { return a.candidate->id() < b.candidate->id(); });
 
-		testConstraint(
-				candidate, e1, e2,
-				candidateToFrame_initialEstimateMap[candidate],
-				loopclosureStrictness);
+	testConstraints(closeJobs);
 
-		LOG_IF(DEBUG, enablePrintDebugInfo && printConstraintSearchInfo) << " CLOSE (" << distancesToNewKeyFrame.at(candidate) << ")";
+	for (const CandidateJob &job : closeJobs)
+	{
+		LOG_IF(DEBUG, enablePrintDebugInfo && printConstraintSearchInfo) << " CLOSE (" << distancesToNewKeyFrame.at(job.candidate) << ")";
 
-		if(e1 != 0)
+		if(job.e1 != 0)
 		{
-			constraints.push_back(e1);
-			constraints.push_back(e2);
+			constraints.push_back(job.e1);
+			constraints.push_back(job.e2);
 
 			// delete from far candidates if it's in there.
 			for(unsigned int k=0;k<farCandidates.size();k++)
 			{
-				if(farCandidates[k] == candidate)
+				if(farCandidates[k] == job.candidate)
 				{
 					LOGF_IF(DEBUG, enablePrintDebugInfo && printConstraintSearchInfo,
-						" DELETED %d from far, as close was successful!\n", candidate->id());
+						" DELETED %d from far, as close was successful!\n", job.candidate->id());
 
 					farCandidates[k] = farCandidates.back();
 					farCandidates.pop_back();
 				}
 			}
 		}
+		else
+			newKeyFrame->trackingFailed.insert(std::pair<Frame::SharedPtr,Sim3>(job.candidate, job.candidateToFrame_initialEstimate));
 	}
 
 
+	CandidateJobs farJobs;
 	for (auto candidate : farCandidates)
-	{
-		KFConstraintStruct* e1=0;
-		KFConstraintStruct* e2=0;
+		farJobs.push_back(CandidateJob(candidate, Sim3(), loopclosureStrictness));
+	std::sort(farJobs.begin(), farJobs.end(),
+			[](const CandidateJob &a, const CandidateJob &b) { return a.candidate->id() < b.candidate->id(); });
 
-		testConstraint(
-				candidate, e1, e2,
-				Sim3(),
-				loopclosureStrictness);
+	// the parent is verified along with the far candidates; it is never one
+	// of them, as those exclude the tracking parent.
+	const bool testParent = (parent != 0 && forceParent);
+	if(testParent)
+		farJobs.push_back(CandidateJob(parent, candidateToFrame_initialEstimateMap[parent], 100));
 
-		LOG_IF(DEBUG, enablePrintDebugInfo && printConstraintSearchInfo) << " FAR (" << distancesToNewKeyFrame.at(candidate) << ")";
+	testConstraints(farJobs);
 
-		if(e1 != 0)
+	for (unsigned int i = 0; i < farJobs.size() - (testParent ? 1 : 0); i++)
+	{
+		const CandidateJob &job = farJobs[i];
+		LOG_IF(DEBUG, enablePrintDebugInfo && printConstraintSearchInfo) << " FAR (" << distancesToNewKeyFrame.at(job.candidate) << ")";
+
+		if(job.e1 != 0)
 		{
-			constraints.push_back(e1);
-			constraints.push_back(e2);
+			constraints.push_back(job.e1);
+			constraints.push_back(job.e2);
 		}
+		else
+			newKeyFrame->trackingFailed.insert(std::pair<Frame::SharedPtr,Sim3>(job.candidate, job.candidateToFrame_initialEstimate));
 	}
 
 
 
-	if(parent != 0 && forceParent)
+	if(testParent)
 	{
-		KFConstraintStruct* e1=0;
-		KFConstraintStruct* e2=0;
-		testConstraint(
-				parent, e1, e2,
-				candidateToFrame_initialEstimateMap[parent],
-				100);
+		KFConstraintStruct* e1 = farJobs.back().e1;
+		KFConstraintStruct* e2 = farJobs.back().e2;
 		LOG_IF(DEBUG, enablePrintDebugInfo && printConstraintSearchInfo) << " PARENT (0)";
 
 		if(e1 != 0)
@@ -528,15 +556,17 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 		}
 		else
 		{
+			newKeyFrame->trackingFailed.insert(std::pair<Frame::SharedPtr,Sim3>(parent, candidateToFrame_initialEstimateMap[parent]));
+
 			float downweightFac = 5;
 			const float kernelDelta = 5 * sqrt(6000*loopclosureStrictness) / downweightFac;
 			LOG(WARNING) << "warning: reciprocal tracking on new frame failed badly, added odometry edge (Hacky).";
 
-			_system.poseConsistencyMutex.lock_shared();
+			PoseSnapshot::ConstPtr poses = _system.keyFrameGraph()->poseSnapshot();
 			constraints.push_back(new KFConstraintStruct());
 			constraints.back()->firstFrame = newKeyFrame;
 			constraints.back()->secondFrame = newKeyFrame->trackingParent();
-			constraints.back()->secondToFirst = constraints.back()->firstFrame->getCamToWorld().inverse() * constraints.back()->secondFrame->getCamToWorld();
+			constraints.back()->secondToFirst = poses->getCamToWorld(*constraints.back()->firstFrame->pose).inverse() * poses->getCamToWorld(*constraints.back()->secondFrame->pose);
 			constraints.back()->information  <<
 					0.8098,-0.1507,-0.0557, 0.1211, 0.7657, 0.0120, 0,
 					-0.1507, 2.1724,-0.1103,-1.9279,-0.1182, 0.1943, 0,
@@ -554,8 +584,6 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 			constraints.back()->meanResidualD = 10;
 			constraints.back()->meanResidualP = 10;
 			constraints.back()->usage = 0;
-
-			_system.poseConsistencyMutex.unlock_shared();
 		}
 	}
 
@@ -573,66 +601,97 @@ int ConstraintSearchThread::findConstraintsForNewKeyFrames(const Frame::SharedPt
 
 	_system.optThread->doNewConstraint();
 
-	newKFTrackingReference->invalidate();
-	candidateTrackingReference->invalidate();
+	_referenceCache.release(newKFTrackingReference);
+	newKFTrackingReference = nullptr;
 
 	return constraints.size();
 }
 
-float ConstraintSearchThread::tryTrackSim3(
-		TrackingReference* A, TrackingReference* B,
-		int lvlStart, int lvlEnd,
-		bool useSSE,
-		Sim3 &AtoB, Sim3 &BtoA,
-		KFConstraintStruct* e1, KFConstraintStruct* e2 )
+void ConstraintSearchThread::checkCloseCandidates(const Frame::SharedPtr* newKeyFrame, CandidateJobs* jobs, int first, int end, RunningStats* stats)
 {
-	BtoA = constraintTracker->trackFrameSim3(
-			A,
-			B->keyframe.get(),
-			BtoA,
-			lvlStart,lvlEnd);
-	Matrix7x7 BtoAInfo = constraintTracker->lastSim3Hessian;
-	float BtoA_meanResidual = constraintTracker->lastResidual;
-	float BtoA_meanDResidual = constraintTracker->lastDepthResidual;
-	float BtoA_meanPResidual = constraintTracker->lastPhotometricResidual;
-	float BtoA_usage = constraintTracker->pointUsage;
-
-
-	if (constraintTracker->diverged ||
-		BtoA.scale() > 1 / Sophus::SophusConstants<sophusType>::epsilon() ||
-		BtoA.scale() < Sophus::SophusConstants<sophusType>::epsilon() ||
-		BtoAInfo(0,0) == 0 ||
-		BtoAInfo(6,6) == 0)
+	Worker* worker = acquireWorker();
+	SE3Tracker* tracker = &worker->se3Tracker;
+
+	SO3 disturbance = SO3::exp(Sophus::Vector3d(0.05,0,0));
+
+	for(int i=first;i<end;i++)
 	{
-		return 1e20;
+		CandidateJob &job = (*jobs)[i];
+
+		SE3 c2f_init = se3FromSim3(job.candidateToFrame_initialEstimate.inverse()).inverse();
+		c2f_init.so3() = c2f_init.so3() * disturbance;
+		SE3 c2f = tracker->trackFrameOnPermaref(job.candidate.get(), newKeyFrame->get(), c2f_init);
+		if(!tracker->trackingWasGood) {job.closeCheck = CandidateJob::CloseFailed; continue;}
+
+
+		SE3 f2c_init = se3FromSim3(job.candidateToFrame_initialEstimate).inverse();
+		f2c_init.so3() = disturbance * f2c_init.so3();
+		SE3 f2c = tracker->trackFrameOnPermaref(newKeyFrame->get(), job.candidate.get(), f2c_init);
+		if(!tracker->trackingWasGood) {job.closeCheck = CandidateJob::CloseFailed; continue;}
+
+		if((f2c.so3() * c2f.so3()).log().norm() >= 0.09) {job.closeCheck = CandidateJob::CloseInconsistent; continue;}
+
+		job.closeCheck = CandidateJob::CloseOk;
 	}
 
+	releaseWorker(worker);
+}
 
-	AtoB = constraintTracker->trackFrameSim3(
-			B,
-			A->keyframe.get(),
-			AtoB,
-			lvlStart,lvlEnd);
-	Matrix7x7 AtoBInfo = constraintTracker->lastSim3Hessian;
-	float AtoB_meanResidual = constraintTracker->lastResidual;
-	float AtoB_meanDResidual = constraintTracker->lastDepthResidual;
-	float AtoB_meanPResidual = constraintTracker->lastPhotometricResidual;
-	float AtoB_usage = constraintTracker->pointUsage;
+bool ConstraintSearchThread::Sim3Track::usable() const
+{
+	return !diverged &&
+		estimate.scale() <= 1 / Sophus::SophusConstants<sophusType>::epsilon() &&
+		estimate.scale() >= Sophus::SophusConstants<sophusType>::epsilon() &&
+		information(0,0) != 0 &&
+		information(6,6) != 0;
+}
 
+void ConstraintSearchThread::trackSim3Tasks(CandidateJobs* jobs, const std::vector<int>* active, int lvlStart, int lvlEnd, int first, int end, RunningStats* stats)
+{
+	Worker* worker = acquireWorker();
+	Sim3Tracker* tracker = &worker->sim3Tracker;
 
-	if (constraintTracker->diverged ||
-		AtoB.scale() > 1 / Sophus::SophusConstants<sophusType>::epsilon() ||
-		AtoB.scale() < Sophus::SophusConstants<sophusType>::epsilon() ||
-		AtoBInfo(0,0) == 0 ||
-		AtoBInfo(6,6) == 0)
+	for(int task=first;task<end;task++)
 	{
-		return 1e20;
+		CandidateJob &job = (*jobs)[(*active)[task / 2]];
+		const bool BtoA = (task % 2 == 0);
+		Sim3Track &track = BtoA ? job.BtoA : job.AtoB;
+
+		if(BtoA)
+			track.estimate = tracker->trackFrameSim3(
+					newKFTrackingReference,
+					job.reference->keyframe.get(),
+					track.estimate,
+					lvlStart,lvlEnd);
+		else
+			track.estimate = tracker->trackFrameSim3(
+					job.reference,
+					newKFTrackingReference->keyframe.get(),
+					track.estimate,
+					lvlStart,lvlEnd);
+
+		track.information = tracker->lastSim3Hessian;
+		track.meanResidual = tracker->lastResidual;
+		track.meanResidualD = tracker->lastDepthResidual;
+		track.meanResidualP = tracker->lastPhotometricResidual;
+		track.usage = tracker->pointUsage;
+		track.diverged = tracker->diverged;
 	}
 
+	releaseWorker(worker);
+}
+
+float ConstraintSearchThread::reciprocalConsistency(const CandidateJob &job, KFConstraintStruct* e1, KFConstraintStruct* e2)
+{
+	const Sim3Track &BtoA = job.BtoA, &AtoB = job.AtoB;
+
+	if(!BtoA.usable() || !AtoB.usable())
+		return 1e20;
+
 	// Propagate uncertainty (with d(a * b) / d(b) = Adj_a) and calculate Mahalanobis norm
-	Matrix7x7 datimesb_db = AtoB.cast<float>().Adj();
-	Matrix7x7 diffHesse = (AtoBInfo.inverse() + datimesb_db * BtoAInfo.inverse() * datimesb_db.transpose()).inverse();
-	Vector7 diff = (AtoB * BtoA).log().cast<float>();
+	Matrix7x7 datimesb_db = AtoB.estimate.cast<float>().Adj();
+	Matrix7x7 diffHesse = (AtoB.information.inverse() + datimesb_db * BtoA.information.inverse() * datimesb_db.transpose()).inverse();
+	Vector7 diff = (AtoB.estimate * BtoA.estimate).log().cast<float>();
 
 
 	float reciprocalConsistency = (diffHesse * diff).dot(diff);
@@ -640,23 +699,23 @@ float ConstraintSearchThread::tryTrackSim3(
 
 	if(e1 != 0 && e2 != 0)
 	{
-		e1->firstFrame = A->keyframe;
-		e1->secondFrame = B->keyframe;
-		e1->secondToFirst = BtoA;
-		e1->information = BtoAInfo.cast<double>();
-		e1->meanResidual = BtoA_meanResidual;
-		e1->meanResidualD = BtoA_meanDResidual;
-		e1->meanResidualP = BtoA_meanPResidual;
-		e1->usage = BtoA_usage;
-
-		e2->firstFrame = B->keyframe;
-		e2->secondFrame = A->keyframe;
-		e2->secondToFirst = AtoB;
-		e2->information = AtoBInfo.cast<double>();
-		e2->meanResidual = AtoB_meanResidual;
-		e2->meanResidualD = AtoB_meanDResidual;
-		e2->meanResidualP = AtoB_meanPResidual;
-		e2->usage = AtoB_usage;
+		e1->firstFrame = newKFTrackingReference->keyframe;
+		e1->secondFrame = job.reference->keyframe;
+		e1->secondToFirst = BtoA.estimate;
+		e1->information = BtoA.information.cast<double>();
+		e1->meanResidual = BtoA.meanResidual;
+		e1->meanResidualD = BtoA.meanResidualD;
+		e1->meanResidualP = BtoA.meanResidualP;
+		e1->usage = BtoA.usage;
+
+		e2->firstFrame = job.reference->keyframe;
+		e2->secondFrame = newKFTrackingReference->keyframe;
+		e2->secondToFirst = AtoB.estimate;
+		e2->information = AtoB.information.cast<double>();
+		e2->meanResidual = AtoB.meanResidual;
+		e2->meanResidualD = AtoB.meanResidualD;
+		e2->meanResidualP = AtoB.meanResidualP;
+		e2->usage = AtoB.usage;
 
 		e1->reciprocalConsistency = e2->reciprocalConsistency = reciprocalConsistency;
 	}
@@ -665,93 +724,80 @@ float ConstraintSearchThread::tryTrackSim3(
 }
 
 
-void ConstraintSearchThread::testConstraint(
-		const Frame::SharedPtr &candidate,
-		KFConstraintStruct* &e1_out, KFConstraintStruct* &e2_out,
-		Sim3 candidateToFrame_initialEstimate,
-		float strictness)
+void ConstraintSearchThread::testConstraints(CandidateJobs &jobs)
 {
-	candidateTrackingReference->importFrame(candidate);
-
-	Sim3 FtoC = candidateToFrame_initialEstimate.inverse(), CtoF = candidateToFrame_initialEstimate;
-	Matrix7x7 FtoCInfo, CtoFInfo;
+	// pyramid levels and error thresholds (times strictness) of the stages.
+	static const int stageLevels[3][2] = { {SIM3TRACKING_MAX_LEVEL-1, 3}, {2, 2}, {1, 1} };
+	static const float stageThreshold[3] = { 3000, 4000, 6000 };
 
-	float err_level3 = tryTrackSim3(
-			newKFTrackingReference, candidateTrackingReference,	// A = frame; b = candidate
-			SIM3TRACKING_MAX_LEVEL-1, 3,
-			USESSE,
-			FtoC, CtoF);
-
-	if(err_level3 > 3000*strictness)
+	std::vector<int> active;
+	for(unsigned int i=0;i<jobs.size();i++)
 	{
-		if(enablePrintDebugInfo && printConstraintSearchInfo)
-			printf("FAILE %d -> %d (lvl %d): errs (%.1f / - / -).",
-				newKFTrackingReference->frameID, candidateTrackingReference->frameID,
-				3,
-				sqrtf(err_level3));
-
-		e1_out = e2_out = 0;
-
-		newKFTrackingReference->keyframe->trackingFailed.insert(std::pair< Frame::SharedPtr,Sim3>(candidate, candidateToFrame_initialEstimate));
-		return;
+		CandidateJob &job = jobs[i];
+		job.reference = _referenceCache.acquire(job.candidate);
+		job.BtoA.estimate = job.candidateToFrame_initialEstimate;
+		job.AtoB.estimate = job.candidateToFrame_initialEstimate.inverse();
+		job.err[0] = job.err[1] = job.err[2] = 0;
+		job.e1 = job.e2 = 0;
+		active.push_back(i);
 	}
 
-	float err_level2 = tryTrackSim3(
-			newKFTrackingReference, candidateTrackingReference,	// A = frame; b = candidate
-			2, 2,
-			USESSE,
-			FtoC, CtoF);
-
-	if(err_level2 > 4000*strictness)
+	for(int stage=0; stage<3 && !active.empty(); stage++)
 	{
-		if(enablePrintDebugInfo && printConstraintSearchInfo)
-			printf("FAILE %d -> %d (lvl %d): errs (%.1f / %.1f / -).",
-				newKFTrackingReference->frameID, candidateTrackingReference->frameID,
-				2,
-				sqrtf(err_level3), sqrtf(err_level2));
-
-		e1_out = e2_out = 0;
-		newKFTrackingReference->keyframe->trackingFailed.insert(std::pair<Frame::SharedPtr,Sim3>(candidate, candidateToFrame_initialEstimate));
-		return;
-	}
+		threadReducer.reduce(boost::bind(&ConstraintSearchThread::trackSim3Tasks, this, &jobs, &active,
+				stageLevels[stage][0], stageLevels[stage][1], _1, _2, _3), 0, 2*active.size(), 1);
 
-	e1_out = new KFConstraintStruct();
-	e2_out = new KFConstraintStruct();
+		std::vector<int> passed;
+		for(int i : active)
+		{
+			CandidateJob &job = jobs[i];
 
+			if(stage == 2)
+			{
+				job.e1 = new KFConstraintStruct();
+				job.e2 = new KFConstraintStruct();
+			}
 
-	float err_level1 = tryTrackSim3(
-			newKFTrackingReference, candidateTrackingReference,	// A = frame; b = candidate
-			1, 1,
-			USESSE,
-			FtoC, CtoF, e1_out, e2_out);
+			job.err[stage] = reciprocalConsistency(job, job.e1, job.e2);
+			if(job.err[stage] <= stageThreshold[stage]*job.strictness)
+			{
+				passed.push_back(i);
+				continue;
+			}
 
-	if(err_level1 > 6000*strictness)
-	{
-		if(enablePrintDebugInfo && printConstraintSearchInfo)
-			printf("FAILED %d -> %d (lvl %d): errs (%.1f / %.1f / %.1f).",
-					newKFTrackingReference->frameID, candidateTrackingReference->frameID,
-					1,
-					sqrtf(err_level3), sqrtf(err_level2), sqrtf(err_level1));
-
-		delete e1_out;
-		delete e2_out;
-		e1_out = e2_out = 0;
-		newKFTrackingReference->keyframe->trackingFailed.insert(std::pair<Frame::SharedPtr,Sim3>(candidate, candidateToFrame_initialEstimate));
-		return;
+			if(enablePrintDebugInfo && printConstraintSearchInfo)
+				printf("FAILED %d -> %d (lvl %d): errs (%.1f / %.1f / %.1f).",
+						newKFTrackingReference->frameID, job.reference->frameID,
+						stageLevels[stage][1],
+						sqrtf(job.err[0]), sqrtf(job.err[1]), sqrtf(job.err[2]));
+
+			delete job.e1;
+			delete job.e2;
+			job.e1 = job.e2 = 0;
+			_referenceCache.release(job.reference);
+			job.reference = 0;
+		}
+		active.swap(passed);
 	}
 
+	const float kernelDelta = 5 * sqrt(6000*loopclosureStrictness);
+	for(int i : active)
+	{
+		CandidateJob &job = jobs[i];
 
-	if(enablePrintDebugInfo && printConstraintSearchInfo)
-		printf("ADDED %d -> %d: errs (%.1f / %.1f / %.1f).",
-			newKFTrackingReference->frameID, candidateTrackingReference->frameID,
-			sqrtf(err_level3), sqrtf(err_level2), sqrtf(err_level1));
+		if(enablePrintDebugInfo && printConstraintSearchInfo)
+			printf("ADDED %d -> %d: errs (%.1f / %.1f / %.1f).",
+				newKFTrackingReference->frameID, job.reference->frameID,
+				sqrtf(job.err[0]), sqrtf(job.err[1]), sqrtf(job.err[2]));
 
+		job.e1->robustKernel = new g2o::RobustKernelHuber();
+		job.e1->robustKernel->setDelta(kernelDelta);
+		job.e2->robustKernel = new g2o::RobustKernelHuber();
+		job.e2->robustKernel->setDelta(kernelDelta);
 
-	const float kernelDelta = 5 * sqrt(6000*loopclosureStrictness);
-	e1_out->robustKernel = new g2o::RobustKernelHuber();
-	e1_out->robustKernel->setDelta(kernelDelta);
-	e2_out->robustKernel = new g2o::RobustKernelHuber();
-	e2_out->robustKernel->setDelta(kernelDelta);
+		_referenceCache.release(job.reference);
+		job.reference = 0;
+	}
 }
 
 
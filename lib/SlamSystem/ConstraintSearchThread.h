@@ -6,10 +6,12 @@
 
 #include "util/Configuration.h"
 #include "util/ThreadMutexObject.h"
+#include "util/IndexThreadReduce.h"
 #include "GlobalMapping/TrackableKeyFrameSearch.h"
 #include "Tracking/SE3Tracker.h"
 #include "Tracking/Sim3Tracker.h"
 #include "Tracking/TrackingReference.h"
+#include "Tracking/TrackingReferenceCache.h"
 
 namespace lsd_slam {
 
@@ -31,14 +33,74 @@ public:
 
 	ThreadSynchronizer fullReConstraintTrackComplete;
 
+	TrackingReferenceCache &referenceCache( void ) { return _referenceCache; }
+
 private:
 
 	SlamSystem &_system;
 
-	Sim3Tracker* constraintTracker;
-	SE3Tracker* constraintSE3Tracker;
+	// tracking state of one verification worker; nothing in here is shared.
+	struct Worker
+	{
+		Worker( const ImageSize &sz )
+			: sim3Tracker( sz ), se3Tracker( sz ) {}
+
+		Sim3Tracker sim3Tracker;
+		SE3Tracker se3Tracker;
+	};
+
+	// one direction of a candidate's reciprocal Sim3 track.
+	struct Sim3Track
+	{
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+		Sim3 estimate;
+		Matrix7x7 information;
+		float meanResidual, meanResidualD, meanResidualP, usage;
+		bool diverged;
+
+		// false if the track diverged or is degenerate.
+		bool usable() const;
+	};
+
+	// a candidate of a parallel verification pass. Results are written to
+	// the job and merged in job order afterwards.
+	struct CandidateJob
+	{
+		EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+		CandidateJob( const Frame::SharedPtr &c, const Sim3 &candidateToFrame, float s )
+			: candidate( c ), candidateToFrame_initialEstimate( candidateToFrame ), strictness( s ),
+				closeCheck( CloseOk ), e1( 0 ), e2( 0 ), reference( 0 ) {}
+
+		Frame::SharedPtr candidate;
+		Sim3 candidateToFrame_initialEstimate;
+		float strictness;
+
+		enum { CloseOk, CloseFailed, CloseInconsistent } closeCheck;
+		KFConstraintStruct* e1;
+		KFConstraintStruct* e2;
+
+		// testConstraints() state, with A = new keyframe, B = candidate.
+		TrackingReference* reference;
+		Sim3Track BtoA, AtoB;
+		float err[3];					// per stage
+	};
+	typedef std::vector<CandidateJob, Eigen::aligned_allocator<CandidateJob> > CandidateJobs;
+
+	std::vector<Worker*> workers;
+	std::vector<Worker*> idleWorkers;
+	boost::mutex idleWorkersMutex;
+	IndexThreadReduce threadReducer;
+
+	Worker* acquireWorker();
+	void releaseWorker( Worker* worker );
+
+	// built point clouds of keyframes, shared by all workers.
+	TrackingReferenceCache _referenceCache;
+
+	// taken from _referenceCache for the duration of findConstraintsForNewKeyFrames.
 	TrackingReference* newKFTrackingReference;
-	TrackingReference* candidateTrackingReference;
 
 	int _failedToRetrack;
 	int lastNumConstraintsAddedOnFullRetrack;
@@ -53,18 +115,18 @@ private:
 
 	std::unique_ptr<active_object::ActiveIdle> _thread;
 
-	float tryTrackSim3(
-			TrackingReference* A, TrackingReference* B,
-			int lvlStart, int lvlEnd,
-			bool useSSE,
-			Sim3 &AtoB, Sim3 &BtoA,
-			KFConstraintStruct* e1=0, KFConstraintStruct* e2=0);
-
-	void testConstraint(
-			const Frame::SharedPtr &candidate,
-			KFConstraintStruct* &e1_out, KFConstraintStruct* &e2_out,
-			Sim3 candidateToFrame_initialEstimate,
-			float strictness);
+	// reciprocal SE3 check of close candidates on their permaRefs.
+	void checkCloseCandidates(const Frame::SharedPtr* newKeyFrame, CandidateJobs* jobs, int first, int end, RunningStats* stats);
+	// reciprocal Sim3 check of jobs against newKFTrackingReference, coarse to
+	// fine in three stages. Each stage tracks both directions of all
+	// remaining candidates as separate tasks on threadReducer. e1 / e2 of
+	// a job are 0 if it failed.
+	void testConstraints(CandidateJobs &jobs);
+	// task t tracks B->A (even t) or A->B (odd t) of jobs[active[t/2]].
+	void trackSim3Tasks(CandidateJobs* jobs, const std::vector<int>* active, int lvlStart, int lvlEnd, int first, int end, RunningStats* stats);
+	// consistency of a job's two tracks (1e20 if either is unusable).
+	// Fills e1 / e2 if given.
+	float reciprocalConsistency(const CandidateJob &job, KFConstraintStruct* e1=0, KFConstraintStruct* e2=0);
 
 };
 
@@ -0,0 +1,115 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SlamSystem/LoadController.h"
+
+#include <algorithm>
+
+#include <g3log/g3log.hpp>
+
+#include "util/settings.h"
+
+namespace lsd_slam
+{
+
+// updates in a row needed to step up / down a level. Stepping down is
+// slower so a backlog that is just being worked off does not oscillate.
+static const int StepUpAfter = 3;
+static const int StepDownAfter = 30;
+
+
+LoadController::LoadController( const Configuration &conf )
+	: _enabled( conf.adaptiveLoadShedding ),
+	  _maxLagMs( conf.loadSheddingMaxLagMs ),
+	  _level( FULL_QUALITY ),
+	  _overloaded( 0 ),
+	  _caughtUp( 0 ),
+	  _trackingCounter( 0 ),
+	  _lagMs( 0 ),
+	  _levelChanges( 0 ),
+	  _framesSkipped( 0 ),
+	  _referencesSkipped( 0 )
+{
+}
+
+bool LoadController::update( int queuedFrames, int queueBound, float mapMsPerFrame )
+{
+	float lagMs = queuedFrames * mapMsPerFrame;
+	_lagMs = lagMs;
+
+	if( !_enabled ) return false;
+
+	bool overloaded = queuedFrames > queueBound / 2 || lagMs > _maxLagMs;
+	bool caughtUp = queuedFrames <= std::max( 1, queueBound / 10 ) && lagMs < 0.25f * _maxLagMs;
+
+	_overloaded = overloaded ? _overloaded+1 : 0;
+	_caughtUp = caughtUp ? _caughtUp+1 : 0;
+
+	int level = _level;
+	if( _overloaded >= StepUpAfter && level < NUM_LEVELS-1 )
+		level++;
+	else if( _caughtUp >= StepDownAfter && level > FULL_QUALITY )
+		level--;
+	else
+		return false;
+
+	_overloaded = _caughtUp = 0;
+	_level = level;
+	_levelChanges++;
+
+	LOG(INFO) << "Mapping " << queuedFrames << " frames (~" << lagMs << " ms) behind, load shedding now "
+						<< levelName( (Level)level );
+	return true;
+}
+
+bool LoadController::shouldTrack()
+{
+	int interval = trackingInterval();
+	if( interval <= 1 || (_trackingCounter++ % interval) == 0 ) return true;
+
+	_framesSkipped++;
+	return false;
+}
+
+const char *LoadController::levelName( Level level )
+{
+	switch( level ) {
+		case FULL_QUALITY:     return "FULL_QUALITY";
+		case REDUCED_STEREO:   return "REDUCED_STEREO";
+		case SKIP_REDUNDANT:   return "SKIP_REDUNDANT";
+		case REDUCED_TRACKING: return "REDUCED_TRACKING";
+		default:               return "?";
+	}
+}
+
+int LoadController::observeStride() const
+{
+	Level l = level();
+	if( l >= SKIP_REDUNDANT ) return 4;
+	if( l >= REDUCED_STEREO ) return 2;
+	return 1;
+}
+
+int LoadController::trackingMinLevel() const
+{
+	return level() >= REDUCED_TRACKING ? SE3TRACKING_MIN_LEVEL+1 : SE3TRACKING_MIN_LEVEL;
+}
+
+}
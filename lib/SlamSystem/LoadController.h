@@ -0,0 +1,99 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+
+#include "util/Configuration.h"
+
+
+namespace lsd_slam
+{
+
+/**
+ * Trades quality for throughput when mapping falls behind tracking.
+ *
+ * The mapping thread feeds it the mapping queue depth and the time it
+ * takes to map one frame after every pass. When the backlog (in frames or
+ * in estimated milliseconds until it is mapped) stays too large, it steps
+ * up one shedding level; once the backlog has stayed small for a while, it
+ * steps back down. Each level keeps the savings of the ones below it:
+ *
+ *  REDUCED_STEREO    stereo search on a sparser pixel grid (every 2nd pixel)
+ *  SKIP_REDUNDANT    ... and a stride of 4, and queued frames that barely
+ *                        moved relative to the frame mapped before them
+ *                        are skipped
+ *  REDUCED_TRACKING  ... and only every 2nd frame is tracked, down to a
+ *                        coarser pyramid level
+ */
+class LoadController
+{
+public:
+	enum Level { FULL_QUALITY = 0, REDUCED_STEREO, SKIP_REDUNDANT, REDUCED_TRACKING, NUM_LEVELS };
+
+	LoadController( const Configuration &conf );
+
+	//=== mapping thread ===
+
+	/** Re-evaluates the level. Returns true if it changed. */
+	bool update( int queuedFrames, int queueBound, float mapMsPerFrame );
+
+	void addReferencesSkipped( int n ) { _referencesSkipped += n; }
+
+	//=== tracking thread ===
+
+	/** False for frames that should not be tracked at the current level. */
+	bool shouldTrack();
+
+	//=== any thread ===
+
+	Level level() const { return (Level)_level.load(); }
+	static const char *levelName( Level level );
+
+	int observeStride() const;
+	bool skipRedundantReferences() const { return level() >= SKIP_REDUNDANT; }
+	int trackingInterval() const { return level() >= REDUCED_TRACKING ? 2 : 1; }
+	int trackingMinLevel() const;
+
+	// metrics
+	float lagMs() const { return _lagMs; }
+	int levelChanges() const { return _levelChanges; }
+	int framesSkipped() const { return _framesSkipped; }
+	int referencesSkipped() const { return _referencesSkipped; }
+
+private:
+	const bool _enabled;
+	const float _maxLagMs;
+
+	std::atomic<int> _level;
+
+	// consecutive updates above / below the thresholds.
+	int _overloaded, _caughtUp;
+
+	unsigned int _trackingCounter;
+
+	std::atomic<float> _lagMs;
+	std::atomic<int> _levelChanges;
+	std::atomic<int> _framesSkipped;
+	std::atomic<int> _referencesSkipped;
+};
+
+}
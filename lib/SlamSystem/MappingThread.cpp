@@ -21,15 +21,19 @@ using active_object::ActiveIdle;
 
 // static const bool depthMapScreenshotFlag = true;
 
+// baseline between two queued frames (times the keyframe's mean inverse
+// depth) below which the second is skipped while shedding load.
+static const float redundantReferenceDist = 0.01f;
+
 
 MappingThread::MappingThread( SlamSystem &system )
 	: relocalizer( system.conf() ),
 		_system(system ),
 		_newKeyFrame( nullptr ),
-		unmappedTrackedFrames(),
+		_mappingWakeupPending( false ),
+		unmappedTrackedFrames( system.conf().mappingQueueSize, system.conf().mappingQueuePolicy ),
+		loadController( system.conf() ),
 		map( new DepthMap( system.conf() ) ),
-		unmappedTrackedFramesMutex(),
-		trackedFramesMapped(),
 		mappingTrackingReference( new TrackingReference() ),
 		_thread( ActiveIdle::createActiveIdle( std::bind( &MappingThread::callbackIdle, this ), std::chrono::milliseconds(200)) )
 {
@@ -68,33 +72,18 @@ void MappingThread::callbackIdle( void )
 
 void MappingThread::callbackUnmappedTrackedFrames( void )
 {
-	bool nMapped = false;
-	size_t sz = 0;
-	{
-		std::lock_guard<std::mutex> lock( unmappedTrackedFramesMutex );
-		sz = unmappedTrackedFrames.size();
+	// frames pushed from here on need a new callback.
+	_mappingWakeupPending = false;
 
-		if( sz > 0 )
-			nMapped = unmappedTrackedFrames.back()->trackingParent()->numMappedOnThisTotal < 10;
-	}
+	int dropped = unmappedTrackedFrames.trim();
 
-	LOG(INFO) << "In unmapped tracked frames callback with " << sz << " frames";
+	loadController.update( unmappedTrackedFrames.size(), unmappedTrackedFrames.bound(), map->_perf.update.ms() );
+	map->setObserveStride( loadController.observeStride() );
 
-	if(sz < 50 ||
-	  (sz < 100 && nMapped) ) {
+	LOG(INFO) << "In unmapped tracked frames callback with " << unmappedTrackedFrames.size() << " frames"
+						<< (dropped > 0 ? " (" + std::to_string(dropped) + " dropped)" : std::string());
 
-		while( doMappingIteration() ) { ; }
-
-		// TODO:  Was originally in the while() loop above.  However, there are
-		// circumstances (if there's one untracked thread in the queue referenced
-		// to an older keyframe) where doMappingIteration will return false, and this
-		// notify never happens.   If that happens, TrackingThread will stop if it's
-		// waiting on the signal.
-		//
-		// This should be called once per callback otherwise TrackingThread might get hung up?
-		trackedFramesMapped.notify();
-		//}
-	}
+	while( doMappingIteration() ) { ; }
 
 	LOG(INFO) << "Done mapping.";
 }
@@ -107,12 +96,22 @@ void MappingThread::callbackMergeOptimizationOffset()
 	bool didUpdate = false;
 
 	// if(_optThread->haveUnmergedOptimizationOffset())
+	PoseSnapshot::ConstPtr poses = _system.keyFrameGraph()->takeOptimizationResult();
+	if( poses )
 	{
-		boost::shared_lock_guard< boost::shared_mutex > pose_lock(_system.poseConsistencyMutex);
 		boost::shared_lock_guard< boost::shared_mutex > kfLock( _system.keyFrameGraph()->keyframesAllMutex);
 
+		Sim3 camToWorld;
 		for(unsigned int i=0;i<_system.keyFrameGraph()->keyframesAll.size(); i++)
-			_system.keyFrameGraph()->keyframesAll[i]->pose->applyPoseGraphOptResult();
+			if(poses->find(_system.keyFrameGraph()->keyframesAll[i]->id(), camToWorld))
+			{
+				_system.keyFrameGraph()->keyframesAll[i]->pose->setPoseGraphOptResult(camToWorld);
+				_system.keyFrameGraph()->keyframesAll[i]->pose->applyPoseGraphOptResult();
+			}
+
+		// readers switch over to the new poses at once.
+		_system.keyFrameGraph()->publishPoseSnapshot(poses);
+		_system.keyFrameGraph()->trajectory.update(*poses);
 
 		// _optThread->clearUnmergedOptimizationOffset();
 
@@ -236,7 +235,7 @@ bool MappingThread::doMappingIteration()
 
 		// start relocalizer if it isnt running already
 		if(!relocalizer.isRunning)
-			relocalizer.start(_system.keyFrameGraph()->keyframesAll);
+			relocalizer.start(_system.keyFrameGraph()->keyframesAll, &_system.trackableKeyFrameSearch()->thumbnailIndex());
 
 		// did we find a frame to relocalize with?
 		if(relocalizer.waitResult(50)) {
@@ -266,49 +265,52 @@ bool MappingThread::doMappingIteration()
 
 bool MappingThread::updateKeyframe()
 {
-	std::shared_ptr<Frame> reference = nullptr;
-	std::deque< std::shared_ptr<Frame> > references;
-
-	unmappedTrackedFramesMutex.lock();
-
 	// Drops frames that have a different tracking parent.
 	while(unmappedTrackedFrames.size() > 0 &&
-			  (!unmappedTrackedFrames.front()->hasTrackingParent() ||
-			   !unmappedTrackedFrames.front()->isTrackingParent( _system.currentKeyFrame().const_ref() ) ) ) {
-					 if( unmappedTrackedFrames.front()->hasTrackingParent() ) {
-					 LOG(INFO) << "Dropping frame " << unmappedTrackedFrames.front()->id()
-					  				<< " its has tracking parent " << unmappedTrackedFrames.front()->trackingParent()->id()
-										<< " current keyframe is " << _system.currentKeyFrame().const_ref()->id();
-						} else {
-							LOG(INFO) << "Dropping frame " << unmappedTrackedFrames.front()->id() << " which doesn't have a tracking parent";
-						}
-		unmappedTrackedFrames.front()->clear_refPixelWasGood();
-		unmappedTrackedFrames.pop_front();
+			  (!unmappedTrackedFrames.batch().front()->hasTrackingParent() ||
+			   !unmappedTrackedFrames.batch().front()->isTrackingParent( _system.currentKeyFrame().const_ref() ) ) ) {
+		Frame::SharedPtr front = unmappedTrackedFrames.popFront();
+		if( front->hasTrackingParent() ) {
+			LOG(INFO) << "Dropping frame " << front->id()
+								<< " its has tracking parent " << front->trackingParent()->id()
+								<< " current keyframe is " << _system.currentKeyFrame().const_ref()->id();
+		} else {
+			LOG(INFO) << "Dropping frame " << front->id() << " which doesn't have a tracking parent";
+		}
+		front->clear_refPixelWasGood();
 	}
 
-	// clone list
-	if(unmappedTrackedFrames.size() > 0) {
-		// Copies all but only pops one?
-		 for(unsigned int i=0;i<unmappedTrackedFrames.size(); i++)
-		 	references.push_back(unmappedTrackedFrames[i]);
-		//unmappedTrackedFrames().swap( references );
+	// maps all queued frames in place, then retires the oldest.  The batch
+	// is a view of the queue, so tracking can keep pushing meanwhile.
+	TrackedFrameQueue::Batch references = unmappedTrackedFrames.batch();
+	if(references.empty())
+		return false;
 
-		std::shared_ptr<Frame> popped = unmappedTrackedFrames.front();
-		unmappedTrackedFrames.pop_front();
-		unmappedTrackedFramesMutex.unlock();
+	LOGF_IF( INFO, printThreadingInfo,
+		"MAPPING frames %d to %d (%d frames) onto keyframe %d", references.front()->id(), references.back()->id(), (int)references.size(),  _system.currentKeyFrame().const_ref()->id());
 
-		LOGF_IF( INFO, printThreadingInfo,
-			"MAPPING frames %d to %d (%d frames) onto keyframe %d", references.front()->id(), references.back()->id(), (int)references.size(),  _system.currentKeyFrame().const_ref()->id());
+	map->updateKeyframe(references);
 
-		map->updateKeyframe(references);
+	Frame::SharedPtr mapped = unmappedTrackedFrames.popFront();
+	mapped->clear_refPixelWasGood();
 
-		popped->clear_refPixelWasGood();
-		references.clear();
-	}
-	else
-	{
-		unmappedTrackedFramesMutex.unlock();
-		return false;
+	// while shedding load, also retire the queued frames that add little
+	// over the one just mapped: same keyframe, and less than
+	// redundantReferenceDist of baseline (relative to the scene depth) to it.
+	if( loadController.skipRedundantReferences() ) {
+		const float kfIdepth = _system.currentKeyFrame().const_ref()->meanIdepth;
+		int skipped = 0;
+		while( unmappedTrackedFrames.size() > 1 ) {
+			const Frame::SharedPtr &next = unmappedTrackedFrames.batch().front();
+			if( !next->isTrackingParent( mapped->trackingParent() ) ) break;
+
+			Sophus::Vector3d baseline = next->pose->thisToParent_raw.translation() - mapped->pose->thisToParent_raw.translation();
+			if( baseline.norm() * kfIdepth >= redundantReferenceDist ) break;
+
+			unmappedTrackedFrames.popFront()->clear_refPixelWasGood();
+			skipped++;
+		}
+		loadController.addReferencesSkipped( skipped );
 	}
 
 
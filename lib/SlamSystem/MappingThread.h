@@ -4,6 +4,7 @@
 
 #include <mutex>
 #include <memory>
+#include <atomic>
 
 #include <boost/thread/shared_mutex.hpp>
 
@@ -12,7 +13,9 @@
 #include "util/MovingAverage.h"
 #include "util/ThreadMutexObject.h"
 
+#include "DataStructures/TrackedFrameQueue.h"
 #include "DepthEstimation/DepthMap.h"
+#include "SlamSystem/LoadController.h"
 #include "Tracking/TrackingReference.h"
 
 #include "Tracking/Relocalizer.h"
@@ -30,14 +33,17 @@ public:
 	~MappingThread();
 
 	//=== Callbacks into the thread ===
-	void pushUnmappedTrackedFrame( const Frame::SharedPtr &frame )
+	// Only one thread may push at a time: the tracking thread, or the mapping
+	// thread itself while it hands over a relocalization result (tracking is
+	// bad then, so the tracking thread is not pushing).  The latter must not
+	// block, as it is the thread that empties the queue.
+	void pushUnmappedTrackedFrame( const Frame::SharedPtr &frame, bool mayBlock = true )
 	{
-		{
-			std::lock_guard<std::mutex> lock(unmappedTrackedFramesMutex );
-			unmappedTrackedFrames.push_back( frame );
-		}
+		if( !unmappedTrackedFrames.push( frame, mayBlock ) )
+			LOG_IF(DEBUG, printThreadingInfo) << "Mapping queue full, dropped frame " << frame->id();
 
-		if( _thread ) {
+		// one pending callback picks up everything queued until it runs.
+		if( _thread && !_mappingWakeupPending.exchange( true ) ) {
 			_thread->send( std::bind( &MappingThread::callbackUnmappedTrackedFrames, this ));
 		}
 	}
@@ -71,9 +77,10 @@ public:
 	// SET & READ EVERYWHERE
 	// std::mutex currentKeyFrameMutex;
 
-	std::deque< Frame::SharedPtr > unmappedTrackedFrames;
-	std::mutex unmappedTrackedFramesMutex;
-	ThreadSynchronizer trackedFramesMapped;
+	TrackedFrameQueue unmappedTrackedFrames;
+
+	// adapts mapping and tracking quality to the backlog in unmappedTrackedFrames.
+	LoadController loadController;
 
 	// during re-localization used
 	Relocalizer relocalizer;
@@ -89,6 +96,8 @@ private:
 
 	MutexObject< Frame::SharedPtr > _newKeyFrame;
 
+	std::atomic<bool> _mappingWakeupPending;
+
 	// == Thread callbacks ==
 	void callbackIdle( void );
 	void callbackUnmappedTrackedFrames( void );
@@ -16,6 +16,7 @@ namespace lsd_slam {
 OptimizationThread::OptimizationThread( SlamSystem &system, bool enabled )
 	: //_haveUnmergedOptimizationOffset( false ),
 		_system( system ),
+		_poseSnapshotVersion( 0 ),
 		_thread( enabled ? ActiveIdle::createActiveIdle( std::bind( &OptimizationThread::callbackIdle, this ), std::chrono::milliseconds(2000)) : NULL )
 {
 	LOG(INFO) << "Started optimization thread";
@@ -51,6 +52,7 @@ void OptimizationThread::callbackNewConstraint( void )
 void OptimizationThread::callbackFinalOptimization( void )
 {
 	LOG(INFO) << "Running final optimization!";
+	_system.keyFrameGraph()->requestGlobalOptimization();
 	optimizationIteration(50, 0.001);
 	_system.mapThread->mergeOptimizationUpdate();
 	finalOptimizationComplete.notify();
@@ -72,25 +74,33 @@ bool OptimizationThread::optimizationIteration(int itsPerTry, float minChange)
 	// Do the optimization. This can take quite some time!
 	int its = _system.keyFrameGraph()->optimize(itsPerTry);
 
-	// save the optimization result.
-	_system.poseConsistencyMutex.lock_shared();
-	_system.keyFrameGraph()->keyframesAllMutex.lock_shared();
+	// save the optimization result. The vertices belong to this thread, only
+	// the keyframe list has to be locked.
+	std::vector<Frame::SharedPtr> keyframes;
+	{
+		boost::shared_lock_guard< boost::shared_mutex > kfLock( _system.keyFrameGraph()->keyframesAllMutex );
+		keyframes = _system.keyFrameGraph()->keyframesAll;
+	}
+
+	PoseSnapshot::ConstPtr merged = _system.keyFrameGraph()->poseSnapshot();
+	std::shared_ptr<PoseSnapshot> result = std::make_shared<PoseSnapshot>(++_poseSnapshotVersion);
+
 	float maxChange = 0;
 	float sumChange = 0;
 	float sum = 0;
-	for(size_t i=0;i<_system.keyFrameGraph()->keyframesAll.size(); i++)
+	for(size_t i=0;i<keyframes.size(); i++)
 	{
 		// set edge error sum to zero
-		_system.keyFrameGraph()->keyframesAll[i]->edgeErrorSum = 0;
-		_system.keyFrameGraph()->keyframesAll[i]->edgesNum = 0;
+		keyframes[i]->edgeErrorSum = 0;
+		keyframes[i]->edgesNum = 0;
 
-		if(!_system.keyFrameGraph()->keyframesAll[i]->pose->isInGraph) continue;
+		if(!keyframes[i]->pose->isInGraph) continue;
 
 
 
 		// get change from last optimization
-		Sim3 a = _system.keyFrameGraph()->keyframesAll[i]->pose->graphVertex->estimate();
-		Sim3 b = _system.keyFrameGraph()->keyframesAll[i]->getCamToWorld();
+		Sim3 a = keyframes[i]->pose->graphVertex->estimate();
+		Sim3 b = merged->getCamToWorld(*keyframes[i]->pose);
 		Sophus::Vector7f diff = (a*b.inverse()).log().cast<float>();
 
 
@@ -103,19 +113,18 @@ bool OptimizationThread::optimizationIteration(int itsPerTry, float minChange)
 		sum +=7;
 
 		// set change
-		_system.keyFrameGraph()->keyframesAll[i]->pose->setPoseGraphOptResult(
-				_system.keyFrameGraph()->keyframesAll[i]->pose->graphVertex->estimate());
+		result->set(keyframes[i]->id(), a);
 
 		// add error
-		for(auto edge : _system.keyFrameGraph()->keyframesAll[i]->pose->graphVertex->edges())
+		for(auto edge : keyframes[i]->pose->graphVertex->edges())
 		{
-			_system.keyFrameGraph()->keyframesAll[i]->edgeErrorSum += ((EdgeSim3*)(edge))->chi2();
-			_system.keyFrameGraph()->keyframesAll[i]->edgesNum++;
+			keyframes[i]->edgeErrorSum += ((EdgeSim3*)(edge))->chi2();
+			keyframes[i]->edgesNum++;
 		}
 	}
 
-	_system.keyFrameGraph()->keyframesAllMutex.unlock_shared();
-	_system.poseConsistencyMutex.unlock_shared();
+	// picked up by the next merge.
+	_system.keyFrameGraph()->setOptimizationResult(result);
 
 	LOGF_IF(DEBUG, enablePrintDebugInfo && printOptimizationInfo,
 					"did %d optimization iterations. Max Pose Parameter Change: %f; avgChange: %f. %s\n",
@@ -65,6 +65,9 @@ private:
 
 	SlamSystem &_system;
 
+	// version of the last PoseSnapshot handed to the merge.
+	int _poseSnapshotVersion;
+
 	std::unique_ptr<active_object::ActiveIdle> _thread;
 
 };
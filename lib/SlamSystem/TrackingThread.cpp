@@ -62,7 +62,9 @@ TrackingThread::TrackingThread( SlamSystem &system )
 //	_system.currentKeyFrame( system.currentKeyFrame ),
 	_tracker( new SE3Tracker( system.conf().slamImage ) ),
 	_trackingReference( new TrackingReference() ),
-	_trackingIsGood( true )
+	_trackingIsGood( true ),
+	_deferredFrame( nullptr ),
+	_deferredIsKeyFrame( false )
 {
 
 
@@ -85,6 +87,8 @@ TrackingThread::TrackingThread( SlamSystem &system )
 	for (int level = 4; level < PYRAMID_LEVELS; ++level)
 		_tracker->settings.maxItsPerLvl[level] = 0;
 
+	_tracker->settings.maxTimeMs = system.conf().trackingTimeBudgetMs;
+
 	// trackingReference = new TrackingReference();
 	//mappingTrackingReference = new TrackingReference();
 
@@ -134,6 +138,15 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 
 	if(!_trackingIsGood)
 	{
+		// Mapping lost tracking while a pipelined frame was held back. It was
+		// tracked against the keyframe from before the loss, so it must not
+		// reach mapping after the relocalized frame.
+		if( _deferredFrame ) {
+			LOG_IF(DEBUG, enablePrintDebugInfo && printThreadingInfo) << "Dropping deferred frame " << _deferredFrame->id() << " after tracking loss";
+			_deferredFrame.reset();
+			_deferredIsKeyFrame = false;
+		}
+
 		// Prod mapping to check the relocalizer
 		_system.mapThread->relocalizer.updateCurrentFrame(newFrame);
 		_system.mapThread->doIteration();
@@ -147,6 +160,25 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 		return;
 	}
 
+	LoadController &load( _system.mapThread->loadController );
+	if( !load.shouldTrack() )
+	{
+		LOG_IF(DEBUG, enablePrintDebugInfo && printThreadingInfo) << "Skipping frame " << newFrame->id() << " to let mapping catch up";
+		return;
+	}
+	_tracker->settings.minLevel = load.trackingMinLevel();
+
+	// Pipelined offline mode: frame N-1 is mapped while frame N is tracked.
+	// blockUntilMapped alone maps N-1, and makes its keyframe change, before
+	// N is tracked; here only N-2 is done by then. So that the result doesn't
+	// depend on timing, everything frame N reads from the keyframe is taken
+	// before N-1 is handed to mapping. If N-1 becomes a keyframe, N has been
+	// tracked on the previous one, and mapping drops it as it would any
+	// frame whose tracking parent isn't the current keyframe.
+	const bool pipelined = blockUntilMapped && _system.conf().offlinePipelined;
+	if( pipelined )
+		_system.mapThread->unmappedTrackedFrames.waitUntilEmpty();
+
 	// Are the following two calls atomic enough or should I lock
 	// before the next two lines?
 	bool newKeyFramePending = _system.mapThread->newKeyFramePending();	// pre-save here, to make decision afterwards.
@@ -160,6 +192,23 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 		_trackingReferenceFrameSharedPT = keyframe;
 	}
 
+	int numMappedOnKeyframe = keyframe->numMappedOnThisTotal;
+	int numKeyframes = _system.keyFrameGraph()->size();
+
+	if( pipelined )
+	{
+		// point clouds are otherwise built lazily, while mapping may be
+		// updating the keyframe's depth.
+		for(int lvl = SE3TRACKING_MIN_LEVEL; lvl < SE3TRACKING_MAX_LEVEL; lvl++)
+			_trackingReference->makePointCloud(lvl);
+
+		if( _deferredFrame ) {
+			newKeyFramePending = newKeyFramePending || _deferredIsKeyFrame;
+			handOffToMapping( _deferredFrame, _deferredIsKeyFrame );
+			_deferredFrame.reset();
+		}
+	}
+
 	FramePoseStruct &trackingReferencePose( *_trackingReference->keyframe->pose);
 
 	// DO TRACKING & Show tracking result.
@@ -168,8 +217,8 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 
 	SE3 frameToReference_initialEstimate;
 	{
-		boost::shared_lock_guard<boost::shared_mutex> lock( _system.poseConsistencyMutex );
-		frameToReference_initialEstimate = se3FromSim3( trackingReferencePose.getCamToWorld().inverse() * _system.keyFrameGraph()->allFramePoses.back()->getCamToWorld());
+		PoseSnapshot::ConstPtr poses = _system.keyFrameGraph()->poseSnapshot();
+		frameToReference_initialEstimate = se3FromSim3( poses->getCamToWorld(trackingReferencePose).inverse() * poses->getCamToWorld(*_system.keyFrameGraph()->allFramePoses.back()));
 	}
 
 
@@ -182,6 +231,9 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 
 	perf.update( timer );
 
+	LOG_IF(INFO, _tracker->lastDeadlineHit) << "Tracking frame " << newFrame->id() << " ran out of time, result is from level "
+						<< _tracker->lastLevel << " after " << _tracker->lastIterations << " iterations (" << timer.stop()*1000.0f << " ms)";
+
 	tracking_lastResidual = _tracker->lastResidual;
 	tracking_lastUsage = _tracker->pointUsage;
 	//tracking_lastGoodPerBad = _tracker->lastGoodCount / (_tracker->lastGoodCount + _tracker->lastBadCount);
@@ -189,7 +241,7 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 
 
 	if(manualTrackingLossIndicated || _tracker->diverged ||
-		(_system.keyFrameGraph()->keyframesAll.size() > INITIALIZATION_PHASE_COUNT && !_tracker->trackingWasGood))
+		(numKeyframes > INITIALIZATION_PHASE_COUNT && !_tracker->trackingWasGood))
 	{
 		LOGF(WARNING, "TRACKING LOST for frame %d (%1.2f%% good Points, which is %1.2f%% of available points; %s tracking; tracker has %s)!\n",
 				newFrame->id(),
@@ -245,23 +297,30 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 	// Keyframe selection
 	// latestTrackedFrame = trackingNewFrame;
 	//if (!my_createNewKeyframe && _map.currentKeyFrame()->numMappedOnThisTotal > MIN_NUM_MAPPED)
-	LOG(INFO) << "While tracking " << newFrame->id() << " the keyframe is " << _system.currentKeyFrame().const_ref()->id();
-	LOG_IF( INFO, printThreadingInfo ) << _system.currentKeyFrame().const_ref()->numMappedOnThisTotal << " frames mapped on to keyframe " << _system.currentKeyFrame().const_ref()->id() << ", considering " << newFrame->id() << " as new keyframe.";
+	LOG(INFO) << "While tracking " << newFrame->id() << " the keyframe is " << keyframe->id();
+
+	// in pipelined mode, only what was read before the hand-off, so the
+	// decision does not depend on how far mapping got meanwhile.
+	if( !pipelined ) {
+		numMappedOnKeyframe = keyframe->numMappedOnThisTotal;
+		numKeyframes = _system.keyFrameGraph()->size();
+	}
+
+	LOG_IF( INFO, printThreadingInfo ) << numMappedOnKeyframe << " frames mapped on to keyframe " << keyframe->id() << ", considering " << newFrame->id() << " as new keyframe.";
 
-	if(!newKeyFramePending && _system.currentKeyFrame().const_ref()->numMappedOnThisTotal > MIN_NUM_MAPPED)
+	bool isKeyFrame = false;
+	if(!newKeyFramePending && numMappedOnKeyframe > MIN_NUM_MAPPED)
 	{
-		Sophus::Vector3d dist = newRefToFrame_poseUpdate.translation() * _system.currentKeyFrame().const_ref()->meanIdepth;
-		float minVal = fmin(0.2f + _system.keyFrameGraph()->size() * 0.8f / INITIALIZATION_PHASE_COUNT,1.0f);
+		Sophus::Vector3d dist = newRefToFrame_poseUpdate.translation() * keyframe->meanIdepth;
+		float minVal = fmin(0.2f + numKeyframes * 0.8f / INITIALIZATION_PHASE_COUNT,1.0f);
 
-		if(_system.keyFrameGraph()->size() < INITIALIZATION_PHASE_COUNT)	minVal *= 0.7;
+		if(numKeyframes < INITIALIZATION_PHASE_COUNT)	minVal *= 0.7;
 
 		lastTrackingClosenessScore = _system.trackableKeyFrameSearch()->getRefFrameScore(dist.dot(dist), _tracker->pointUsage);
 
 		if (lastTrackingClosenessScore > minVal)
 		{
-			LOG(INFO) << "Telling mapping thread to make " << newFrame->id() << " the new keyframe.";
-			_system.mapThread->createNewKeyFrame( newFrame );
-			// createNewKeyFrame = true;
+			isKeyFrame = true;
 
 			LOGF_IF( INFO, printKeyframeSelectionInfo,
 							"SELECT KEYFRAME %d on %d! dist %.3f + usage %.3f = %.3f > 1\n",newFrame->id(),newFrame->trackingParent()->id(), dist.dot(dist), _tracker->pointUsage, _system.trackableKeyFrameSearch()->getRefFrameScore(dist.dot(dist), _tracker->pointUsage));
@@ -274,17 +333,15 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 		}
 	}
 
-	LOG_IF( DEBUG, printThreadingInfo ) << "Push unmapped tracked frame.";
-	_system.mapThread->pushUnmappedTrackedFrame( newFrame );
-
-	// unmappedTrackedFrames.notifyAll();
-		// unmappedTrackedFramesSignal.notify_one();
-	// }
+	if( pipelined ) {
+		_deferredFrame = newFrame;
+		_deferredIsKeyFrame = isKeyFrame;
+	} else {
+		handOffToMapping( newFrame, isKeyFrame );
 
-	// If blocking is requested...
-	if(blockUntilMapped && trackingIsGood() ){
-		while( _system.mapThread->unmappedTrackedFrames.size() > 0 ) {
-			_system.mapThread->trackedFramesMapped.wait( );
+		// If blocking is requested...
+		if(blockUntilMapped && trackingIsGood() ){
+			_system.mapThread->unmappedTrackedFrames.waitUntilEmpty();
 		}
 	}
 
@@ -294,6 +351,29 @@ void TrackingThread::trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntil
 
 
 
+void TrackingThread::handOffToMapping( const Frame::SharedPtr &frame, bool isKeyFrame )
+{
+	if( isKeyFrame ) {
+		LOG(INFO) << "Telling mapping thread to make " << frame->id() << " the new keyframe.";
+		_system.mapThread->createNewKeyFrame( frame );
+	}
+
+	LOG_IF( DEBUG, printThreadingInfo ) << "Push unmapped tracked frame.";
+	_system.mapThread->pushUnmappedTrackedFrame( frame );
+}
+
+void TrackingThread::flushPipeline()
+{
+	if( !_deferredFrame ) return;
+
+	handOffToMapping( _deferredFrame, _deferredIsKeyFrame );
+	_deferredFrame.reset();
+
+	if( trackingIsGood() )
+		_system.mapThread->unmappedTrackedFrames.waitUntilEmpty();
+}
+
+
 // n.b. this function will be called from the mapping thread.  Ensure
 // locking is in place.
 void TrackingThread::takeRelocalizeResult( const RelocalizerResult &result  )
@@ -326,7 +406,8 @@ void TrackingThread::takeRelocalizeResult( const RelocalizerResult &result  )
 	{
 		_system.keyFrameGraph()->addFrame(result.successfulFrame );
 
-		_system.mapThread->pushUnmappedTrackedFrame( result.successfulFrame );
+		// runs on the mapping thread, which must not wait on its own queue.
+		_system.mapThread->pushUnmappedTrackedFrame( result.successfulFrame, false );
 
 		// {
 		// 	std::lock_guard<std::mutex> lock( currentKeyFrameMutex );
@@ -78,6 +78,11 @@ public:
 	void trackFrame(std::shared_ptr<Frame> newFrame, bool blockUntilMapped );
 	void trackFrame(uchar* image, unsigned int frameID, bool blockUntilMapped, double timestamp );
 
+	/** In pipelined offline mode (Configuration::offlinePipelined), hands the
+	 *  last tracked frame, which is otherwise held back until the next one
+	 *  arrives, to mapping and waits until it is mapped. */
+	void flushPipeline();
+
 
 	/** Sets the visualization where point clouds and camera poses will be sent to. */
 
@@ -113,6 +118,14 @@ private:
 
 	bool _trackingIsGood;
 
+	// pipelined offline mode: the last tracked frame, and whether it was
+	// selected as keyframe. Handed to mapping once the next frame has taken
+	// everything it needs from the current keyframe.
+	Frame::SharedPtr _deferredFrame;
+	bool _deferredIsKeyFrame;
+
+	void handOffToMapping( const Frame::SharedPtr &frame, bool isKeyFrame );
+
 
 	//
 	//
@@ -2,7 +2,7 @@
 * This file is part of LSD-SLAM.
 *
 * Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
-* For more information see <http://vision.in.tum.de/lsdslam> 
+* For more information see <http://vision.in.tum.de/lsdslam>
 *
 * LSD-SLAM is free software: you can redistribute it and/or modify
 * it under the terms of the GNU General Public License as published by
@@ -24,6 +24,9 @@
 #include <opencv2/core/core.hpp>
 #include "util/settings.h"
 
+#if defined(ENABLE_SSE) || defined(__AVX__)
+	#include <immintrin.h>
+#endif
 
 
 namespace lsd_slam
@@ -41,407 +44,332 @@ typedef Eigen::Matrix<float, 4, 4> Matrix4x4;
 
 
 
-
-class LGS4
+/**
+ * Accumulator backends for LGS<N>.
+ *
+ * Each backend keeps one register-wide partial sum per entry of the normal
+ * equations and reduces it in finishNoDivide(). Batches narrower than the
+ * backend are widened with zeros, so the SSE kernels can feed any backend.
+ * Single rows are summed in plain floats beside it.
+ */
+struct LGSBackendScalar
 {
-public:
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
-
-  Matrix4x4 A;
-  Vector4 b;
-
-  float error;
-  size_t num_constraints;
-
-  inline void initialize(const size_t maxnum_constraints)
-  {
-    A.setZero();
-    b.setZero();
-    memset(SSEData,0, sizeof(float)*4*15);
-    error = 0;
-    this->num_constraints = 0;
-  }
+	static const int width = 1;
+	typedef float Packet;
+
+	static inline Packet zero() { return 0; }
+	static inline Packet set1(float v) { return v; }
+	static inline Packet add(Packet a, Packet b) { return a + b; }
+	static inline Packet mul(Packet a, Packet b) { return a * b; }
+	static inline Packet madd(Packet a, Packet b, Packet c) { return a * b + c; }
+	static inline float sum(Packet a) { return a; }
+};
 
-  inline void finishNoDivide()
-  {
 #if defined(ENABLE_SSE)
-  	__m128 a;
-
-  	a = _mm_load_ps(SSEData+4*0);
-  	A(0,0) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*1);
-  	A(1,0) = (A(0,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*2);
-  	A(2,0) = (A(0,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*3);
-  	A(3,0) = (A(0,3) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-
-  	a = _mm_load_ps(SSEData+4*4);
-  	A(1,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*5);
-  	A(1,2) = (A(2,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*6);
-  	A(1,3) = (A(3,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-
-
-  	a = _mm_load_ps(SSEData+4*7);
-  	A(2,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*8);
-  	A(2,3) = (A(3,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-  	a = _mm_load_ps(SSEData+4*9);
-  	A(3,3) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-
-
-
-  	a = _mm_load_ps(SSEData+4*10);
-  	b[0] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*11);
-  	b[1] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*12);
-  	b[2] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*13);
-  	b[3] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*14);
-  	error += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
+struct LGSBackendSSE
+{
+	static const int width = 4;
+	typedef __m128 Packet;
+
+	static inline Packet zero() { return _mm_setzero_ps(); }
+	static inline Packet set1(float v) { return _mm_set1_ps(v); }
+	static inline Packet add(Packet a, Packet b) { return _mm_add_ps(a, b); }
+	static inline Packet mul(Packet a, Packet b) { return _mm_mul_ps(a, b); }
+	static inline Packet madd(Packet a, Packet b, Packet c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+	static inline Packet fromSSE(__m128 a) { return a; }
+	static inline float sum(Packet a) { return SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3); }
+};
 #endif
-  }
 
-#if defined(ENABLE_SSE)
-  inline void updateSSE(
-  		const __m128 &J1,const __m128 &J2,const __m128 &J3,const __m128 &J4,
-  		const __m128& res, const __m128& weight)
-  {
-	  //A.noalias() += J * J.transpose() * weight;
-	  __m128 J1w = _mm_mul_ps(J1,weight);
-	  _mm_store_ps(SSEData+4*0, _mm_add_ps(_mm_load_ps(SSEData+4*0),_mm_mul_ps(J1w,J1)));
-	  _mm_store_ps(SSEData+4*1, _mm_add_ps(_mm_load_ps(SSEData+4*1),_mm_mul_ps(J1w,J2)));
-	  _mm_store_ps(SSEData+4*2, _mm_add_ps(_mm_load_ps(SSEData+4*2),_mm_mul_ps(J1w,J3)));
-	  _mm_store_ps(SSEData+4*3, _mm_add_ps(_mm_load_ps(SSEData+4*3),_mm_mul_ps(J1w,J4)));
-
-	  __m128 J2w = _mm_mul_ps(J2,weight);
-	  _mm_store_ps(SSEData+4*4, _mm_add_ps(_mm_load_ps(SSEData+4*4),_mm_mul_ps(J2w,J2)));
-	  _mm_store_ps(SSEData+4*5, _mm_add_ps(_mm_load_ps(SSEData+4*5),_mm_mul_ps(J2w,J3)));
-	  _mm_store_ps(SSEData+4*6, _mm_add_ps(_mm_load_ps(SSEData+4*6),_mm_mul_ps(J2w,J4)));
-
-
-	  __m128 J3w = _mm_mul_ps(J3,weight);
-	  _mm_store_ps(SSEData+4*7, _mm_add_ps(_mm_load_ps(SSEData+4*7),_mm_mul_ps(J3w,J3)));
-	  _mm_store_ps(SSEData+4*8, _mm_add_ps(_mm_load_ps(SSEData+4*8),_mm_mul_ps(J3w,J4)));
-
-	  __m128 J4w = _mm_mul_ps(J4,weight);
-	  _mm_store_ps(SSEData+4*9, _mm_add_ps(_mm_load_ps(SSEData+4*9),_mm_mul_ps(J4w,J4)));
-
-	  //b.noalias() -= J * (res * weight);
-	  __m128 resw = _mm_mul_ps(res,weight);
-	  _mm_store_ps(SSEData+4*10, _mm_add_ps(_mm_load_ps(SSEData+4*10),_mm_mul_ps(resw,J1)));
-	  _mm_store_ps(SSEData+4*11, _mm_add_ps(_mm_load_ps(SSEData+4*11),_mm_mul_ps(resw,J2)));
-	  _mm_store_ps(SSEData+4*12, _mm_add_ps(_mm_load_ps(SSEData+4*12),_mm_mul_ps(resw,J3)));
-	  _mm_store_ps(SSEData+4*13, _mm_add_ps(_mm_load_ps(SSEData+4*13),_mm_mul_ps(resw,J4)));
-
-	  //error += res * res * weight;
-	  _mm_store_ps(SSEData+4*14, _mm_add_ps(_mm_load_ps(SSEData+4*14),_mm_mul_ps(resw,res)));
-
-	  num_constraints += 4;
-  }
+#if defined(__AVX__)
+struct LGSBackendAVX
+{
+	static const int width = 8;
+	typedef __m256 Packet;
+
+	static inline Packet zero() { return _mm256_setzero_ps(); }
+	static inline Packet set1(float v) { return _mm256_set1_ps(v); }
+	static inline Packet add(Packet a, Packet b) { return _mm256_add_ps(a, b); }
+	static inline Packet mul(Packet a, Packet b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+	static inline Packet madd(Packet a, Packet b, Packet c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+	static inline Packet madd(Packet a, Packet b, Packet c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+	static inline Packet fromSSE(__m128 a) { return _mm256_insertf128_ps(_mm256_setzero_ps(), a, 0); }
+	static inline float sum(Packet a)
+	{
+		__m128 s = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+		return SSEE(s,0) + SSEE(s,1) + SSEE(s,2) + SSEE(s,3);
+	}
+};
 #endif
 
-  inline void update(const Vector4& J, const float& res, const float& weight)
-  {
-    A.noalias() += J * J.transpose() * weight;
-    b.noalias() -= J * (res * weight);
-    error += res * res * weight;
-    num_constraints += 1;
-  }
-
-private:
-  EIGEN_ALIGN16 float SSEData[4*15];
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+struct LGSBackendAVX512
+{
+	static const int width = 16;
+	typedef __m512 Packet;
+
+	static inline Packet zero() { return _mm512_setzero_ps(); }
+	static inline Packet set1(float v) { return _mm512_set1_ps(v); }
+	static inline Packet add(Packet a, Packet b) { return _mm512_add_ps(a, b); }
+	static inline Packet mul(Packet a, Packet b) { return _mm512_mul_ps(a, b); }
+	static inline Packet madd(Packet a, Packet b, Packet c) { return _mm512_fmadd_ps(a, b, c); }
+	static inline Packet fromSSE(__m128 a) { return _mm512_insertf32x4(_mm512_setzero_ps(), a, 0); }
+	static inline Packet fromAVX(__m256 a) { return _mm512_insertf32x8(_mm512_setzero_ps(), a, 0); }
+	static inline float sum(Packet a) { return _mm512_reduce_add_ps(a); }
 };
+#endif
+
+// widest backend the build targets.
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+	typedef LGSBackendAVX512 LGSBackendDefault;
+#elif defined(__AVX__)
+	typedef LGSBackendAVX LGSBackendDefault;
+#elif defined(ENABLE_SSE)
+	typedef LGSBackendSSE LGSBackendDefault;
+#else
+	typedef LGSBackendScalar LGSBackendDefault;
+#endif
 
 
 
 /**
- * Builds 4dof LGS (used for depth-lgs, at it has only 7 non-zero entries in jacobian)
- * only used to accumulate data, NOT really as LGS
+ * Accumulates the normal equations A = sum J*J^T*w, b = -sum J*r*w and
+ * error = sum r*r*w of an N-dof least squares problem.
+ *
+ * Only the upper triangle of A is accumulated; finishNoDivide() mirrors it.
+ * Single rows go through update(), batches of 4 (SSE) or 8 (AVX) rows,
+ * given as one register per Jacobian component, through update4() /
+ * update8(). All of them may be mixed within one system.
  */
-class LGS6
+template<int N, class Backend = LGSBackendDefault>
+class LGS
 {
 public:
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
-
-  Matrix6x6 A;
-  Vector6 b;
-
-  float error;
-  size_t num_constraints;
-
-  inline void initialize(const size_t maxnum_constraints)
-  {
-    A.setZero();
-    b.setZero();
-    memset(SSEData,0, sizeof(float)*4*28);
-
-    error = 0;
-    this->num_constraints = 0;
-  }
-
-  inline void finishNoDivide()
-  {
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+	typedef Eigen::Matrix<float, N, 1> VectorN;
+	typedef Eigen::Matrix<float, N, N> MatrixN;
+	typedef typename Backend::Packet Packet;
+
+	MatrixN A;
+	VectorN b;
+
+	float error;
+	size_t num_constraints;
+
+	inline void initialize(const size_t maxnum_constraints)
+	{
+		A.setZero();
+		b.setZero();
+		error = 0;
+		num_constraints = 0;
+		clearAccumulators();
+	}
+
+	// adds the accumulated sums to A, b and error.
+	inline void finishNoDivide()
+	{
+		int k = 0;
+		for(int i=0;i<N;i++)
+			for(int j=i;j<N;j++, k++)
+			{
+				A(i,j) += Backend::sum(acc[k]) + accScalar[k];
+				A(j,i) = A(i,j);
+			}
+
+		for(int i=0;i<N;i++, k++)
+			b[i] -= Backend::sum(acc[k]) + accScalar[k];
+
+		error += Backend::sum(acc[k]) + accScalar[k];
+
+		clearAccumulators();
+	}
+
+	inline void finish()
+	{
+		finishNoDivide();
+		A /= (float) num_constraints;
+		b /= (float) num_constraints;
+		error /= (float) num_constraints;
+	}
+
+	inline void update(const VectorN& J, const float& res, const float& weight)
+	{
+		int k = 0;
+		for(int i=0;i<N;i++)
+		{
+			const float Jw = J[i] * weight;
+			for(int j=i;j<N;j++, k++)
+				accScalar[k] += Jw * J[j];
+		}
+
+		const float resw = res * weight;
+		for(int i=0;i<N;i++, k++)
+			accScalar[k] += resw * J[i];
+
+		accScalar[k] += resw * res;
+		num_constraints += 1;
+	}
+
+	// adds Backend::width rows at once. J[i] holds component i of every row.
+	inline void updateBatch(const Packet* J, const Packet& res, const Packet& weight)
+	{
+		accumulate(J, res, weight);
+		num_constraints += Backend::width;
+	}
 
 #if defined(ENABLE_SSE)
-  	__m128 a;
-
-  	a = _mm_load_ps(SSEData+4*0);
-  	A(0,0) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*1);
-  	A(1,0) = (A(0,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*2);
-  	A(2,0) = (A(0,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*3);
-  	A(3,0) = (A(0,3) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*4);
-  	A(4,0) = (A(0,4) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*5);
-  	A(5,0) = (A(0,5) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-
-
-
-
-  	a = _mm_load_ps(SSEData+4*6);
-  	A(1,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*7);
-  	A(1,2) = (A(2,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*8);
-  	A(1,3) = (A(3,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*9);
-  	A(1,4) = (A(4,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*10);
-  	A(1,5) = (A(5,1) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-
-
-  	a = _mm_load_ps(SSEData+4*11);
-  	A(2,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*12);
-  	A(2,3) = (A(3,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*13);
-  	A(2,4) = (A(4,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*14);
-  	A(2,5) = (A(5,2) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-
-  	a = _mm_load_ps(SSEData+4*15);
-  	A(3,3) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*16);
-  	A(3,4) = (A(4,3) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-  	a = _mm_load_ps(SSEData+4*17);
-  	A(3,5) = (A(5,3) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-
-  	a = _mm_load_ps(SSEData+4*18);
-  	A(4,4) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*19);
-  	A(4,5) = (A(5,4) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3));
-
-
-
-  	a = _mm_load_ps(SSEData+4*20);
-  	A(5,5) += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-
-
-
-
-  	a = _mm_load_ps(SSEData+4*21);
-  	b[0] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
-
-  	a = _mm_load_ps(SSEData+4*22);
-  	b[1] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
+	// adds 4 rows. Lanes with zero weight contribute nothing.
+	inline void update4(const __m128* J, const __m128& res, const __m128& weight)
+	{
+		update4Impl(J, res, weight, Backend());
+	}
+#endif
 
-  	a = _mm_load_ps(SSEData+4*23);
-  	b[2] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
+#if defined(__AVX__)
+	// adds 8 rows. Lanes with zero weight contribute nothing.
+	inline void update8(const __m256* J, const __m256& res, const __m256& weight)
+	{
+		update8Impl(J, res, weight, Backend());
+	}
+#endif
 
-  	a = _mm_load_ps(SSEData+4*24);
-  	b[3] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
+	// only for N = 7: combines the photometric 6-dof system with the depth
+	// system over (t_z, rotation x/y, scale).
+	template<class LS6, class LS4>
+	void initializeFrom(const LS6& ls6, const LS4& ls4)
+	{
+		static_assert(N == 7, "initializeFrom is only defined for the 7-dof (Sim3) system");
 
-  	a = _mm_load_ps(SSEData+4*25);
-  	b[4] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
+		initialize(0);
 
-  	a = _mm_load_ps(SSEData+4*26);
-  	b[5] -= SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
+		// add ls6
+		A.template topLeftCorner<6,6>() = ls6.A;
+		b.template head<6>() = ls6.b;
 
+		// add ls4
+		int remap[4] = {2,3,4,6};
+		for(int i=0;i<4;i++)
+		{
+			b[remap[i]] += ls4.b[i];
+			for(int j=0;j<4;j++)
+				A(remap[i], remap[j]) += ls4.A(i,j);
+		}
 
+		num_constraints = ls6.num_constraints + ls4.num_constraints;
+	}
 
-  	a = _mm_load_ps(SSEData+4*27);
-  	error += SSEE(a,0) + SSEE(a,1) + SSEE(a,2) + SSEE(a,3);
+private:
+	static const int numAccumulators = N*(N+1)/2 + N + 1;
+
+	// full batches go to acc, single rows to accScalar.
+	Packet acc[numAccumulators];
+	float accScalar[numAccumulators];
+
+	inline void clearAccumulators()
+	{
+		for(int k=0;k<numAccumulators;k++)
+		{
+			acc[k] = Backend::zero();
+			accScalar[k] = 0;
+		}
+	}
+
+	inline void accumulate(const Packet* J, const Packet& res, const Packet& weight)
+	{
+		int k = 0;
+		for(int i=0;i<N;i++)
+		{
+			const Packet Jw = Backend::mul(J[i], weight);
+			for(int j=i;j<N;j++, k++)
+				acc[k] = Backend::madd(Jw, J[j], acc[k]);
+		}
+
+		const Packet resw = Backend::mul(res, weight);
+		for(int i=0;i<N;i++, k++)
+			acc[k] = Backend::madd(resw, J[i], acc[k]);
+
+		acc[k] = Backend::madd(resw, res, acc[k]);
+	}
+
+	// fallback for backends narrower than the batch: one row at a time.
+	template<class V>
+	inline void updateLanes(const V* J, const V& res, const V& weight)
+	{
+		const int lanes = sizeof(V) / sizeof(float);
+		for(int l=0;l<lanes;l++)
+		{
+			VectorN Jl;
+			for(int i=0;i<N;i++)
+				Jl[i] = SSEE(J[i],l);
+			update(Jl, SSEE(res,l), SSEE(weight,l));
+		}
+	}
 
+#if defined(ENABLE_SSE)
+	template<class B>
+	inline void update4Impl(const __m128* J, const __m128& res, const __m128& weight, B)
+	{
+		Packet Jp[N];
+		for(int i=0;i<N;i++)
+			Jp[i] = B::fromSSE(J[i]);
+		accumulate(Jp, B::fromSSE(res), B::fromSSE(weight));
+		num_constraints += 4;
+	}
+
+	inline void update4Impl(const __m128* J, const __m128& res, const __m128& weight, LGSBackendScalar)
+	{
+		updateLanes(J, res, weight);
+	}
 #endif
-  }
-
 
-  void finish()
-  {
-    finishNoDivide();
-    A /= (float) num_constraints;
-    b /= (float) num_constraints;
-    error /= (float) num_constraints;
-  }
+#if defined(__AVX__)
+	template<class B>
+	inline void update8Impl(const __m256* J, const __m256& res, const __m256& weight, B)
+	{
+		updateLanes(J, res, weight);
+	}
 
 #if defined(ENABLE_SSE)
-  inline void updateSSE(
-  		const __m128 &J1,const __m128 &J2,const __m128 &J3,const __m128 &J4,const __m128 &J5,const __m128 &J6,
-  		const __m128& res, const __m128& weight)
-  {
-	  //A.noalias() += J * J.transpose() * weight;
-	  __m128 J1w = _mm_mul_ps(J1,weight);
-	  _mm_store_ps(SSEData+4*0, _mm_add_ps(_mm_load_ps(SSEData+4*0),_mm_mul_ps(J1w,J1)));
-	  _mm_store_ps(SSEData+4*1, _mm_add_ps(_mm_load_ps(SSEData+4*1),_mm_mul_ps(J1w,J2)));
-	  _mm_store_ps(SSEData+4*2, _mm_add_ps(_mm_load_ps(SSEData+4*2),_mm_mul_ps(J1w,J3)));
-	  _mm_store_ps(SSEData+4*3, _mm_add_ps(_mm_load_ps(SSEData+4*3),_mm_mul_ps(J1w,J4)));
-	  _mm_store_ps(SSEData+4*4, _mm_add_ps(_mm_load_ps(SSEData+4*4),_mm_mul_ps(J1w,J5)));
-	  _mm_store_ps(SSEData+4*5, _mm_add_ps(_mm_load_ps(SSEData+4*5),_mm_mul_ps(J1w,J6)));
-
-
-	  __m128 J2w = _mm_mul_ps(J2,weight);
-	  _mm_store_ps(SSEData+4*6, _mm_add_ps(_mm_load_ps(SSEData+4*6),_mm_mul_ps(J2w,J2)));
-	  _mm_store_ps(SSEData+4*7, _mm_add_ps(_mm_load_ps(SSEData+4*7),_mm_mul_ps(J2w,J3)));
-	  _mm_store_ps(SSEData+4*8, _mm_add_ps(_mm_load_ps(SSEData+4*8),_mm_mul_ps(J2w,J4)));
-	  _mm_store_ps(SSEData+4*9, _mm_add_ps(_mm_load_ps(SSEData+4*9),_mm_mul_ps(J2w,J5)));
-	  _mm_store_ps(SSEData+4*10, _mm_add_ps(_mm_load_ps(SSEData+4*10),_mm_mul_ps(J2w,J6)));
-
-
-	  __m128 J3w = _mm_mul_ps(J3,weight);
-	  _mm_store_ps(SSEData+4*11, _mm_add_ps(_mm_load_ps(SSEData+4*11),_mm_mul_ps(J3w,J3)));
-	  _mm_store_ps(SSEData+4*12, _mm_add_ps(_mm_load_ps(SSEData+4*12),_mm_mul_ps(J3w,J4)));
-	  _mm_store_ps(SSEData+4*13, _mm_add_ps(_mm_load_ps(SSEData+4*13),_mm_mul_ps(J3w,J5)));
-	  _mm_store_ps(SSEData+4*14, _mm_add_ps(_mm_load_ps(SSEData+4*14),_mm_mul_ps(J3w,J6)));
-
-	  __m128 J4w = _mm_mul_ps(J4,weight);
-	  _mm_store_ps(SSEData+4*15, _mm_add_ps(_mm_load_ps(SSEData+4*15),_mm_mul_ps(J4w,J4)));
-	  _mm_store_ps(SSEData+4*16, _mm_add_ps(_mm_load_ps(SSEData+4*16),_mm_mul_ps(J4w,J5)));
-	  _mm_store_ps(SSEData+4*17, _mm_add_ps(_mm_load_ps(SSEData+4*17),_mm_mul_ps(J4w,J6)));
-
-
-	  __m128 J5w = _mm_mul_ps(J5,weight);
-	  _mm_store_ps(SSEData+4*18, _mm_add_ps(_mm_load_ps(SSEData+4*18),_mm_mul_ps(J5w,J5)));
-	  _mm_store_ps(SSEData+4*19, _mm_add_ps(_mm_load_ps(SSEData+4*19),_mm_mul_ps(J5w,J6)));
-
-
-	  __m128 J6w = _mm_mul_ps(J6,weight);
-	  _mm_store_ps(SSEData+4*20, _mm_add_ps(_mm_load_ps(SSEData+4*20),_mm_mul_ps(J6w,J6)));
-
-
-
-
-	  //b.noalias() -= J * (res * weight);
-	  __m128 resw = _mm_mul_ps(res,weight);
-	  _mm_store_ps(SSEData+4*21, _mm_add_ps(_mm_load_ps(SSEData+4*21),_mm_mul_ps(resw,J1)));
-	  _mm_store_ps(SSEData+4*22, _mm_add_ps(_mm_load_ps(SSEData+4*22),_mm_mul_ps(resw,J2)));
-	  _mm_store_ps(SSEData+4*23, _mm_add_ps(_mm_load_ps(SSEData+4*23),_mm_mul_ps(resw,J3)));
-	  _mm_store_ps(SSEData+4*24, _mm_add_ps(_mm_load_ps(SSEData+4*24),_mm_mul_ps(resw,J4)));
-	  _mm_store_ps(SSEData+4*25, _mm_add_ps(_mm_load_ps(SSEData+4*25),_mm_mul_ps(resw,J5)));
-	  _mm_store_ps(SSEData+4*26, _mm_add_ps(_mm_load_ps(SSEData+4*26),_mm_mul_ps(resw,J6)));
-
-	  //error += res * res * weight;
-	  _mm_store_ps(SSEData+4*27, _mm_add_ps(_mm_load_ps(SSEData+4*27),_mm_mul_ps(resw,res)));
-
-	  num_constraints += 6;
-  }
+	inline void update8Impl(const __m256* J, const __m256& res, const __m256& weight, LGSBackendSSE)
+	{
+		__m128 Jlo[N], Jhi[N];
+		for(int i=0;i<N;i++)
+		{
+			Jlo[i] = _mm256_castps256_ps128(J[i]);
+			Jhi[i] = _mm256_extractf128_ps(J[i], 1);
+		}
+		update4(Jlo, _mm256_castps256_ps128(res), _mm256_castps256_ps128(weight));
+		update4(Jhi, _mm256_extractf128_ps(res, 1), _mm256_extractf128_ps(weight, 1));
+	}
 #endif
 
-
-  inline void update(const Vector6& J, const float& res, const float& weight)
-  {
-    A.noalias() += J * J.transpose() * weight;
-    b.noalias() -= J * (res * weight);
-    error += res * res * weight;
-    num_constraints += 1;
-  }
-
-
-
-private:
-  EIGEN_ALIGN16 float SSEData[4*28];
+	inline void update8Impl(const __m256* J, const __m256& res, const __m256& weight, LGSBackendAVX)
+	{
+		accumulate(J, res, weight);
+		num_constraints += 8;
+	}
+
+#if defined(__AVX512F__) && defined(__AVX512DQ__)
+	inline void update8Impl(const __m256* J, const __m256& res, const __m256& weight, LGSBackendAVX512)
+	{
+		Packet Jp[N];
+		for(int i=0;i<N;i++)
+			Jp[i] = LGSBackendAVX512::fromAVX(J[i]);
+		accumulate(Jp, LGSBackendAVX512::fromAVX(res), LGSBackendAVX512::fromAVX(weight));
+		num_constraints += 8;
+	}
+#endif
+#endif
 };
 
 
-
-
-
-
-
-
-class LGS7
-{
-public:
-  EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
-
-  Matrix7x7 A;
-  Vector7 b;
-
-  float error;
-  size_t num_constraints;
-
-  void initializeFrom(const LGS6& ls6, const LGS4& ls4)
-  {
-  	// set zero
-  	A.setZero();
-  	b.setZero();
-
-  	// add ls6
-  	A.topLeftCorner<6,6>() = ls6.A;
-  	b.head<6>() = ls6.b;
-
-  	// add ls4
-  	int remap[4] = {2,3,4,6};
-  	for(int i=0;i<4;i++)
-  	{
-  		b[remap[i]] += ls4.b[i];
-  		for(int j=0;j<4;j++)
-  			A(remap[i], remap[j]) += ls4.A(i,j);
-  	}
-
-  	num_constraints = ls6.num_constraints + ls4.num_constraints;
-  }
-};
-
+typedef LGS<4> LGS4;
+typedef LGS<6> LGS6;
+typedef LGS<7> LGS7;
 
 
 }
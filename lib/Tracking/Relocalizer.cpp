@@ -23,6 +23,8 @@
 #include "Tracking/SE3Tracker.h"
 #include "IOWrapper/ImageDisplay.h"
 
+#include <algorithm>
+
 namespace lsd_slam
 {
 
@@ -30,43 +32,56 @@ namespace lsd_slam
 Relocalizer::Relocalizer( const Configuration &conf )
 	: isRunning( false ),
 		_conf( conf ),
+	  numWorkers( 0 ),
+	  quit( false ),
+	  session( 0 ),
 	  KFForReloc(),
+	  thumbnails( nullptr ),
+	  nextScoreIDX( 0 ),
+	  numScored( 0 ),
 	  nextRelocIDX( 0 ),
-	  maxRelocIDX( 0 ),
 	  continueRunning( false ),
+	  numRounds( 0 ),
+	  numAlignments( 0 ),
 		hasResult( false ),
 		resultKF( nullptr ),
 		resultFrameID( 0 ),
 		resultFrameToKeyframe( SE3() )
 {
-	for(int i=0;i<RELOCALIZE_THREADS;i++)
-		running[i] = false;
-
 }
 
 
 Relocalizer::~Relocalizer()
 {
 	stop();
+
+	exMutex.lock();
+	quit = true;
+	newCurrentFrameSignal.notify_all();
+	exMutex.unlock();
+
+	for(int i=0;i<numWorkers;i++)
+		relocThreads[i].join();
 }
 
 
 void Relocalizer::stop()
 {
+	boost::unique_lock<boost::mutex> lock(exMutex);
+
+	// workers go idle; whatever they are still aligning is dropped.
 	continueRunning = false;
-	exMutex.lock();
-	newCurrentFrameSignal.notify_all();
-	exMutex.unlock();
-	for(int i=0;i<RELOCALIZE_THREADS;i++)
-	{
-		relocThreads[i].join();
-		running[i] = false;
-	}
+	session++;
 	isRunning = false;
 
-
 	KFForReloc.clear();
+	roundKFs.clear();
+	KFScores.clear();
+	rankedKFs.clear();
 	CurrentRelocFrame.reset();
+	RoundRelocFrame.reset();
+
+	newCurrentFrameSignal.notify_all();
 }
 
 
@@ -76,16 +91,11 @@ void Relocalizer::updateCurrentFrame(std::shared_ptr<Frame> currentFrame)
 
 	if(hasResult) return;
 
+	// picked up by the next round.
 	this->CurrentRelocFrame = currentFrame;
-//	int doneLast = KFForReloc.size() - (maxRelocIDX-nextRelocIDX);
-	maxRelocIDX = nextRelocIDX + KFForReloc.size();
 	newCurrentFrameSignal.notify_all();
 	lock.unlock();
 
-//	printf("tried last on %d. set new current frame %d. trying %d to %d!\n",
-//			doneLast,
-//			currentFrame->id(), nextRelocIDX, maxRelocIDX);
-
 	// Opening the window from deep within the stack was causing issues on OSX.
 	// It was a good diagnostic but probably not the best UI choice anyway...
 	// if (displayDepthMap)
@@ -95,34 +105,87 @@ void Relocalizer::updateCurrentFrame(std::shared_ptr<Frame> currentFrame)
 	// handleKey(pressedKey);
 }
 
-void Relocalizer::start(std::vector<Frame::SharedPtr> &allKeyframesList)
+void Relocalizer::start(std::vector<Frame::SharedPtr> &allKeyframesList, const ThumbnailIndex* thumbnailIndex)
 {
-	// make KFForReloc List
+	boost::unique_lock<boost::mutex> lock(exMutex);
+
+	thumbnails = thumbnailIndex;
+
+	// make KFForReloc List. Keyframes with few neighbours can't be verified.
 	KFForReloc.clear();
 	for(unsigned int k=0;k < allKeyframesList.size(); k++)
-	{
-		// insert
-		KFForReloc.push_back(allKeyframesList[k]);
-
-		// swap with a random element
-		int ridx = rand()%(KFForReloc.size());
-		Frame::SharedPtr tmp( KFForReloc.back() );
-		KFForReloc.back() = KFForReloc[ridx];
-		KFForReloc[ridx] = tmp;
-	}
-	nextRelocIDX=0;
-	maxRelocIDX=KFForReloc.size();
+		if(allKeyframesList[k]->neighbors.size() > 2)
+			KFForReloc.push_back(allKeyframesList[k]);
+
+	// no round in progress.
+	RoundRelocFrame.reset();
+	roundKFs.clear();
+	KFScores.clear();
+	nextScoreIDX = numScored = 0;
+	rankedKFs.clear();
+	nextRelocIDX = 0;
 
+	numRounds = numAlignments = 0;
+	relocTimer.start();
+
+	session++;
 	hasResult = false;
 	continueRunning = true;
 	isRunning = true;
 
-	// start threads
-	for(int i=0;i<RELOCALIZE_THREADS;i++)
+	// the workers (and their trackers) are created once and then kept.
+	int wantWorkers = multiThreading ? RELOCALIZE_THREADS : 1;
+	for(; numWorkers < wantWorkers; numWorkers++)
+		relocThreads[numWorkers] = boost::thread(&Relocalizer::threadLoop, this, numWorkers);
+
+	newCurrentFrameSignal.notify_all();
+}
+
+void Relocalizer::startRound()
+{
+	RoundRelocFrame = CurrentRelocFrame;
+
+	// with a complete thumbnail index, only the keyframes that look most
+	// alike are scored; else all of them.
+	roundKFs.clear();
+	if(thumbnails != nullptr && useThumbnailIndex && thumbnails->size() >= (int)KFForReloc.size())
 	{
-		relocThreads[i] = boost::thread(&Relocalizer::threadLoop, this, i);
-		running[i] = true;
+		ThumbnailIndex::Descriptor descriptor;
+		ThumbnailIndex::computeDescriptor(RoundRelocFrame.get(), descriptor);
+
+		std::vector<ThumbnailIndex::Match> matches = thumbnails->query(descriptor, relocalizationThumbnailCandidates, -1);
+		for(unsigned int i=0;i<matches.size();i++)
+			if(matches[i].keyframe->neighbors.size() > 2)
+				roundKFs.push_back(matches[i].keyframe);
 	}
+	else
+		roundKFs = KFForReloc;
+
+	KFScores.assign(roundKFs.size(), 0);
+	nextScoreIDX = numScored = 0;
+	rankedKFs.clear();
+	nextRelocIDX = 0;
+	numRounds++;
+}
+
+void Relocalizer::rankCandidates()
+{
+	// every keyframe is aligned, best score first. The score is taken at
+	// the identity pose, so keyframes scoring 0 there may still match after
+	// a large motion; they come last, in their original order.
+	rankedKFs.resize(KFScores.size());
+	for(unsigned int k=0;k<KFScores.size();k++)
+		rankedKFs[k] = k;
+
+	std::stable_sort(rankedKFs.begin(), rankedKFs.end(),
+			[this](int a, int b) { return KFScores[a] > KFScores[b]; });
+	nextRelocIDX = 0;
+
+	if(enablePrintDebugInfo && printRelocalizationInfo && !rankedKFs.empty())
+		printf("RELOCALIZE round %d on frame %d: %d of %d keyframes overlap, best %d (%2.1f%%)\n",
+				numRounds, RoundRelocFrame->id(),
+				(int)std::count_if(KFScores.begin(), KFScores.end(), [](float s) { return s > 0; }), (int)roundKFs.size(),
+				roundKFs[rankedKFs[0]]->id(), 100*KFScores[rankedKFs[0]]);
 }
 
 bool Relocalizer::waitResult(int milliseconds)
@@ -158,21 +221,65 @@ RelocalizerResult Relocalizer::getResult( void ) //Frame* &out_keyframe, std::sh
 
 void Relocalizer::threadLoop(int idx)
 {
-	if(!multiThreading && idx != 0) return;
-
 	SE3Tracker* tracker = new SE3Tracker(_conf.slamImage );
 
+	Frame::SharedPtr batch[RELOCALIZE_SCORE_BATCH];
+	std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> > scoring;
+	scoring.reserve(RELOCALIZE_SCORE_BATCH);
+
 	boost::unique_lock<boost::mutex> lock(exMutex);
-	while(continueRunning)
+	while(!quit)
 	{
-		// if got something: do it (unlock in the meantime)
-		if(nextRelocIDX < maxRelocIDX && CurrentRelocFrame)
+		if(!continueRunning)
+		{
+			newCurrentFrameSignal.wait(lock);
+		}
+		// stage 1: score a batch of keyframes (unlock in the meantime)
+		else if(nextScoreIDX < (int)roundKFs.size())
 		{
-			Frame::SharedPtr todo( KFForReloc[nextRelocIDX%KFForReloc.size()] );
+			int begin = nextScoreIDX;
+			int end = std::min<int>(begin + RELOCALIZE_SCORE_BATCH, roundKFs.size());
+			nextScoreIDX = end;
+
+			for(int k=begin;k<end;k++)
+				batch[k-begin] = roundKFs[k];
+			std::shared_ptr<Frame> myRelocFrame = RoundRelocFrame;
+			int mySession = session;
+
+			lock.unlock();
+
+			// workers already run in parallel, so the batch itself does not.
+			scoring.clear();
+			for(int k=0;k<end-begin;k++)
+				scoring.push_back(PermaRefCandidate(batch[k].get(), SE3()));
+			tracker->scorePermaRefBatch(myRelocFrame.get(), scoring, false);
+
+			lock.lock();
+
+			for(int k=0;k<end-begin;k++)
+				batch[k].reset();
+
+			// stopped or restarted in the meantime.
+			if(mySession != session) continue;
+
+			for(int k=begin;k<end;k++)
+				KFScores[k] = scoring[k-begin].score;
+			numScored += end - begin;
+			if(numScored == (int)roundKFs.size())
+			{
+				rankCandidates();
+				newCurrentFrameSignal.notify_all();
+			}
+		}
+		// stage 2: fully align the next-best candidate
+		else if(nextRelocIDX < (int)rankedKFs.size())
+		{
+			Frame::SharedPtr todo( roundKFs[rankedKFs[nextRelocIDX]] );
 			nextRelocIDX++;
-			if(todo->neighbors.size() <= 2) continue;
+			numAlignments++;
 
-			std::shared_ptr<Frame> myRelocFrame = CurrentRelocFrame;
+			std::shared_ptr<Frame> myRelocFrame = RoundRelocFrame;
+			int mySession = session;
 
 			lock.unlock();
 
@@ -192,6 +299,8 @@ void Relocalizer::threadLoop(int idx)
 				SE3 bestKFToFrame = todoToFrame;
 				for(auto nkf : todo->neighbors)
 				{
+					if(mySession != session) break;
+
 					SE3 nkfToFrame_init = se3FromSim3((nkf->getCamToWorld().inverse() * todo->getCamToWorld() * sim3FromSE3(todoToFrame.inverse(), 1))).inverse();
 					SE3 nkfToFrame = tracker->trackFrameOnPermaref(nkf.get(), myRelocFrame.get(), nkfToFrame_init);
 
@@ -219,14 +328,20 @@ void Relocalizer::threadLoop(int idx)
 								numGoodNeighbours, numGoodNeighbours+numBadNeighbours);
 
 					// set everything to stop!
-					continueRunning = false;
 					lock.lock();
-					resultRelocFrame = myRelocFrame;
-					resultFrameID = myRelocFrame->id();
-					resultKF = bestKF;
-					resultFrameToKeyframe = bestKFToFrame.inverse();
-					resultReadySignal.notify_all();
-					hasResult = true;
+					if(mySession == session && !hasResult)
+					{
+						continueRunning = false;
+						perf.update(relocTimer);
+						LOG(INFO) << "Relocalized after " << relocTimer.stop()*1000.0f << " ms ("
+								<< numRounds << " rounds, " << numAlignments << " full alignments)";
+						resultRelocFrame = myRelocFrame;
+						resultFrameID = myRelocFrame->id();
+						resultKF = bestKF;
+						resultFrameToKeyframe = bestKFToFrame.inverse();
+						resultReadySignal.notify_all();
+						hasResult = true;
+					}
 					lock.unlock();
 				}
 				else
@@ -241,6 +356,12 @@ void Relocalizer::threadLoop(int idx)
 
 			lock.lock();
 		}
+		// round done: start the next one as soon as there is a newer frame.
+		else if(numScored == (int)roundKFs.size() && CurrentRelocFrame && CurrentRelocFrame != RoundRelocFrame)
+		{
+			startRound();
+			newCurrentFrameSignal.notify_all();
+		}
 		else
 		{
 			newCurrentFrameSignal.wait(lock);
@@ -23,10 +23,13 @@
 #include "boost/thread.hpp"
 #include <stdio.h>
 #include <iostream>
+#include <atomic>
 #include "util/SophusUtil.h"
 #include "util/Configuration.h"
+#include "util/MovingAverage.h"
 
 #include "DataStructures/Frame.h"
+#include "GlobalMapping/ThumbnailIndex.h"
 
 
 namespace lsd_slam
@@ -53,33 +56,61 @@ public:
 	~Relocalizer();
 
 	void updateCurrentFrame(std::shared_ptr<Frame> currentFrame);
-	void start(std::vector< Frame::SharedPtr > &allKeyframesList);
+	// thumbnailIndex (optional) narrows down the keyframes each round scores.
+	void start(std::vector< Frame::SharedPtr > &allKeyframesList, const ThumbnailIndex* thumbnailIndex = nullptr);
 	void stop();
 
 	bool waitResult(int milliseconds);
 	RelocalizerResult getResult();  //Frame* &out_keyframe, std::shared_ptr<Frame> &frame, int &out_successfulFrameID, SE3 &out_frameToKeyframe);
 
 	bool isRunning;
+
+	// time from start() to a result, over all successful relocalizations.
+	MsRateAverage perf;
 private:
 	const Configuration &_conf;
 
 	// int w, h;
 	// Eigen::Matrix3f K;
+	// persistent worker pool, spawned by the first start(). Each worker owns
+	// its SE3Tracker. stop() only makes them idle; the destructor ends them.
 	boost::thread relocThreads[RELOCALIZE_THREADS];
-	bool running[RELOCALIZE_THREADS];
+	int numWorkers;
+	bool quit;
+
+	// bumped by start() and stop(); work begun in an older session is
+	// abandoned between alignments, its results are dropped.
+	std::atomic<int> session;
 
 	// locking & signalling structures
 	boost::mutex exMutex;
 	boost::condition_variable newCurrentFrameSignal;
 	boost::condition_variable resultReadySignal;
 
-	// for rapid-checking
+	// keyframes to relocalize on.
 	std::vector<Frame::SharedPtr> KFForReloc;
+	const ThumbnailIndex* thumbnails;
+	// newest frame, set by updateCurrentFrame().
 	std::shared_ptr<Frame> CurrentRelocFrame;
+
+	// one round: score roundKFs (KFForReloc, or the closest matches in the
+	// thumbnail index) against RoundRelocFrame with the cheap permaRef
+	// prefilter, in batches of RELOCALIZE_SCORE_BATCH. Then fully align
+	// all of them, best first.
+	std::shared_ptr<Frame> RoundRelocFrame;
+	std::vector<Frame::SharedPtr> roundKFs;
+	std::vector<float> KFScores;
+	int nextScoreIDX;
+	int numScored;
+	std::vector<int> rankedKFs;
 	int nextRelocIDX;
-	int maxRelocIDX;
 	bool continueRunning;
 
+	// stats
+	Timer relocTimer;
+	int numRounds;
+	int numAlignments;
+
 	// result!
 	Frame::SharedPtr resultRelocFrame;
 	bool hasResult;
@@ -88,6 +119,10 @@ private:
 	SE3 resultFrameToKeyframe;
 
 
+	// both called with exMutex held.
+	void startRound();
+	void rankCandidates();
+
 	void threadLoop(int idx);
 };
 
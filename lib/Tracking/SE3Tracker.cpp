@@ -28,6 +28,9 @@ using std::stringstream;
 #include "util/globalFuncs.h"
 #include "IOWrapper/ImageDisplay.h"
 #include "Tracking/LGSX.h"
+#include "util/Timer.h"
+#include "util/AVXUtil.h"
+#include "util/IndexThreadReduce.h"
 
 namespace lsd_slam
 {
@@ -81,6 +84,9 @@ SE3Tracker::SE3Tracker(const ImageSize &sz )
 	pointUsage = 0;
 
 	diverged = false;
+	lastLevel = -1;
+	lastIterations = 0;
+	lastDeadlineHit = false;
 }
 
 SE3Tracker::~SE3Tracker()
@@ -115,35 +121,96 @@ float SE3Tracker::checkPermaRefOverlap(
 	Sophus::SE3f referenceToFrame = referenceToFrameOrg.cast<float>();
 	boost::unique_lock<boost::mutex> lock2 = boost::unique_lock<boost::mutex>(reference->permaRef_mutex);
 
-	int w2 = reference->width(QUICK_KF_CHECK_LVL)-1;
-	int h2 = reference->height(QUICK_KF_CHECK_LVL)-1;
-	Eigen::Matrix3f KLvl = reference->K(QUICK_KF_CHECK_LVL);
-	float fx_l = KLvl(0,0);
-	float fy_l = KLvl(1,1);
-	float cx_l = KLvl(0,2);
-	float cy_l = KLvl(1,2);
+	PermaRefCandidate result;
+	callOptimized(calcPermaRefOverlap, (reference, referenceToFrame, QUICK_KF_CHECK_LVL, result));
 
-	Eigen::Matrix3f rotMat = referenceToFrame.rotationMatrix();
-	Eigen::Vector3f transVec = referenceToFrame.translation();
+	pointUsage = result.pointUsage;
+	return pointUsage;
+}
 
-	const Eigen::Vector3f* refPoint_max = reference->permaRef_posData + reference->permaRefNumPts;
-	const Eigen::Vector3f* refPoint = reference->permaRef_posData;
 
-	float usageCount = 0;
-	for(;refPoint<refPoint_max; refPoint++)
+float SE3Tracker::scorePermaRef(
+		Frame* reference,
+		Frame* frame,
+		SE3 referenceToFrameOrg)
+{
+	Sophus::SE3f referenceToFrame = referenceToFrameOrg.cast<float>();
+
+	boost::shared_lock<boost::shared_mutex> lock = frame->getActiveLock();
+	boost::unique_lock<boost::mutex> lock2 = boost::unique_lock<boost::mutex>(reference->permaRef_mutex);
+
+	affineEstimation_a = 1; affineEstimation_b = 0;
+
+	PermaRefCandidate result;
+	callOptimized(calcPermaRefScore, (reference->permaRef, frame, referenceToFrame, QUICK_KF_CHECK_LVL, result));
+
+	pointUsage = result.pointUsage;
+	_lastGoodCount = result.goodCount;
+	_lastBadCount = result.badCount;
+	return result.score;
+}
+
+
+IndexThreadReduce& SE3Tracker::getBatchReducer()
+{
+	if(!batchReducer)
+		batchReducer.reset(new IndexThreadReduce());
+	return *batchReducer;
+}
+
+void SE3Tracker::checkPermaRefOverlapBatch(
+		std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> > &candidates,
+		bool parallel)
+{
+	int num = candidates.size();
+	if(parallel && multiThreading && num > 1)
+		getBatchReducer().reduce(boost::bind(&SE3Tracker::checkPermaRefOverlapRange, this, &candidates, _1, _2, _3), 0, num, 1);
+	else
+		checkPermaRefOverlapRange(&candidates, 0, num, nullptr);
+}
+
+void SE3Tracker::scorePermaRefBatch(
+		Frame* frame,
+		std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> > &candidates,
+		bool parallel)
+{
+	int num = candidates.size();
+	if(num == 0) return;
+
+	// one lock and one pyramid for all candidates. Building the level here
+	// keeps the workers from racing on it.
+	boost::shared_lock<boost::shared_mutex> lock = frame->getActiveLock();
+	frame->gradients(QUICK_KF_CHECK_LVL);
+
+	if(parallel && multiThreading && num > 1)
+		getBatchReducer().reduce(boost::bind(&SE3Tracker::scorePermaRefRange, this, frame, &candidates, _1, _2, _3), 0, num, 1);
+	else
+		scorePermaRefRange(frame, &candidates, 0, num, nullptr);
+}
+
+void SE3Tracker::checkPermaRefOverlapRange(
+		std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> >* candidates,
+		int first, int end, RunningStats* stats)
+{
+	for(int i=first;i<end;i++)
 	{
-		Eigen::Vector3f Wxp = rotMat * (*refPoint) + transVec;
-		float u_new = (Wxp[0]/Wxp[2])*fx_l + cx_l;
-		float v_new = (Wxp[1]/Wxp[2])*fy_l + cy_l;
-		if((u_new > 0 && v_new > 0 && u_new < w2 && v_new < h2))
-		{
-			float depthChange = (*refPoint)[2] / Wxp[2];
-			usageCount += depthChange < 1 ? depthChange : 1;
-		}
+		PermaRefCandidate &c = (*candidates)[i];
+		boost::unique_lock<boost::mutex> lock(c.reference->permaRef_mutex);
+		callOptimized(calcPermaRefOverlap, (c.reference, c.referenceToFrame.cast<float>(), QUICK_KF_CHECK_LVL, c));
 	}
+}
 
-	pointUsage = usageCount / (float)reference->permaRefNumPts;
-	return pointUsage;
+void SE3Tracker::scorePermaRefRange(
+		Frame* frame,
+		std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> >* candidates,
+		int first, int end, RunningStats* stats)
+{
+	for(int i=first;i<end;i++)
+	{
+		PermaRefCandidate &c = (*candidates)[i];
+		boost::unique_lock<boost::mutex> lock(c.reference->permaRef_mutex);
+		callOptimized(calcPermaRefScore, (c.reference->permaRef, frame, c.referenceToFrame.cast<float>(), QUICK_KF_CHECK_LVL, c));
+	}
 }
 
 
@@ -166,7 +233,7 @@ SE3 SE3Tracker::trackFrameOnPermaref(
 	diverged = false;
 	trackingWasGood = true;
 
-	callOptimized(calcResidualAndBuffers, (reference->permaRef_posData, reference->permaRef_colorAndVarData, 0, reference->permaRefNumPts, frame, referenceToFrame, QUICK_KF_CHECK_LVL, false));
+	callOptimized(calcResidualAndBuffers, (reference->permaRef, false, frame, referenceToFrame, QUICK_KF_CHECK_LVL, false));
 	if(buf_warped_size < MIN_GOODPERALL_PIXEL_ABSMIN * (_imgSize.width>>QUICK_KF_CHECK_LVL)*(_imgSize.height>>QUICK_KF_CHECK_LVL))
 	{
 		diverged = true;
@@ -201,7 +268,7 @@ SE3 SE3Tracker::trackFrameOnPermaref(
 			Sophus::SE3f new_referenceToFrame = Sophus::SE3f::exp((inc)) * referenceToFrame;
 
 			// re-evaluate residual
-			callOptimized(calcResidualAndBuffers, (reference->permaRef_posData, reference->permaRef_colorAndVarData, 0, reference->permaRefNumPts, frame, new_referenceToFrame, QUICK_KF_CHECK_LVL, false));
+			callOptimized(calcResidualAndBuffers, (reference->permaRef, false, frame, new_referenceToFrame, QUICK_KF_CHECK_LVL, false));
 			if(buf_warped_size < MIN_GOODPERALL_PIXEL_ABSMIN * (_imgSize.width>>QUICK_KF_CHECK_LVL)*(_imgSize.height>>QUICK_KF_CHECK_LVL))
 			{
 				diverged = true;
@@ -276,9 +343,11 @@ SE3 SE3Tracker::trackFrame(
 		const SE3& frameToReference_initialEstimate)
 {
 
+	Timer timer;
 	boost::shared_lock<boost::shared_mutex> lock = frame->getActiveLock();
 	diverged = false;
 	trackingWasGood = true;
+	lastDeadlineHit = false;
 	affineEstimation_a = 1; affineEstimation_b = 0;
 
 	if(saveAllTrackingStages)
@@ -303,21 +372,41 @@ SE3 SE3Tracker::trackFrame(
 	int numCalcWarpUpdateCalls[PYRAMID_LEVELS];
 
 	float last_residual = 0;
-	int lowestLvl;
+	int lowestLvl = SE3TRACKING_MAX_LEVEL-1;
+	float lastLvlMs = 0;
 
-	for(int lvl=SE3TRACKING_MAX_LEVEL-1; lvl >= SE3TRACKING_MIN_LEVEL; lvl-- )
+	for(int lvl=SE3TRACKING_MAX_LEVEL-1; lvl >= std::max(SE3TRACKING_MIN_LEVEL, settings.minLevel); lvl-- )
 	{
+		float lvlStartMs = timer.stop() * 1000.0f;
+
+		// over budget: keep the result of the coarser level rather than
+		// starting a finer one we expect not to finish in time. The cost of a
+		// level is predicted from the previous one, scaled by the point count
+		// (about 4x if the level's point cloud isn't built yet; a skipped level
+		// doesn't build it).
+		if(settings.maxTimeMs > 0 && lvl < SE3TRACKING_MAX_LEVEL-1)
+		{
+			float pointRatio = reference->numData[lvl] > 0 ?
+					reference->numData[lvl] / (float)std::max(1, reference->numData[lvl+1]) : 4.0f;
+			float predictedMs = lastLvlMs * pointRatio;
+			if(lvlStartMs + predictedMs > settings.maxTimeMs)
+			{
+				lastDeadlineHit = true;
+				LOGF_IF(DEBUG,printTrackingIterationInfo,"(%d): SKIPPING pyramid level, %.1fms spent + %.1fms expected > %.1fms budget.",
+						lvl, lvlStartMs, predictedMs, settings.maxTimeMs);
+				break;
+			}
+		}
+
+		reference->makePointCloud(lvl);
+
 		numCalcResidualCalls[lvl] = 0;
 		numCalcWarpUpdateCalls[lvl] = 0;
 		lowestLvl = lvl;
 
-		reference->makePointCloud(lvl);
-
 		LOG(INFO) << "Calculating initial residual on frame " << frame->id() << ", level " << lvl << " against reference frame " << reference->frameID << " with " << reference->numData[lvl] << " points";
-		callOptimized(calcResidualAndBuffers, (reference->posData[lvl],
-			reference->colorAndVarData[lvl],
-			SE3TRACKING_MIN_LEVEL == lvl ? reference->pointPosInXYGrid[lvl] : 0,
-			reference->numData[lvl],
+		callOptimized(calcResidualAndBuffers, (reference->points[lvl],
+			SE3TRACKING_MIN_LEVEL == lvl,
 			frame, referenceToFrame, lvl,
 			(plotTracking && lvl == SE3TRACKING_MIN_LEVEL)));
 
@@ -342,6 +431,13 @@ SE3 SE3Tracker::trackFrame(
 
 		for(int iteration=0; iteration < settings.maxItsPerLvl[lvl]; iteration++)
 		{
+			if(settings.maxTimeMs > 0 && timer.stop() * 1000.0f > settings.maxTimeMs)
+			{
+				lastDeadlineHit = true;
+				LOGF_IF(DEBUG,printTrackingIterationInfo,"(%d-%d): FINISHED pyramid level (time budget of %.1fms exceeded).",
+						lvl,iteration, settings.maxTimeMs);
+				break;
+			}
 
 			callOptimized(calculateWarpUpdate,(ls));
 
@@ -365,8 +461,7 @@ SE3 SE3Tracker::trackFrame(
 				//Sophus::SE3f new_referenceToFrame = referenceToFrame * Sophus::SE3f::exp((inc));
 
 				// re-evaluate residual
-				callOptimized(calcResidualAndBuffers, (reference->posData[lvl], reference->colorAndVarData[lvl],
-											SE3TRACKING_MIN_LEVEL == lvl ? reference->pointPosInXYGrid[lvl] : 0, reference->numData[lvl],
+				callOptimized(calcResidualAndBuffers, (reference->points[lvl], SE3TRACKING_MIN_LEVEL == lvl,
 											frame, new_referenceToFrame, lvl, (plotTracking && lvl == SE3TRACKING_MIN_LEVEL)));
 
 				if(buf_warped_size < MIN_GOODPERALL_PIXEL_ABSMIN* (_imgSize.width>>lvl)*(_imgSize.height>>lvl))
@@ -436,8 +531,14 @@ SE3 SE3Tracker::trackFrame(
 				}
 			}
 		}
+
+		lastLvlMs = timer.stop() * 1000.0f - lvlStartMs;
+		if(lastDeadlineHit) break;
 	}
 
+	lastLevel = lowestLvl;
+	lastIterations = numCalcWarpUpdateCalls[lowestLvl];
+
 
 	if(plotTracking)
 		Util::displayImage("TrackingResidual", debugImageResiduals, false);
@@ -459,11 +560,14 @@ SE3 SE3Tracker::trackFrame(
 
 	lastResidual = last_residual;
 
-	_pctGoodPerTotal = _lastGoodCount / (frame->width(SE3TRACKING_MIN_LEVEL)*frame->height(SE3TRACKING_MIN_LEVEL));
+	// counts are from the last level tracked on, which is coarser than
+	// SE3TRACKING_MIN_LEVEL if the time budget ran out or settings.minLevel
+	// is raised.
+	_pctGoodPerTotal = _lastGoodCount / (frame->width(lowestLvl)*frame->height(lowestLvl));
 	_pctGoodPerGoodBad = _lastGoodCount / (_lastGoodCount + _lastBadCount);
 
 	LOG(INFO) << "lastGoodCount " << _lastGoodCount << " lastBadCount " << _lastBadCount;
-	LOG(INFO) << frame->width(SE3TRACKING_MIN_LEVEL) << " " << frame->height(SE3TRACKING_MIN_LEVEL);
+	LOG(INFO) << frame->width(lowestLvl) << " " << frame->height(lowestLvl);
 	LOG(INFO) << _pctGoodPerTotal << " " << _pctGoodPerGoodBad;
 
 	trackingWasGood = !diverged
@@ -846,42 +950,311 @@ void SE3Tracker::calcResidualAndBuffers_debugFinish(int w)
 	}
 }
 
+#if defined(ENABLE_SSE)
+void SE3Tracker::calcPermaRefOverlapSSE(
+		Frame* reference,
+		const Sophus::SE3f& referenceToFrame,
+		int level,
+		PermaRefCandidate& out)
+{
+#if defined(__AVX2__)
+	Eigen::Matrix3f KLvl = reference->K(level);
+	Eigen::Matrix3f rotMat = referenceToFrame.rotationMatrix();
+	Eigen::Vector3f transVec = referenceToFrame.translation();
+
+	const TrackingPointCloud& refPoints = reference->permaRef;
+	const int refNum = refPoints.size();
+
+	const __m256 r00 = _mm256_set1_ps(rotMat(0,0)), r01 = _mm256_set1_ps(rotMat(0,1)), r02 = _mm256_set1_ps(rotMat(0,2));
+	const __m256 r10 = _mm256_set1_ps(rotMat(1,0)), r11 = _mm256_set1_ps(rotMat(1,1)), r12 = _mm256_set1_ps(rotMat(1,2));
+	const __m256 r20 = _mm256_set1_ps(rotMat(2,0)), r21 = _mm256_set1_ps(rotMat(2,1)), r22 = _mm256_set1_ps(rotMat(2,2));
+	const __m256 tx = _mm256_set1_ps(transVec[0]), ty = _mm256_set1_ps(transVec[1]), tz = _mm256_set1_ps(transVec[2]);
+	const __m256 fx = _mm256_set1_ps(KLvl(0,0)), fy = _mm256_set1_ps(KLvl(1,1));
+	const __m256 cx = _mm256_set1_ps(KLvl(0,2)), cy = _mm256_set1_ps(KLvl(1,2));
+
+	const __m256 zeros = _mm256_setzero_ps();
+	const __m256 ones = _mm256_set1_ps(1.0f);
+	const __m256 maxU = _mm256_set1_ps(reference->width(level)-1), maxV = _mm256_set1_ps(reference->height(level)-1);
+
+	__m256 usageCount = _mm256_setzero_ps();
+
+	for(int i=0; i<refNum; i+=8)
+	{
+		__m256 rx = _mm256_load_ps(refPoints.x+i);
+		__m256 ry = _mm256_load_ps(refPoints.y+i);
+		__m256 rz = _mm256_load_ps(refPoints.z+i);
+
+		__m256 px = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r00,rx), _mm256_mul_ps(r01,ry)), _mm256_add_ps(_mm256_mul_ps(r02,rz), tx));
+		__m256 py = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r10,rx), _mm256_mul_ps(r11,ry)), _mm256_add_ps(_mm256_mul_ps(r12,rz), ty));
+		__m256 pz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r20,rx), _mm256_mul_ps(r21,ry)), _mm256_add_ps(_mm256_mul_ps(r22,rz), tz));
+
+		__m256 u_new = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(px, pz), fx), cx);
+		__m256 v_new = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(py, pz), fy), cy);
+
+		__m256 valid = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(u_new, zeros, _CMP_GT_OQ), _mm256_cmp_ps(v_new, zeros, _CMP_GT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(u_new, maxU, _CMP_LT_OQ), _mm256_cmp_ps(v_new, maxV, _CMP_LT_OQ)));
+		valid = _mm256_and_ps(valid, laneMask(i, refNum));
+
+		__m256 depthChange = _mm256_div_ps(rz, pz);
+		usageCount = _mm256_add_ps(usageCount, _mm256_and_ps(_mm256_min_ps(depthChange, ones), valid));
+	}
+
+	out.pointUsage = hsum(usageCount) / (float)refNum;
+#else
+	calcPermaRefOverlap(reference, referenceToFrame, level, out);
+#endif
+}
+#endif
+
+#if defined(ENABLE_NEON)
+void SE3Tracker::calcPermaRefOverlapNEON(
+		Frame* reference,
+		const Sophus::SE3f& referenceToFrame,
+		int level,
+		PermaRefCandidate& out)
+{
+	calcPermaRefOverlap(reference, referenceToFrame, level, out);
+}
+#endif
+
+
+// fraction of reference's permaRef visible in a frame at referenceToFrame.
+void SE3Tracker::calcPermaRefOverlap(
+		Frame* reference,
+		const Sophus::SE3f& referenceToFrame,
+		int level,
+		PermaRefCandidate& out)
+{
+	int w2 = reference->width(level)-1;
+	int h2 = reference->height(level)-1;
+	Eigen::Matrix3f KLvl = reference->K(level);
+	float fx_l = KLvl(0,0);
+	float fy_l = KLvl(1,1);
+	float cx_l = KLvl(0,2);
+	float cy_l = KLvl(1,2);
+
+	Eigen::Matrix3f rotMat = referenceToFrame.rotationMatrix();
+	Eigen::Vector3f transVec = referenceToFrame.translation();
+
+	const TrackingPointCloud& refPoints = reference->permaRef;
+	const float* refX = refPoints.x;
+	const float* refY = refPoints.y;
+	const float* refZ = refPoints.z;
+	const int refNum = refPoints.size();
+
+	float usageCount = 0;
+	for(int i=0; i<refNum; i++)
+	{
+		Eigen::Vector3f Wxp = rotMat * Eigen::Vector3f(refX[i], refY[i], refZ[i]) + transVec;
+		float u_new = (Wxp[0]/Wxp[2])*fx_l + cx_l;
+		float v_new = (Wxp[1]/Wxp[2])*fy_l + cy_l;
+		if((u_new > 0 && v_new > 0 && u_new < w2 && v_new < h2))
+		{
+			float depthChange = refZ[i] / Wxp[2];
+			usageCount += depthChange < 1 ? depthChange : 1;
+		}
+	}
+
+	out.pointUsage = usageCount / (float)refNum;
+}
+
+
+// pointUsage * good / (good + bad); 0 if too few points are in the image.
+static inline float permaRefScore(const PermaRefCandidate& c, int level, Frame* frame)
+{
+	if(c.goodCount + c.badCount < MIN_GOODPERALL_PIXEL_ABSMIN * frame->width(level)*frame->height(level))
+		return 0;
+	return c.pointUsage * c.goodCount / (c.goodCount + c.badCount);
+}
+
+#if defined(ENABLE_SSE)
+void SE3Tracker::calcPermaRefScoreSSE(
+		const TrackingPointCloud& refPoints,
+		Frame* frame,
+		const Sophus::SE3f& referenceToFrame,
+		int level,
+		PermaRefCandidate& out)
+{
+#if defined(__AVX2__)
+	int w = frame->width(level);
+	int h = frame->height(level);
+	Eigen::Matrix3f KLvl = frame->K(level);
+	Eigen::Matrix3f rotMat = referenceToFrame.rotationMatrix();
+	Eigen::Vector3f transVec = referenceToFrame.translation();
+
+	const float* frame_gradients = frame->gradients(level)->data();
+	const int refNum = refPoints.size();
+
+	const __m256 r00 = _mm256_set1_ps(rotMat(0,0)), r01 = _mm256_set1_ps(rotMat(0,1)), r02 = _mm256_set1_ps(rotMat(0,2));
+	const __m256 r10 = _mm256_set1_ps(rotMat(1,0)), r11 = _mm256_set1_ps(rotMat(1,1)), r12 = _mm256_set1_ps(rotMat(1,2));
+	const __m256 r20 = _mm256_set1_ps(rotMat(2,0)), r21 = _mm256_set1_ps(rotMat(2,1)), r22 = _mm256_set1_ps(rotMat(2,2));
+	const __m256 tx = _mm256_set1_ps(transVec[0]), ty = _mm256_set1_ps(transVec[1]), tz = _mm256_set1_ps(transVec[2]);
+	const __m256 fx = _mm256_set1_ps(KLvl(0,0)), fy = _mm256_set1_ps(KLvl(1,1));
+	const __m256 cx = _mm256_set1_ps(KLvl(0,2)), cy = _mm256_set1_ps(KLvl(1,2));
+
+	const __m256 ones = _mm256_set1_ps(1.0f);
+	const __m256 twos = _mm256_set1_ps(2.0f);
+	const __m256 maxU = _mm256_set1_ps(w-2), maxV = _mm256_set1_ps(h-2);
+	const __m256 maxDiffConst = _mm256_set1_ps(MAX_DIFF_CONSTANT);
+	const __m256 maxDiffGradMult = _mm256_set1_ps(MAX_DIFF_GRAD_MULT);
+
+	__m256 usageCount = _mm256_setzero_ps();
+	int goodCount = 0;
+	int inImageCount = 0;
+
+	for(int i=0; i<refNum; i+=8)
+	{
+		__m256 rx = _mm256_load_ps(refPoints.x+i);
+		__m256 ry = _mm256_load_ps(refPoints.y+i);
+		__m256 rz = _mm256_load_ps(refPoints.z+i);
+
+		__m256 px = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r00,rx), _mm256_mul_ps(r01,ry)), _mm256_add_ps(_mm256_mul_ps(r02,rz), tx));
+		__m256 py = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r10,rx), _mm256_mul_ps(r11,ry)), _mm256_add_ps(_mm256_mul_ps(r12,rz), ty));
+		__m256 pz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r20,rx), _mm256_mul_ps(r21,ry)), _mm256_add_ps(_mm256_mul_ps(r22,rz), tz));
+
+		__m256 u_new = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(px, pz), fx), cx);
+		__m256 v_new = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(py, pz), fy), cy);
+
+		__m256 valid = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(u_new, ones, _CMP_GT_OQ), _mm256_cmp_ps(v_new, ones, _CMP_GT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(u_new, maxU, _CMP_LT_OQ), _mm256_cmp_ps(v_new, maxV, _CMP_LT_OQ)));
+		valid = _mm256_and_ps(valid, laneMask(i, refNum));
+
+		int mask = _mm256_movemask_ps(valid);
+		if(mask == 0) continue;
+
+		u_new = _mm256_blendv_ps(twos, u_new, valid);
+		v_new = _mm256_blendv_ps(twos, v_new, valid);
+
+		__m256 interp[3];
+		interpolate43(frame_gradients, u_new, v_new, w, interp);
+
+		__m256 residual = _mm256_sub_ps(_mm256_load_ps(refPoints.color+i), interp[2]);
+
+		// isGood = r*r < MAX_DIFF_CONSTANT + MAX_DIFF_GRAD_MULT * |g|^2
+		__m256 gradSqr = _mm256_add_ps(_mm256_mul_ps(interp[0], interp[0]), _mm256_mul_ps(interp[1], interp[1]));
+		__m256 isGood = _mm256_cmp_ps(
+				_mm256_mul_ps(residual, residual),
+				_mm256_add_ps(maxDiffConst, _mm256_mul_ps(maxDiffGradMult, gradSqr)), _CMP_LT_OQ);
+
+		goodCount += __builtin_popcount(_mm256_movemask_ps(_mm256_and_ps(isGood, valid)));
+		inImageCount += __builtin_popcount(mask);
+
+		__m256 depthChange = _mm256_div_ps(rz, pz);
+		usageCount = _mm256_add_ps(usageCount, _mm256_and_ps(_mm256_min_ps(depthChange, ones), valid));
+	}
+
+	out.pointUsage = hsum(usageCount) / (float)refNum;
+	out.goodCount = goodCount;
+	out.badCount = inImageCount - goodCount;
+	out.score = permaRefScore(out, level, frame);
+#else
+	calcPermaRefScore(refPoints, frame, referenceToFrame, level, out);
+#endif
+}
+#endif
+
+#if defined(ENABLE_NEON)
+void SE3Tracker::calcPermaRefScoreNEON(
+		const TrackingPointCloud& refPoints,
+		Frame* frame,
+		const Sophus::SE3f& referenceToFrame,
+		int level,
+		PermaRefCandidate& out)
+{
+	calcPermaRefScore(refPoints, frame, referenceToFrame, level, out);
+}
+#endif
+
+
+// residual classification of calcResidualAndBuffers (without affine
+// correction), without filling the buffers.
+void SE3Tracker::calcPermaRefScore(
+		const TrackingPointCloud& refPoints,
+		Frame* frame,
+		const Sophus::SE3f& referenceToFrame,
+		int level,
+		PermaRefCandidate& out)
+{
+	int w = frame->width(level);
+	int h = frame->height(level);
+	Eigen::Matrix3f KLvl = frame->K(level);
+	float fx_l = KLvl(0,0);
+	float fy_l = KLvl(1,1);
+	float cx_l = KLvl(0,2);
+	float cy_l = KLvl(1,2);
+
+	Eigen::Matrix3f rotMat = referenceToFrame.rotationMatrix();
+	Eigen::Vector3f transVec = referenceToFrame.translation();
+
+	const Eigen::Vector4f* frame_gradients = frame->gradients(level);
+	const int refNum = refPoints.size();
+
+	int goodCount = 0;
+	int badCount = 0;
+	float usageCount = 0;
+
+	for(int i=0; i<refNum; i++)
+	{
+		Eigen::Vector3f Wxp = rotMat * Eigen::Vector3f(refPoints.x[i], refPoints.y[i], refPoints.z[i]) + transVec;
+		float u_new = (Wxp[0]/Wxp[2])*fx_l + cx_l;
+		float v_new = (Wxp[1]/Wxp[2])*fy_l + cy_l;
+
+		if(!(u_new > 1 && v_new > 1 && u_new < w-2 && v_new < h-2))
+			continue;
+
+		Eigen::Vector3f resInterp = getInterpolatedElement43(frame_gradients, u_new, v_new, w);
+
+		float residual = refPoints.color[i] - resInterp[2];
+		bool isGood = residual*residual / (MAX_DIFF_CONSTANT + MAX_DIFF_GRAD_MULT*(resInterp[0]*resInterp[0] + resInterp[1]*resInterp[1])) < 1;
+
+		if(isGood)
+			goodCount++;
+		else
+			badCount++;
+
+		float depthChange = refPoints.z[i] / Wxp[2];
+		usageCount += depthChange < 1 ? depthChange : 1;
+	}
+
+	out.pointUsage = usageCount / (float)refNum;
+	out.goodCount = goodCount;
+	out.badCount = badCount;
+	out.score = permaRefScore(out, level, frame);
+}
+
+
 #if defined(ENABLE_SSE)
 float SE3Tracker::calcResidualAndBuffersSSE(
-		const Eigen::Vector3f* refPoint,
-		const Eigen::Vector2f* refColVar,
-		int* idxBuf,
-		int refNum,
+		const TrackingPointCloud& refPoints,
+		bool markGoodPixels,
 		Frame* frame,
 		const Sophus::SE3f& referenceToFrame,
 		int level,
 		bool plotResidual)
 {
-	return calcResidualAndBuffers(refPoint, refColVar, idxBuf, refNum, frame, referenceToFrame, level, plotResidual);
+	return calcResidualAndBuffers(refPoints, markGoodPixels, frame, referenceToFrame, level, plotResidual);
 }
 #endif
 
 #if defined(ENABLE_NEON)
 float SE3Tracker::calcResidualAndBuffersNEON(
-		const Eigen::Vector3f* refPoint,
-		const Eigen::Vector2f* refColVar,
-		int* idxBuf,
-		int refNum,
+		const TrackingPointCloud& refPoints,
+		bool markGoodPixels,
 		Frame* frame,
 		const Sophus::SE3f& referenceToFrame,
 		int level,
 		bool plotResidual)
 {
-	return calcResidualAndBuffers(refPoint, refColVar, idxBuf, refNum, frame, referenceToFrame, level, plotResidual);
+	return calcResidualAndBuffers(refPoints, markGoodPixels, frame, referenceToFrame, level, plotResidual);
 }
 #endif
 
 
 float SE3Tracker::calcResidualAndBuffers(
-		const Eigen::Vector3f* refPoint,
-		const Eigen::Vector2f* refColVar,
-		int* idxBuf,
-		int refNum,
+		const TrackingPointCloud& refPoints,
+		bool markGoodPixels,
 		Frame* frame,
 		const Sophus::SE3f& referenceToFrame,
 		int level,
@@ -904,7 +1277,13 @@ float SE3Tracker::calcResidualAndBuffers(
 	Eigen::Matrix3f rotMat = referenceToFrame.rotationMatrix();
 	Eigen::Vector3f transVec = referenceToFrame.translation();
 
-	const Eigen::Vector3f* refPoint_max = refPoint + refNum;
+	const float* refX = refPoints.x;
+	const float* refY = refPoints.y;
+	const float* refZ = refPoints.z;
+	const float* refColor = refPoints.color;
+	const float* refVar = refPoints.idepthVar;
+	const int* idxBuf = refPoints.pixelIdx;
+	const int refNum = refPoints.size();
 
 
 	const Eigen::Vector4f* frame_gradients = frame->gradients(level);
@@ -913,7 +1292,7 @@ float SE3Tracker::calcResidualAndBuffers(
 
 	float sumResUnweighted = 0;
 
-	bool* isGoodOutBuffer = idxBuf != 0 ? frame->refPixelWasGood() : 0;
+	bool* isGoodOutBuffer = markGoodPixels ? frame->refPixelWasGood() : 0;
 
 	int goodCount = 0;
 	int badCount = 0;
@@ -929,12 +1308,10 @@ float SE3Tracker::calcResidualAndBuffers(
 		// LOG(DEBUG) << "Rotmat: " << rotMat;
 		// LOG(DEBUG) << "transVec: " << transVec;
 
-	int loop = 0;
-	for(;refPoint<refPoint_max; refPoint++, refColVar++, idxBuf++, loop++)
+	for(int loop=0; loop<refNum; loop++)
 	{
-
-
-		Eigen::Vector3f Wxp = rotMat * (*refPoint) + transVec;
+		Eigen::Vector3f refPoint(refX[loop], refY[loop], refZ[loop]);
+		Eigen::Vector3f Wxp = rotMat * refPoint + transVec;
 		float u_new = (Wxp[0]/Wxp[2])*fx_l + cx_l;
 		float v_new = (Wxp[1]/Wxp[2])*fy_l + cy_l;
 
@@ -942,16 +1319,16 @@ float SE3Tracker::calcResidualAndBuffers(
 		// (inverse test to exclude NANs)
 		if(!(u_new > 1 && v_new > 1 && u_new < w-2 && v_new < h-2))
 		{
-			if(isGoodOutBuffer != 0) isGoodOutBuffer[*idxBuf] = false;
+			if(isGoodOutBuffer != 0) isGoodOutBuffer[idxBuf[loop]] = false;
 
-			LOG_IF(DEBUG, loop < 50) << "Ref point: " << *refPoint;
+			LOG_IF(DEBUG, loop < 50) << "Ref point: " << refPoint;
 			LOG_IF(DEBUG, loop < 50) << "Wxp :" << Wxp[0] << " " << Wxp[1] << " " << Wxp[2] << " maps to " << u_new << " " << v_new;
 			continue;
 		}
 
 		Eigen::Vector3f resInterp = getInterpolatedElement43(frame_gradients, u_new, v_new, w);
 
-		float c1 = affineEstimation_a * (*refColVar)[0] + affineEstimation_b;
+		float c1 = affineEstimation_a * refColor[loop] + affineEstimation_b;
 		float c2 = resInterp[2];
 		float residual = c1 - c2;
 
@@ -965,7 +1342,7 @@ float SE3Tracker::calcResidualAndBuffers(
 		bool isGood = residual*residual / (MAX_DIFF_CONSTANT + MAX_DIFF_GRAD_MULT*(resInterp[0]*resInterp[0] + resInterp[1]*resInterp[1])) < 1;
 
 		if(isGoodOutBuffer != 0)
-			isGoodOutBuffer[*idxBuf] = isGood;
+			isGoodOutBuffer[idxBuf[loop]] = isGood;
 
 		*(buf_warped_x+idx) = Wxp(0);
 		*(buf_warped_y+idx) = Wxp(1);
@@ -975,8 +1352,8 @@ float SE3Tracker::calcResidualAndBuffers(
 		*(buf_warped_dy+idx) = fy_l * resInterp[1];
 		*(buf_warped_residual+idx) = residual;
 
-		*(buf_d+idx) = 1.0f / (*refPoint)[2];
-		*(buf_idepthVar+idx) = (*refColVar)[1];
+		*(buf_d+idx) = 1.0f / refZ[loop];
+		*(buf_idepthVar+idx) = refVar[loop];
 		idx++;
 
 
@@ -989,7 +1366,7 @@ float SE3Tracker::calcResidualAndBuffers(
 		else
 			badCount++;
 
-		float depthChange = (*refPoint)[2] / Wxp[2];	// if depth becomes larger: pixel becomes "smaller", hence count it less.
+		float depthChange = refZ[loop] / Wxp[2];	// if depth becomes larger: pixel becomes "smaller", hence count it less.
 		usageCount += depthChange < 1 ? depthChange : 1;
 
 
@@ -999,7 +1376,7 @@ float SE3Tracker::calcResidualAndBuffers(
 			// for debug plot only: find x,y again.
 			// horribly inefficient, but who cares at this point...
 			int width = _imgSize.width;
-			Eigen::Vector3f point = KLvl * (*refPoint);
+			Eigen::Vector3f point = KLvl * refPoint;
 			int x = point[0] / point[2] + 0.5f;
 			int y = point[1] / point[2] + 0.5f;
 
@@ -1023,7 +1400,7 @@ float SE3Tracker::calcResidualAndBuffers(
 	_lastBadCount = badCount;
 	lastMeanRes = sumSignedRes / goodCount;
 
-	LOG(DEBUG) << "loop: " << loop << " buf_warped_size = " << buf_warped_size << "; goodCount = " << goodCount << "; badCount = " << badCount;
+	LOG(DEBUG) << "refNum: " << refNum << " buf_warped_size = " << buf_warped_size << "; goodCount = " << goodCount << "; badCount = " << badCount;
 	// if( buf_warped_size == 0 ) {
 	// 		LOG(DEBUG) << "Trap!";
 	// }
@@ -1117,7 +1494,8 @@ void SE3Tracker::calculateWarpUpdateSSE(
 
 		if(i+3<buf_warped_size)
 		{
-			ls.updateSSE(J61, J62, J63, J64, J65, J66, _mm_load_ps(buf_warped_residual+i), _mm_load_ps(buf_weight_p+i));
+			const __m128 J6[6] = {J61, J62, J63, J64, J65, J66};
+			ls.update4(J6, _mm_load_ps(buf_warped_residual+i), _mm_load_ps(buf_weight_p+i));
 		}
 		else
 		{
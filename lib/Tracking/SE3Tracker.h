@@ -19,6 +19,8 @@
 */
 
 #pragma once
+#include <memory>
+#include <vector>
 #include <opencv2/core/core.hpp>
 #include "util/settings.h"
 #include "util/EigenCoreInclude.h"
@@ -31,7 +33,32 @@ namespace lsd_slam
 {
 
 class TrackingReference;
+class TrackingPointCloud;
 class Frame;
+class IndexThreadReduce;
+
+
+// one reference keyframe of a batched permaRef check against a single frame.
+struct PermaRefCandidate
+{
+	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+	Frame* reference;
+	SE3 referenceToFrame;
+
+	// results, as pointUsage / lastGoodCount() / lastBadCount() of the single calls.
+	float pointUsage;
+	float goodCount;
+	float badCount;
+
+	// scorePermaRefBatch only: the value scorePermaRef() returns.
+	float score;
+
+	PermaRefCandidate()
+		: reference(nullptr), pointUsage(0), goodCount(0), badCount(0), score(0) {}
+	PermaRefCandidate(Frame* ref, const SE3& refToFrame)
+		: reference(ref), referenceToFrame(refToFrame), pointUsage(0), goodCount(0), badCount(0), score(0) {}
+};
 
 
 class SE3Tracker
@@ -73,6 +100,28 @@ public:
 			Frame* reference,
 			SE3 referenceToFrame);
 
+	// cheap relocalization prefilter: photometric check of reference's permaRef
+	// at referenceToFrame, without any optimization. Returns
+	// pointUsage * good / (good + bad), the same measure relocalization
+	// thresholds with relocalizationTH; 0 if too few points are visible.
+	float scorePermaRef(
+			Frame* reference,
+			Frame* frame,
+			SE3 referenceToFrame);
+
+	// batched checkPermaRefOverlap() / scorePermaRef() of many references
+	// against one frame: the frame is locked once and its QUICK_KF_CHECK_LVL
+	// level stays in cache while all candidates are warped onto it. With
+	// parallel (and multiThreading), candidates are spread over MAPPING_THREADS
+	// workers. Results go to the candidates; the tracker state is untouched.
+	void checkPermaRefOverlapBatch(
+			std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> > &candidates,
+			bool parallel = false);
+	void scorePermaRefBatch(
+			Frame* frame,
+			std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> > &candidates,
+			bool parallel = false);
+
 
 	float pointUsage;
 	float lastGoodCount() const { return _lastGoodCount; }
@@ -89,6 +138,12 @@ public:
 
 	bool diverged;
 	bool trackingWasGood;
+
+	// pyramid level and number of iterations on it the last trackFrame()
+	// result came from, and whether settings.maxTimeMs cut it short.
+	int lastLevel;
+	int lastIterations;
+	bool lastDeadlineHit;
 private:
 
 	float _lastGoodCount;
@@ -110,12 +165,22 @@ private:
 
 	int buf_warped_size;
 
+	// created on the first parallel batch call.
+	std::unique_ptr<IndexThreadReduce> batchReducer;
+	IndexThreadReduce& getBatchReducer();
+
+	void checkPermaRefOverlapRange(
+			std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> >* candidates,
+			int first, int end, RunningStats* stats);
+	void scorePermaRefRange(
+			Frame* frame,
+			std::vector<PermaRefCandidate, Eigen::aligned_allocator<PermaRefCandidate> >* candidates,
+			int first, int end, RunningStats* stats);
+
 
 	float calcResidualAndBuffers(
-			const Eigen::Vector3f* refPoint,
-			const Eigen::Vector2f* refColVar,
-			int* idxBuf,
-			int refNum,
+			const TrackingPointCloud& refPoints,
+			bool markGoodPixels,
 			Frame* frame,
 			const Sophus::SE3f& referenceToFrame,
 			int level,
@@ -123,10 +188,8 @@ private:
 
 #if defined(ENABLE_SSE)
 	float calcResidualAndBuffersSSE(
-			const Eigen::Vector3f* refPoint,
-			const Eigen::Vector2f* refColVar,
-			int* idxBuf,
-			int refNum,
+			const TrackingPointCloud& refPoints,
+			bool markGoodPixels,
 			Frame* frame,
 			const Sophus::SE3f& referenceToFrame,
 			int level,
@@ -134,10 +197,8 @@ private:
 #endif
 #if defined(ENABLE_NEON)
 	float calcResidualAndBuffersNEON(
-			const Eigen::Vector3f* refPoint,
-			const Eigen::Vector2f* refColVar,
-			int* idxBuf,
-			int refNum,
+			const TrackingPointCloud& refPoints,
+			bool markGoodPixels,
 			Frame* frame,
 			const Sophus::SE3f& referenceToFrame,
 			int level,
@@ -149,6 +210,55 @@ private:
 
 
 
+	// stateless, so the batch calls can run them concurrently.
+	static void calcPermaRefOverlap(
+			Frame* reference,
+			const Sophus::SE3f& referenceToFrame,
+			int level,
+			PermaRefCandidate& out);
+#if defined(ENABLE_SSE)
+	static void calcPermaRefOverlapSSE(
+			Frame* reference,
+			const Sophus::SE3f& referenceToFrame,
+			int level,
+			PermaRefCandidate& out);
+#endif
+#if defined(ENABLE_NEON)
+	static void calcPermaRefOverlapNEON(
+			Frame* reference,
+			const Sophus::SE3f& referenceToFrame,
+			int level,
+			PermaRefCandidate& out);
+#endif
+
+	static void calcPermaRefScore(
+			const TrackingPointCloud& refPoints,
+			Frame* frame,
+			const Sophus::SE3f& referenceToFrame,
+			int level,
+			PermaRefCandidate& out);
+#if defined(ENABLE_SSE)
+	static void calcPermaRefScoreSSE(
+			const TrackingPointCloud& refPoints,
+			Frame* frame,
+			const Sophus::SE3f& referenceToFrame,
+			int level,
+			PermaRefCandidate& out);
+#endif
+#if defined(ENABLE_NEON)
+	static void calcPermaRefScoreNEON(
+			const TrackingPointCloud& refPoints,
+			Frame* frame,
+			const Sophus::SE3f& referenceToFrame,
+			int level,
+			PermaRefCandidate& out);
+#endif
+
+
+
+
+
+
 	float calcWeightsAndResidual(
 			const Sophus::SE3f& referenceToFrame);
 #if defined(ENABLE_SSE)
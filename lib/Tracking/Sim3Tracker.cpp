@@ -25,6 +25,9 @@
 #include "util/globalFuncs.h"
 #include "IOWrapper/ImageDisplay.h"
 #include "Tracking/LGSX.h"
+#include "Tracking/TrackingPointCloud.h"
+#include "DataStructures/FrameMemory.h"
+#include "util/AVXUtil.h"
 
 namespace lsd_slam
 {
@@ -33,7 +36,9 @@ namespace lsd_slam
 #if defined(ENABLE_NEON)
 	#define callOptimized(function, arguments) function##NEON arguments
 #else
-	#if defined(ENABLE_SSE)
+	#if defined(ENABLE_SSE) && defined(__AVX2__)
+		#define callOptimized(function, arguments) (USESSE ? function##AVX arguments : function arguments)
+	#elif defined(ENABLE_SSE)
 		#define callOptimized(function, arguments) (USESSE ? function##SSE arguments : function arguments)
 	#else
 		#define callOptimized(function, arguments) function arguments
@@ -42,6 +47,12 @@ namespace lsd_slam
 
 
 
+// the vector kernels read and write whole registers past the last point.
+static float* allocBuffer(int area)
+{
+	return FrameMemory::getInstance().getFloatBuffer(TrackingPointCloud::padded(area) + TRACKING_POINTS_PADDING);
+}
+
 Sim3Tracker::Sim3Tracker( const ImageSize &sz )
 	: _imgSize( sz )
 {
@@ -49,24 +60,24 @@ Sim3Tracker::Sim3Tracker( const ImageSize &sz )
 
 	int area = _imgSize.area();
 
-	buf_warped_residual = new float[area];
-	buf_warped_weights = new float[area];
-	buf_warped_dx = new float[area];
-	buf_warped_dy = new float[area];
-	buf_warped_x = new float[area];
-	buf_warped_y = new float[area];
-	buf_warped_z = new float[area];
-
-	buf_d = new float[area];
-	buf_residual_d = new float[area];
-	buf_idepthVar = new float[area];
-	buf_warped_idepthVar = new float[area];
-	buf_weight_p = new float[area];
-	buf_weight_d = new float[area];
-
-	buf_weight_Huber = new float[area];
-	buf_weight_VarP = new float[area];
-	buf_weight_VarD = new float[area];
+	buf_warped_residual = allocBuffer(area);
+	buf_warped_weights = allocBuffer(area);
+	buf_warped_dx = allocBuffer(area);
+	buf_warped_dy = allocBuffer(area);
+	buf_warped_x = allocBuffer(area);
+	buf_warped_y = allocBuffer(area);
+	buf_warped_z = allocBuffer(area);
+
+	buf_d = allocBuffer(area);
+	buf_residual_d = allocBuffer(area);
+	buf_idepthVar = allocBuffer(area);
+	buf_warped_idepthVar = allocBuffer(area);
+	buf_weight_p = allocBuffer(area);
+	buf_weight_d = allocBuffer(area);
+
+	buf_weight_Huber = allocBuffer(area);
+	buf_weight_VarP = allocBuffer(area);
+	buf_weight_VarD = allocBuffer(area);
 
 	buf_warped_size = 0;
 
@@ -111,24 +122,24 @@ Sim3Tracker::~Sim3Tracker()
 	debugImageWeightedResD.release();
 
 
-	delete[] buf_warped_residual;
-	delete[] buf_warped_weights;
-	delete[] buf_warped_dx;
-	delete[] buf_warped_dy;
-	delete[] buf_warped_x;
-	delete[] buf_warped_y;
-	delete[] buf_warped_z;
-
-	delete[] buf_d;
-	delete[] buf_residual_d;
-	delete[] buf_idepthVar;
-	delete[] buf_warped_idepthVar;
-	delete[] buf_weight_p;
-	delete[] buf_weight_d;
-
-	delete[] buf_weight_Huber;
-	delete[] buf_weight_VarP;
-	delete[] buf_weight_VarD;
+	FrameMemory::getInstance().returnBuffer(buf_warped_residual);
+	FrameMemory::getInstance().returnBuffer(buf_warped_weights);
+	FrameMemory::getInstance().returnBuffer(buf_warped_dx);
+	FrameMemory::getInstance().returnBuffer(buf_warped_dy);
+	FrameMemory::getInstance().returnBuffer(buf_warped_x);
+	FrameMemory::getInstance().returnBuffer(buf_warped_y);
+	FrameMemory::getInstance().returnBuffer(buf_warped_z);
+
+	FrameMemory::getInstance().returnBuffer(buf_d);
+	FrameMemory::getInstance().returnBuffer(buf_residual_d);
+	FrameMemory::getInstance().returnBuffer(buf_idepthVar);
+	FrameMemory::getInstance().returnBuffer(buf_warped_idepthVar);
+	FrameMemory::getInstance().returnBuffer(buf_weight_p);
+	FrameMemory::getInstance().returnBuffer(buf_weight_d);
+
+	FrameMemory::getInstance().returnBuffer(buf_weight_Huber);
+	FrameMemory::getInstance().returnBuffer(buf_weight_VarP);
+	FrameMemory::getInstance().returnBuffer(buf_weight_VarD);
 }
 
 
@@ -371,6 +382,176 @@ void Sim3Tracker::calcSim3BuffersSSE(
 }
 #endif
 
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+void Sim3Tracker::calcSim3BuffersAVX(
+		const TrackingReference* reference,
+		Frame* frame,
+		const Sim3& referenceToFrame,
+		int level, bool plotWeights)
+{
+	// the debug images need the per-pixel path.
+	if(plotSim3TrackingIterationInfo)
+	{
+		calcSim3Buffers(reference, frame, referenceToFrame, level, plotWeights);
+		return;
+	}
+
+	// get static values
+	int w = frame->width(level);
+	int h = frame->height(level);
+	Eigen::Matrix3f KLvl = frame->K(level);
+
+	Eigen::Matrix3f rotMat = referenceToFrame.rxso3().matrix().cast<float>();
+	Eigen::Matrix3f rotMatUnscaled = referenceToFrame.rotationMatrix().cast<float>();
+	Eigen::Vector3f transVec = referenceToFrame.translation().cast<float>();
+
+	// Calculate rotation around optical axis for rotating source frame gradients
+	Eigen::Vector3f forwardVector(0, 0, -1);
+	Eigen::Vector3f rotatedForwardVector = rotMatUnscaled * forwardVector;
+	Eigen::Quaternionf shortestBackRotation;
+	shortestBackRotation.setFromTwoVectors(rotatedForwardVector, forwardVector);
+	Eigen::Matrix3f rollMat = shortestBackRotation.toRotationMatrix() * rotMatUnscaled;
+
+
+	const TrackingPointCloud& refPoints = reference->points[level];
+	const int refNum = refPoints.size();
+
+	const float* 	frame_idepth = frame->idepth(level);
+	const float* 	frame_idepthVar = frame->idepthVar(level);
+	const float* 	frame_gradients = frame->gradients(level)->data();	// dx, dy, I, - per pixel
+
+	const __m256 r00 = _mm256_set1_ps(rotMat(0,0)), r01 = _mm256_set1_ps(rotMat(0,1)), r02 = _mm256_set1_ps(rotMat(0,2));
+	const __m256 r10 = _mm256_set1_ps(rotMat(1,0)), r11 = _mm256_set1_ps(rotMat(1,1)), r12 = _mm256_set1_ps(rotMat(1,2));
+	const __m256 r20 = _mm256_set1_ps(rotMat(2,0)), r21 = _mm256_set1_ps(rotMat(2,1)), r22 = _mm256_set1_ps(rotMat(2,2));
+	const __m256 tx = _mm256_set1_ps(transVec[0]), ty = _mm256_set1_ps(transVec[1]), tz = _mm256_set1_ps(transVec[2]);
+
+	const __m256 fx = _mm256_set1_ps(KLvl(0,0)), fy = _mm256_set1_ps(KLvl(1,1));
+	const __m256 cx = _mm256_set1_ps(KLvl(0,2)), cy = _mm256_set1_ps(KLvl(1,2));
+
+	const __m256 xRoll0 = _mm256_set1_ps(rollMat(0,0)), xRoll1 = _mm256_set1_ps(rollMat(0,1));
+	const __m256 yRoll0 = _mm256_set1_ps(rollMat(1,0)), yRoll1 = _mm256_set1_ps(rollMat(1,1));
+
+	const __m256 affA = _mm256_set1_ps(affineEstimation_a), affB = _mm256_set1_ps(affineEstimation_b);
+
+	const __m256 zeros = _mm256_setzero_ps();
+	const __m256 ones = _mm256_set1_ps(1.0f);
+	const __m256 halfs = _mm256_set1_ps(0.5f);
+	const __m256 twos = _mm256_set1_ps(2.0f);
+	const __m256 minusOnes = _mm256_set1_ps(-1.0f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+	const __m256 maxU = _mm256_set1_ps(w-2), maxV = _mm256_set1_ps(h-2);
+
+	const __m256i widths = _mm256_set1_epi32(w);
+
+	const LeftPackTable& pack = LeftPackTable::get();
+
+	__m256 sxx = zeros, syy = zeros, sx = zeros, sy = zeros, sw = zeros;
+	__m256 usageCount = zeros;
+
+	int idx=0;
+	for(int i=0; i<refNum; i+=8)
+	{
+		__m256 rx = _mm256_load_ps(refPoints.x+i);
+		__m256 ry = _mm256_load_ps(refPoints.y+i);
+		__m256 rz = _mm256_load_ps(refPoints.z+i);
+
+		// Wxp = rotMat * p + transVec
+		__m256 px = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r00,rx), _mm256_mul_ps(r01,ry)), _mm256_add_ps(_mm256_mul_ps(r02,rz), tx));
+		__m256 py = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r10,rx), _mm256_mul_ps(r11,ry)), _mm256_add_ps(_mm256_mul_ps(r12,rz), ty));
+		__m256 pz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r20,rx), _mm256_mul_ps(r21,ry)), _mm256_add_ps(_mm256_mul_ps(r22,rz), tz));
+
+		__m256 u_new = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(px, pz), fx), cx);
+		__m256 v_new = _mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(py, pz), fy), cy);
+
+		// step 1a: coordinates have to be in image (ordered compares exclude NANs),
+		// and the lane has to hold a point, not padding.
+		__m256 valid = _mm256_and_ps(
+				_mm256_and_ps(_mm256_cmp_ps(u_new, ones, _CMP_GT_OQ), _mm256_cmp_ps(v_new, ones, _CMP_GT_OQ)),
+				_mm256_and_ps(_mm256_cmp_ps(u_new, maxU, _CMP_LT_OQ), _mm256_cmp_ps(v_new, maxV, _CMP_LT_OQ)));
+		valid = _mm256_and_ps(valid, laneMask(i, refNum));
+
+		int mask = _mm256_movemask_ps(valid);
+		if(mask == 0) continue;
+
+		// park the other lanes on a pixel inside the image, so all gathers stay in bounds.
+		u_new = _mm256_blendv_ps(twos, u_new, valid);
+		v_new = _mm256_blendv_ps(twos, v_new, valid);
+
+
+		// bilinear interpolation of (dx, dy, I), as getInterpolatedElement43.
+		__m256 interp[3];
+		interpolate43(frame_gradients, u_new, v_new, w, interp);
+
+
+#if USE_ESM_TRACKING == 1
+		// get rotated gradient of point
+		__m256 gradX = _mm256_load_ps(refPoints.gradX+i);
+		__m256 gradY = _mm256_load_ps(refPoints.gradY+i);
+		__m256 rotatedGradX = _mm256_add_ps(_mm256_mul_ps(xRoll0, gradX), _mm256_mul_ps(xRoll1, gradY));
+		__m256 rotatedGradY = _mm256_add_ps(_mm256_mul_ps(yRoll0, gradX), _mm256_mul_ps(yRoll1, gradY));
+
+		__m256 warped_dx = _mm256_mul_ps(_mm256_mul_ps(fx, halfs), _mm256_add_ps(interp[0], rotatedGradX));
+		__m256 warped_dy = _mm256_mul_ps(_mm256_mul_ps(fy, halfs), _mm256_add_ps(interp[1], rotatedGradY));
+#else
+		__m256 warped_dx = _mm256_mul_ps(fx, interp[0]);
+		__m256 warped_dy = _mm256_mul_ps(fy, interp[1]);
+#endif
+
+
+		__m256 c1 = _mm256_add_ps(_mm256_mul_ps(affA, _mm256_load_ps(refPoints.color+i)), affB);
+		__m256 c2 = interp[2];
+		__m256 residual_p = _mm256_sub_ps(c1, c2);
+
+		// weight = |r| < 2 ? 1 : 2 / |r|, zero for dropped lanes.
+		__m256 absRes = _mm256_and_ps(residual_p, absMask);
+		__m256 weight = _mm256_blendv_ps(_mm256_div_ps(twos, absRes), ones, _mm256_cmp_ps(absRes, twos, _CMP_LT_OQ));
+		weight = _mm256_and_ps(weight, valid);
+		sxx = _mm256_add_ps(sxx, _mm256_mul_ps(_mm256_mul_ps(c1, c1), weight));
+		syy = _mm256_add_ps(syy, _mm256_mul_ps(_mm256_mul_ps(c2, c2), weight));
+		sx = _mm256_add_ps(sx, _mm256_mul_ps(c1, weight));
+		sy = _mm256_add_ps(sy, _mm256_mul_ps(c2, weight));
+		sw = _mm256_add_ps(sw, weight);
+
+
+		// new (only for Sim3):
+		__m256i idx_rounded = _mm256_add_epi32(
+				_mm256_cvttps_epi32(_mm256_add_ps(u_new, halfs)),
+				_mm256_mullo_epi32(widths, _mm256_cvttps_epi32(_mm256_add_ps(v_new, halfs))));
+		__m256 var_frameDepth = _mm256_i32gather_ps(frame_idepthVar, idx_rounded, 4);
+		__m256 frameDepth = _mm256_i32gather_ps(frame_idepth, idx_rounded, 4);
+		__m256 ref_idepth = _mm256_div_ps(ones, pz);
+		__m256 hasDepth = _mm256_cmp_ps(var_frameDepth, zeros, _CMP_GT_OQ);
+		__m256 residual_d = _mm256_blendv_ps(minusOnes, _mm256_sub_ps(ref_idepth, frameDepth), hasDepth);
+		__m256 warped_idepthVar = _mm256_blendv_ps(minusOnes, var_frameDepth, hasDepth);
+
+
+		const __m256i perm = pack.perm[mask];
+		leftPackStore(buf_warped_x+idx, px, perm);
+		leftPackStore(buf_warped_y+idx, py, perm);
+		leftPackStore(buf_warped_z+idx, pz, perm);
+		leftPackStore(buf_warped_dx+idx, warped_dx, perm);
+		leftPackStore(buf_warped_dy+idx, warped_dy, perm);
+		leftPackStore(buf_warped_residual+idx, residual_p, perm);
+		leftPackStore(buf_idepthVar+idx, _mm256_load_ps(refPoints.idepthVar+i), perm);
+		leftPackStore(buf_d+idx, _mm256_div_ps(ones, rz), perm);
+		leftPackStore(buf_residual_d+idx, residual_d, perm);
+		leftPackStore(buf_warped_idepthVar+idx, warped_idepthVar, perm);
+		idx += __builtin_popcount(mask);
+
+		__m256 depthChange = _mm256_mul_ps(rz, ref_idepth);
+		usageCount = _mm256_add_ps(usageCount, _mm256_and_ps(_mm256_min_ps(depthChange, ones), valid));
+	}
+	buf_warped_size = idx;
+
+
+	pointUsage = hsum(usageCount) / (float)refNum;
+
+	float sxxs = hsum(sxx), syys = hsum(syy), sxs = hsum(sx), sys = hsum(sy), sws = hsum(sw);
+	affineEstimation_a_lastIt = sqrtf((syys - sys*sys/sws) / (sxxs - sxs*sxs/sws));
+	affineEstimation_b_lastIt = (sys - affineEstimation_a_lastIt*sxs)/sws;
+}
+#endif
+
 #if defined(ENABLE_NEON)
 void Sim3Tracker::calcSim3BuffersNEON(
 		const TrackingReference* reference,
@@ -436,10 +617,15 @@ void Sim3Tracker::calcSim3Buffers(
 	float yRoll1 = rollMat(1, 1);
 
 
-	const Eigen::Vector3f* refPoint_max = reference->posData[level] + reference->numData[level];
-	const Eigen::Vector3f* refPoint = reference->posData[level];
-	const Eigen::Vector2f* refColVar = reference->colorAndVarData[level];
-	const Eigen::Vector2f* refGrad = reference->gradData[level];
+	const TrackingPointCloud& refPoints = reference->points[level];
+	const float* refX = refPoints.x;
+	const float* refY = refPoints.y;
+	const float* refZ = refPoints.z;
+	const float* refColor = refPoints.color;
+	const float* refVar = refPoints.idepthVar;
+	const float* refGradX = refPoints.gradX;
+	const float* refGradY = refPoints.gradY;
+	const int refNum = refPoints.size();
 
 	const float* 			frame_idepth = frame->idepth(level);
 	const float* 			frame_idepthVar = frame->idepthVar(level);
@@ -451,9 +637,9 @@ void Sim3Tracker::calcSim3Buffers(
 	float usageCount = 0;
 
 	int idx=0;
-	for(;refPoint<refPoint_max; refPoint++, refGrad++, refColVar++)
+	for(int i=0; i<refNum; i++)
 	{
-		Eigen::Vector3f Wxp = rotMat * (*refPoint) + transVec;
+		Eigen::Vector3f Wxp = rotMat * Eigen::Vector3f(refX[i], refY[i], refZ[i]) + transVec;
 		float u_new = (Wxp[0]/Wxp[2])*fx_l + cx_l;
 		float v_new = (Wxp[1]/Wxp[2])*fy_l + cy_l;
 
@@ -472,8 +658,8 @@ void Sim3Tracker::calcSim3Buffers(
 		// save values
 #if USE_ESM_TRACKING == 1
 		// get rotated gradient of point
-		float rotatedGradX = xRoll0 * (*refGrad)[0] + xRoll1 * (*refGrad)[1];
-		float rotatedGradY = yRoll0 * (*refGrad)[0] + yRoll1 * (*refGrad)[1];
+		float rotatedGradX = xRoll0 * refGradX[i] + xRoll1 * refGradY[i];
+		float rotatedGradY = yRoll0 * refGradX[i] + yRoll1 * refGradY[i];
 
 		*(buf_warped_dx+idx) = fx_l * 0.5f * (resInterp[0] + rotatedGradX);
 		*(buf_warped_dy+idx) = fy_l * 0.5f * (resInterp[1] + rotatedGradY);
@@ -483,7 +669,7 @@ void Sim3Tracker::calcSim3Buffers(
 #endif
 
 
-		float c1 = affineEstimation_a * (*refColVar)[0] + affineEstimation_b;
+		float c1 = affineEstimation_a * refColor[i] + affineEstimation_b;
 		float c2 = resInterp[2];
 		float residual_p = c1 - c2;
 
@@ -496,14 +682,14 @@ void Sim3Tracker::calcSim3Buffers(
 
 
 		*(buf_warped_residual+idx) = residual_p;
-		*(buf_idepthVar+idx) = (*refColVar)[1];
+		*(buf_idepthVar+idx) = refVar[i];
 
 
 		// new (only for Sim3):
 		int idx_rounded = (int)(u_new+0.5f) + w*(int)(v_new+0.5f);
 		float var_frameDepth = frame_idepthVar[idx_rounded];
 		float ref_idepth = 1.0f / Wxp[2];
-		*(buf_d+idx) = 1.0f / (*refPoint)[2];
+		*(buf_d+idx) = 1.0f / refZ[i];
 		if(var_frameDepth > 0)
 		{
 			float residual_d = ref_idepth - frame_idepth[idx_rounded];
@@ -523,7 +709,7 @@ void Sim3Tracker::calcSim3Buffers(
 			// for debug plot only: find x,y again.
 			// horribly inefficient, but who cares at this point...
 			int width = _imgSize.width;
-			Eigen::Vector3f point = KLvl * (*refPoint);
+			Eigen::Vector3f point = KLvl * Eigen::Vector3f(refX[i], refY[i], refZ[i]);
 			int x = point[0] / point[2] + 0.5f;
 			int y = point[1] / point[2] + 0.5f;
 
@@ -553,13 +739,13 @@ void Sim3Tracker::calcSim3Buffers(
 
 		idx++;
 
-		float depthChange = (*refPoint)[2] / Wxp[2];
+		float depthChange = refZ[i] / Wxp[2];
 		usageCount += depthChange < 1 ? depthChange : 1;
 	}
 	buf_warped_size = idx;
 
 
-	pointUsage = usageCount / (float)reference->numData[level];
+	pointUsage = usageCount / (float)refNum;
 
 	affineEstimation_a_lastIt = sqrtf((syy - sy*sy/sw) / (sxx - sx*sx/sw));
 	affineEstimation_b_lastIt = (sy - affineEstimation_a_lastIt*sx)/sw;
@@ -712,6 +898,107 @@ Sim3ResidualStruct Sim3Tracker::calcSim3WeightsAndResidualSSE(
 }
 #endif
 
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+Sim3ResidualStruct Sim3Tracker::calcSim3WeightsAndResidualAVX(
+		const Sim3& referenceToFrame)
+{
+	// the debug weight images need the per-pixel path.
+	if(plotSim3TrackingIterationInfo)
+		return calcSim3WeightsAndResidual(referenceToFrame);
+
+	const __m256 txs = _mm256_set1_ps((float)(referenceToFrame.translation()[0]));
+	const __m256 tys = _mm256_set1_ps((float)(referenceToFrame.translation()[1]));
+	const __m256 tzs = _mm256_set1_ps((float)(referenceToFrame.translation()[2]));
+
+	const __m256 zeros = _mm256_setzero_ps();
+	const __m256 ones = _mm256_set1_ps(1.0f);
+	const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+	const __m256 depthVarFacs = _mm256_set1_ps((float)settings.var_weight);
+	const __m256 sigma_i2s = _mm256_set1_ps((float)cameraPixelNoise2);
+	const __m256 huber_ress = _mm256_set1_ps((float)(settings.huber_d));
+
+
+	__m256 sumResP = zeros;
+	__m256 sumResD = zeros;
+	__m256 numTermsD = zeros;
+
+
+	Sim3ResidualStruct sumRes;
+	memset(&sumRes, 0, sizeof(Sim3ResidualStruct));
+
+
+	// runs over the padded end of the buffers; lanes past buf_warped_size get zero weight.
+	for(int i=0;i<buf_warped_size;i+=8)
+	{
+		__m256 inRange = laneMask(i, buf_warped_size);
+
+		// calc dw/dd:
+		__m256 pzs = _mm256_load_ps(buf_warped_z+i);	// z'
+		__m256 pz2ds = _mm256_rcp_ps(_mm256_mul_ps(_mm256_mul_ps(pzs, pzs), _mm256_load_ps(buf_d+i)));  // 1 / (z' * z' * d)
+		__m256 g0s = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(pzs, txs), _mm256_mul_ps(_mm256_load_ps(buf_warped_x+i), tzs)), pz2ds);
+		__m256 g1s = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(pzs, tys), _mm256_mul_ps(_mm256_load_ps(buf_warped_y+i), tzs)), pz2ds);
+		__m256 g2s = _mm256_mul_ps(_mm256_sub_ps(pzs, tzs), pz2ds);
+
+		// float drpdd = gx * g0 + gy * g1;	// ommitting the minus
+		__m256 drpdds = _mm256_add_ps(
+				_mm256_mul_ps(g0s, _mm256_load_ps(buf_warped_dx+i)),
+				_mm256_mul_ps(g1s, _mm256_load_ps(buf_warped_dy+i)));
+
+		__m256 ss = _mm256_mul_ps(depthVarFacs, _mm256_load_ps(buf_idepthVar+i));
+		__m256 svs = _mm256_load_ps(buf_warped_idepthVar+i);
+
+		//float w_p = 1.0f / (sigma_i2 + s * drpdd * drpdd);
+		__m256 w_ps = _mm256_rcp_ps(_mm256_add_ps(sigma_i2s, _mm256_mul_ps(drpdds, _mm256_mul_ps(drpdds, ss))));
+
+		//float w_d = 1.0f / (sv + g2*g2*s);
+		__m256 w_ds = _mm256_rcp_ps(_mm256_add_ps(svs, _mm256_mul_ps(g2s, _mm256_mul_ps(g2s, ss))));
+
+		//float weighted_rp = fabs(rp*sqrtf(w_p));
+		__m256 weighted_rps = _mm256_and_ps(absMask, _mm256_mul_ps(_mm256_load_ps(buf_warped_residual+i), _mm256_sqrt_ps(w_ps)));
+
+		//float weighted_rd = fabs(rd*sqrtf(w_d));
+		__m256 weighted_rds = _mm256_and_ps(absMask, _mm256_mul_ps(_mm256_load_ps(buf_residual_d+i), _mm256_sqrt_ps(w_ds)));
+
+		// depthValid = sv > 0
+		__m256 depthValid = _mm256_and_ps(inRange, _mm256_cmp_ps(svs, zeros, _CMP_GT_OQ));
+
+		// float weighted_abs_res = sv > 0 ? weighted_rd+weighted_rp : weighted_rp;
+		__m256 weighted_abs_ress = _mm256_add_ps(_mm256_and_ps(weighted_rds, depthValid), weighted_rps);
+
+		//float wh = fabs(weighted_abs_res < huber_res ? 1 : huber_res / weighted_abs_res);
+		__m256 whs = _mm256_blendv_ps(
+				_mm256_mul_ps(huber_ress, _mm256_rcp_ps(weighted_abs_ress)), ones,
+				_mm256_cmp_ps(weighted_abs_ress, huber_ress, _CMP_LT_OQ));
+		whs = _mm256_and_ps(whs, inRange);
+
+		numTermsD = _mm256_add_ps(numTermsD, _mm256_and_ps(depthValid, ones));
+		sumResD = _mm256_add_ps(sumResD,
+				_mm256_and_ps(depthValid, _mm256_mul_ps(whs, _mm256_mul_ps(weighted_rds, weighted_rds))));
+		sumResP = _mm256_add_ps(sumResP,
+				_mm256_and_ps(inRange, _mm256_mul_ps(whs, _mm256_mul_ps(weighted_rps, weighted_rps))));
+
+		//*(buf_weight_p+i) = wh * w_p;
+		_mm256_store_ps(buf_weight_p+i, _mm256_mul_ps(whs, w_ps));
+
+		//if(sv > 0) *(buf_weight_d+i) = wh * w_d; else *(buf_weight_d+i) = 0;
+		_mm256_store_ps(buf_weight_d+i, _mm256_and_ps(depthValid, _mm256_mul_ps(whs, w_ds)));
+	}
+
+	sumRes.sumResP = hsum(sumResP);
+	sumRes.numTermsP = buf_warped_size;
+
+	sumRes.sumResD = hsum(sumResD);
+	sumRes.numTermsD = hsum(numTermsD);
+
+	sumRes.mean = (sumRes.sumResD + sumRes.sumResP) / (sumRes.numTermsD + sumRes.numTermsP);
+	sumRes.meanD = (sumRes.sumResD) / (sumRes.numTermsD);
+	sumRes.meanP = (sumRes.sumResP) / (sumRes.numTermsP);
+
+	return sumRes;
+}
+#endif
+
 #if defined(ENABLE_NEON)
 Sim3ResidualStruct Sim3Tracker::calcSim3WeightsAndResidualNEON(
 		const Sim3& referenceToFrame)
@@ -932,8 +1219,10 @@ void Sim3Tracker::calcSim3LGSSSE(LGS7 &ls7)
 
 		if(i+3<buf_warped_size)
 		{
-			ls4.updateSSE(J41, J42, J43, J44, _mm_load_ps(buf_residual_d+i), _mm_load_ps(buf_weight_d+i));
-			ls6.updateSSE(J61, J62, J63, J64, J65, J66, _mm_load_ps(buf_warped_residual+i), _mm_load_ps(buf_weight_p+i));
+			const __m128 J4[4] = {J41, J42, J43, J44};
+			const __m128 J6[6] = {J61, J62, J63, J64, J65, J66};
+			ls4.update4(J4, _mm_load_ps(buf_residual_d+i), _mm_load_ps(buf_weight_d+i));
+			ls6.update4(J6, _mm_load_ps(buf_warped_residual+i), _mm_load_ps(buf_weight_p+i));
 		}
 		else
 		{
@@ -958,6 +1247,70 @@ void Sim3Tracker::calcSim3LGSSSE(LGS7 &ls7)
 }
 #endif
 
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+void Sim3Tracker::calcSim3LGSAVX(LGS7 &ls7)
+{
+	LGS4 ls4;
+	LGS6 ls6;
+	ls6.initialize( _imgSize.area() );
+	ls4.initialize( _imgSize.area() );
+
+	const __m256 zeros = _mm256_setzero_ps();
+
+	for(int i=0;i<buf_warped_size;i+=8)
+	{
+		__m256 J4[4];
+		__m256 J6[6];
+
+		__m256 px = _mm256_load_ps(buf_warped_x+i);
+		__m256 py = _mm256_load_ps(buf_warped_y+i);
+		__m256 gx = _mm256_load_ps(buf_warped_dx+i);
+		__m256 gy = _mm256_load_ps(buf_warped_dy+i);
+
+		__m256 z = _mm256_rcp_ps(_mm256_load_ps(buf_warped_z+i));	// 1/z
+		__m256 z_sqr = _mm256_mul_ps(z, z);						// 1/(z*z)
+
+		J4[0] = z_sqr;
+		J4[1] = _mm256_mul_ps(z_sqr, py);
+		J4[2] = _mm256_sub_ps(zeros, _mm256_mul_ps(z_sqr, px));
+		J4[3] = z;
+
+		__m256 pxgx = _mm256_mul_ps(_mm256_mul_ps(px, gx), z_sqr);	// px * z_sqr * gx
+		__m256 pygy = _mm256_mul_ps(_mm256_mul_ps(py, gy), z_sqr);	// py * z_sqr * gy
+
+		J6[0] = _mm256_mul_ps(z, gx);
+		J6[1] = _mm256_mul_ps(z, gy);
+		J6[2] = _mm256_sub_ps(zeros, _mm256_add_ps(pxgx, pygy));
+		J6[3] = _mm256_sub_ps(zeros, _mm256_add_ps(gy, _mm256_add_ps(_mm256_mul_ps(pxgx, py), _mm256_mul_ps(pygy, py))));
+		J6[4] = _mm256_add_ps(gx, _mm256_add_ps(_mm256_mul_ps(pxgx, px), _mm256_mul_ps(pygy, px)));
+		J6[5] = _mm256_mul_ps(_mm256_sub_ps(_mm256_mul_ps(px, gy), _mm256_mul_ps(py, gx)), z);
+
+		if(i+7<buf_warped_size)
+		{
+			ls4.update8(J4, _mm256_load_ps(buf_residual_d+i), _mm256_load_ps(buf_weight_d+i));
+			ls6.update8(J6, _mm256_load_ps(buf_warped_residual+i), _mm256_load_ps(buf_weight_p+i));
+		}
+		else
+		{
+			for(int k=0;i+k<buf_warped_size;k++)
+			{
+				Vector6 v6;
+				v6 << SSEE(J6[0],k),SSEE(J6[1],k),SSEE(J6[2],k),SSEE(J6[3],k),SSEE(J6[4],k),SSEE(J6[5],k);
+				Vector4 v4;
+				v4 << SSEE(J4[0],k),SSEE(J4[1],k),SSEE(J4[2],k),SSEE(J4[3],k);
+
+				ls4.update(v4, *(buf_residual_d+i+k), *(buf_weight_d+i+k));
+				ls6.update(v6, *(buf_warped_residual+i+k), *(buf_weight_p+i+k));
+			}
+		}
+	}
+
+	ls4.finishNoDivide();
+	ls6.finishNoDivide();
+	ls7.initializeFrom(ls6, ls4);
+}
+#endif
+
 #if defined(ENABLE_NEON)
 void Sim3Tracker::calcSim3LGSNEON(LGS7 &ls7)
 {
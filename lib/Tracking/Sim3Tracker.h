@@ -89,6 +89,8 @@ public:
 	cv::Mat debugImageWeightedResD;
 
 
+	// all buffers are FRAME_MEMORY_ALIGNMENT aligned and have
+	// TRACKING_POINTS_PADDING floats of slack behind the image area.
 	float* buf_warped_residual;
 	float* buf_warped_weights;
 	float* buf_warped_dx;
@@ -154,6 +156,14 @@ private:
 			int level,
 			bool plotWeights = false);
 #endif
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+	void calcSim3BuffersAVX(
+			const TrackingReference* reference,
+			Frame* frame,
+			const Sim3& referenceToFrame,
+			int level,
+			bool plotWeights = false);
+#endif
 #if defined(ENABLE_NEON)
 	void calcSim3BuffersNEON(
 			const TrackingReference* reference,
@@ -174,6 +184,10 @@ private:
 	Sim3ResidualStruct calcSim3WeightsAndResidualSSE(
 			const Sim3& referenceToFrame);
 #endif
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+	Sim3ResidualStruct calcSim3WeightsAndResidualAVX(
+			const Sim3& referenceToFrame);
+#endif
 #if defined(ENABLE_NEON)
 	Sim3ResidualStruct calcSim3WeightsAndResidualNEON(
 			const Sim3& referenceToFrame);
@@ -185,6 +199,9 @@ private:
 #if defined(ENABLE_SSE)
 	void calcSim3LGSSSE(LGS7 &ls7);
 #endif
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+	void calcSim3LGSAVX(LGS7 &ls7);
+#endif
 #if defined(ENABLE_NEON)
 	void calcSim3LGSNEON(LGS7 &ls7);
 #endif
@@ -0,0 +1,123 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Tracking/TrackingPointCloud.h"
+#include "DataStructures/FrameMemory.h"
+
+#include <assert.h>
+#include <string.h>
+
+namespace lsd_slam
+{
+
+
+TrackingPointCloud::TrackingPointCloud()
+	: num(0), cap(0)
+{
+	setPlanes(nullptr);
+}
+
+TrackingPointCloud::~TrackingPointCloud()
+{
+	release();
+}
+
+void TrackingPointCloud::setPlanes(float* block)
+{
+	if(block == nullptr)
+	{
+		x = y = z = color = idepthVar = gradX = gradY = nullptr;
+		pixelIdx = nullptr;
+		return;
+	}
+
+	x = block;
+	y = block + cap;
+	z = block + 2*cap;
+	color = block + 3*cap;
+	idepthVar = block + 4*cap;
+	gradX = block + 5*cap;
+	gradY = block + 6*cap;
+	pixelIdx = reinterpret_cast<int*>(block + 7*cap);
+}
+
+void TrackingPointCloud::reserve(int n)
+{
+	n = padded(n);
+	if(n <= cap) return;
+
+	release();
+
+	cap = n;
+	setPlanes(FrameMemory::getInstance().getFloatBuffer(numPlanes * cap));
+}
+
+void TrackingPointCloud::release()
+{
+	if(x != nullptr)
+		FrameMemory::getInstance().returnBuffer(x);
+
+	num = cap = 0;
+	setPlanes(nullptr);
+}
+
+void TrackingPointCloud::setSize(int n)
+{
+	assert(n <= cap);
+	num = n;
+
+	int pad = padded(n) - n;
+	if(pad == 0) return;
+
+	memset(x + n, 0, sizeof(float) * pad);
+	memset(y + n, 0, sizeof(float) * pad);
+	memset(color + n, 0, sizeof(float) * pad);
+	memset(idepthVar + n, 0, sizeof(float) * pad);
+	memset(gradX + n, 0, sizeof(float) * pad);
+	memset(gradY + n, 0, sizeof(float) * pad);
+	memset(pixelIdx + n, 0, sizeof(int) * pad);
+	for(int i=n; i<n+pad; i++)
+		z[i] = 1;
+}
+
+void TrackingPointCloud::copyFrom(const TrackingPointCloud& other)
+{
+	if(other.capacity() == 0)
+	{
+		num = 0;
+		return;
+	}
+
+	// keep the source capacity, so FrameMemory can recycle blocks of one size.
+	reserve(other.capacity());
+
+	int n = other.paddedSize();
+	memcpy(x, other.x, sizeof(float) * n);
+	memcpy(y, other.y, sizeof(float) * n);
+	memcpy(z, other.z, sizeof(float) * n);
+	memcpy(color, other.color, sizeof(float) * n);
+	memcpy(idepthVar, other.idepthVar, sizeof(float) * n);
+	memcpy(gradX, other.gradX, sizeof(float) * n);
+	memcpy(gradY, other.gradY, sizeof(float) * n);
+	memcpy(pixelIdx, other.pixelIdx, sizeof(int) * n);
+	num = other.size();
+}
+
+}
@@ -0,0 +1,89 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+namespace lsd_slam
+{
+
+// number of floats the point planes are padded to. 8 = one AVX register.
+#define TRACKING_POINTS_PADDING 8
+
+/**
+ * Structure-of-arrays point storage consumed by the tracking kernels.
+ *
+ * All channels live in one block taken from FrameMemory (hence aligned to
+ * FRAME_MEMORY_ALIGNMENT), one plane after the other. Every plane is
+ * capacity() long, which is a multiple of TRACKING_POINTS_PADDING, so vector
+ * loops may load full registers past size(). Entries in [size(), padded end)
+ * are zeroed, with z = 1 to keep reciprocals finite.
+ */
+class TrackingPointCloud
+{
+public:
+	TrackingPointCloud();
+	~TrackingPointCloud();
+
+	TrackingPointCloud(const TrackingPointCloud&) = delete;
+	TrackingPointCloud& operator=(const TrackingPointCloud&) = delete;
+
+	/** Makes room for at least n points. Drops the content if it has to re-allocate. */
+	void reserve(int n);
+
+	/** Returns the storage to FrameMemory. */
+	void release();
+
+	/** Sets the number of valid points and clears the padding behind them. */
+	void setSize(int n);
+
+	/** Copies the first other.size() points (and the padding) of other. */
+	void copyFrom(const TrackingPointCloud& other);
+
+	inline int size() const { return num; }
+	inline int capacity() const { return cap; }
+	inline int paddedSize() const { return padded(num); }
+
+	/** Bytes of FrameMemory held by this cloud. */
+	inline int memorySize() const { return numPlanes * cap * sizeof(float); }
+
+	static inline int padded(int n)
+	{
+		return (n + TRACKING_POINTS_PADDING - 1) & ~(TRACKING_POINTS_PADDING - 1);
+	}
+
+	float* x;	// position in the reference camera frame
+	float* y;
+	float* z;
+	float* color;	// I
+	float* idepthVar;	// Var
+	float* gradX;	// dx
+	float* gradY;	// dy
+	int* pixelIdx;	// x + y*width
+
+private:
+	static const int numPlanes = 8;
+
+	void setPlanes(float* block);
+
+	int num;
+	int cap;
+};
+
+}
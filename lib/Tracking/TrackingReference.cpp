@@ -25,6 +25,9 @@
 #include "util/globalFuncs.h"
 #include "IOWrapper/ImageDisplay.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace lsd_slam
 {
 
@@ -33,24 +36,16 @@ TrackingReference::TrackingReference()
 	: keyframe( nullptr )
 {
 	frameID=-1;
+	depthVersion=-1;
 	wh_allocated = 0;
 	for (int level = 0; level < PYRAMID_LEVELS; ++ level)
-	{
-		posData[level] = nullptr;
-		gradData[level] = nullptr;
-		colorAndVarData[level] = nullptr;
-		pointPosInXYGrid[level] = nullptr;
 		numData[level] = 0;
-	}
 }
 void TrackingReference::releaseAll()
 {
 	for (int level = 0; level < PYRAMID_LEVELS; ++ level)
 	{
-		if(posData[level] != nullptr) delete[] posData[level];
-		if(gradData[level] != nullptr) delete[] gradData[level];
-		if(colorAndVarData[level] != nullptr) delete[] colorAndVarData[level];
-		if(pointPosInXYGrid[level] != nullptr) delete[] pointPosInXYGrid[level];
+		points[level].release();
 		numData[level] = 0;
 	}
 	wh_allocated = 0;
@@ -58,7 +53,10 @@ void TrackingReference::releaseAll()
 void TrackingReference::clearAll()
 {
 	for (int level = 0; level < PYRAMID_LEVELS; ++ level)
+	{
+		points[level].setSize(0);
 		numData[level] = 0;
+	}
 }
 TrackingReference::~TrackingReference()
 {
@@ -75,6 +73,7 @@ void TrackingReference::importFrame(const Frame::SharedPtr &sourceKF)
 
 	keyframe = sourceKF;
 	frameID = keyframe->id();
+	depthVersion = keyframe->depthVersion;
 
 
 	// reset allocation if dimensions differ (shouldnt happen usually)
@@ -90,11 +89,33 @@ void TrackingReference::importFrame(const Frame::SharedPtr &sourceKF)
 
 void TrackingReference::invalidate()
 {
-	if( (bool)keyframe ) keyframeLock.unlock();
+	if( (bool)keyframe && keyframeLock.owns_lock() ) keyframeLock.unlock();
 
 	keyframe.reset();
 }
 
+void TrackingReference::unlockKeyframe()
+{
+	boost::unique_lock<boost::mutex> lock(accessMutex);
+	if(keyframeLock.owns_lock()) keyframeLock.unlock();
+}
+
+void TrackingReference::relockKeyframe()
+{
+	assert(keyframe != 0);
+	boost::unique_lock<boost::mutex> lock(accessMutex);
+	if(!keyframeLock.owns_lock()) keyframeLock = keyframe->getActiveLock();
+}
+
+int TrackingReference::memorySize()
+{
+	boost::unique_lock<boost::mutex> lock(accessMutex);
+	int size = 0;
+	for (int level = 0; level < PYRAMID_LEVELS; ++ level)
+		size += points[level].memorySize();
+	return size;
+}
+
 void TrackingReference::makePointCloud(int level)
 {
 	assert(keyframe != 0);
@@ -116,37 +137,103 @@ void TrackingReference::makePointCloud(int level)
 	const float* pyrColorSource = keyframe->image(level);
 	const Eigen::Vector4f* pyrGradSource = keyframe->gradients(level);
 
-	if(posData[level] == nullptr) posData[level] = new Eigen::Vector3f[w*h];
-	if(pointPosInXYGrid[level] == nullptr) pointPosInXYGrid[level] = new int[w*h];
-	if(gradData[level] == nullptr) gradData[level] = new Eigen::Vector2f[w*h];
-	if(colorAndVarData[level] == nullptr) colorAndVarData[level] = new Eigen::Vector2f[w*h];
-
-	Eigen::Vector3f* posDataPT = posData[level];
-	int* idxPT = pointPosInXYGrid[level];
-	Eigen::Vector2f* gradDataPT = gradData[level];
-	Eigen::Vector2f* colorAndVarDataPT = colorAndVarData[level];
+	TrackingPointCloud& pc = points[level];
+	pc.reserve(w*h);
 
-	for(int x=1; x<w-1; x++) {
-		for(int y=1; y<h-1; y++) {
+	// walk the source planes row by row, so all reads are sequential.
+	int num = 0;
+	for(int y=1; y<h-1; y++)
+	{
+		const float pyLevel = fyInvLevel*y+cyInvLevel;
+		for(int x=1; x<w-1; x++)
+		{
 			int idx = x + y*w;
 
 			if(pyrIdepthVarSource[idx] <= 0 || pyrIdepthSource[idx] == 0) continue;
 
-			*posDataPT = (1.0f / pyrIdepthSource[idx]) * Eigen::Vector3f(fxInvLevel*x+cxInvLevel,fyInvLevel*y+cyInvLevel,1);
-			*gradDataPT = pyrGradSource[idx].head<2>();
-			*colorAndVarDataPT = Eigen::Vector2f(pyrColorSource[idx], pyrIdepthVarSource[idx]);
-			*idxPT = idx;
-
-			posDataPT++;
-			gradDataPT++;
-			colorAndVarDataPT++;
-			idxPT++;
+			float depth = 1.0f / pyrIdepthSource[idx];
+			pc.x[num] = depth * (fxInvLevel*x+cxInvLevel);
+			pc.y[num] = depth * pyLevel;
+			pc.z[num] = depth;
+			pc.color[num] = pyrColorSource[idx];
+			pc.idepthVar[num] = pyrIdepthVarSource[idx];
+			pc.gradX[num] = pyrGradSource[idx][0];
+			pc.gradY[num] = pyrGradSource[idx][1];
+			pc.pixelIdx[num] = idx;
+			num++;
 		}
 	}
 
-	numData[level] = posDataPT - posData[level];
+	pc.setSize(num);
+	selectPoints(level, w);
+	numData[level] = pc.size();
 	LOG(INFO) << "Keyframe " << frameID << " has " << numData[level] << " tracked points at level " << level;
 }
 
 
+
+// Keeps the trackingPointBudget[level] most informative points of the level.
+// Points are scored by squared gradient over relative inverse depth variance,
+// ranked within their grid cell, and taken rank by rank over all cells, so
+// the budget is spread over the image instead of piling up on strong edges.
+void TrackingReference::selectPoints(int level, int width)
+{
+	TrackingPointCloud& pc = points[level];
+	const int budget = trackingPointBudget[level];
+	const int num = pc.size();
+	if(budget <= 0 || num <= budget)
+		return;
+
+	const int cellsX = (width + TRACKING_POINT_GRID_CELL - 1) / TRACKING_POINT_GRID_CELL;
+
+	std::vector<float> score(num);
+	std::vector<int> cell(num);
+	std::vector<int> rank(num);
+	std::vector<int> order(num);
+	for(int i=0; i<num; i++)
+	{
+		float grad2 = pc.gradX[i]*pc.gradX[i] + pc.gradY[i]*pc.gradY[i];
+		score[i] = grad2 / (pc.idepthVar[i] * pc.z[i] * pc.z[i]);	// var / idepth^2
+
+		int x = pc.pixelIdx[i] % width;
+		int y = pc.pixelIdx[i] / width;
+		cell[i] = x / TRACKING_POINT_GRID_CELL + (y / TRACKING_POINT_GRID_CELL) * cellsX;
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&](int a, int b) {
+		return cell[a] != cell[b] ? cell[a] < cell[b] : score[a] > score[b];
+	});
+	for(int i=0; i<num; i++)
+		rank[order[i]] = (i > 0 && cell[order[i]] == cell[order[i-1]]) ? rank[order[i-1]] + 1 : 0;
+
+	std::nth_element(order.begin(), order.begin() + budget, order.end(), [&](int a, int b) {
+		return rank[a] != rank[b] ? rank[a] < rank[b] : score[a] > score[b];
+	});
+
+	std::vector<bool> keep(num, false);
+	for(int i=0; i<budget; i++)
+		keep[order[i]] = true;
+
+	// compact in place, keeping the row-major order.
+	int n = 0;
+	for(int i=0; i<num; i++)
+	{
+		if(!keep[i]) continue;
+		pc.x[n] = pc.x[i];
+		pc.y[n] = pc.y[i];
+		pc.z[n] = pc.z[i];
+		pc.color[n] = pc.color[i];
+		pc.idepthVar[n] = pc.idepthVar[i];
+		pc.gradX[n] = pc.gradX[i];
+		pc.gradY[n] = pc.gradY[i];
+		pc.pixelIdx[n] = pc.pixelIdx[i];
+		n++;
+	}
+	pc.setSize(n);
+
+	LOGF_IF(DEBUG, enablePrintDebugInfo && printTrackingIterationInfo,
+			"Keyframe %d: kept %d of %d points at level %d", frameID, n, num, level);
+}
+
 }
@@ -25,6 +25,7 @@
 #include <boost/thread/shared_mutex.hpp>
 
 #include "DataStructures/Frame.h"
+#include "Tracking/TrackingPointCloud.h"
 
 namespace lsd_slam
 {
@@ -57,19 +58,29 @@ public:
 	Frame::SharedPtr keyframe;
 	boost::shared_lock<boost::shared_mutex> keyframeLock;
 	int frameID;
+	int depthVersion;	// keyframe->depthVersion at importFrame()
 
 	void makePointCloud(int level);
 	void clearAll();
 	void invalidate();
-	Eigen::Vector3f* posData[PYRAMID_LEVELS];	// (x,y,z)
-	Eigen::Vector2f* gradData[PYRAMID_LEVELS];	// (dx, dy)
-	Eigen::Vector2f* colorAndVarData[PYRAMID_LEVELS];	// (I, Var)
-	int* pointPosInXYGrid[PYRAMID_LEVELS];	// x + y*width
+
+	/** Releases the active lock on keyframe but keeps keyframe and the point
+	  * clouds, so the frame can be minimized while the reference is parked. */
+	void unlockKeyframe();
+	/** Re-takes the lock released by unlockKeyframe(). */
+	void relockKeyframe();
+
+	/** Bytes of FrameMemory held by the point clouds. */
+	int memorySize();
+
+	// (x,y,z), (I, Var), (dx, dy) and x + y*width, stored row-major as SoA.
+	TrackingPointCloud points[PYRAMID_LEVELS];
 	int numData[PYRAMID_LEVELS];
 
 private:
 	int wh_allocated;
 	boost::mutex accessMutex;
 	void releaseAll();
+	void selectPoints(int level, int width);
 };
 }
@@ -0,0 +1,148 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Tracking/TrackingReferenceCache.h"
+#include "Tracking/TrackingReference.h"
+
+namespace lsd_slam
+{
+
+
+TrackingReferenceCache::TrackingReferenceCache()
+	: _hits(0), _misses(0)
+{
+}
+
+TrackingReferenceCache::~TrackingReferenceCache()
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	for(Entry &e : entries)
+		delete e.reference;
+}
+
+TrackingReference* TrackingReferenceCache::acquire( const Frame::SharedPtr &keyframe )
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+
+	auto found = idToEntry.find(keyframe->id());
+	if(found != idToEntry.end())
+	{
+		Entry &e = *found->second;
+
+		// in use by someone else: hand out a private, uncached one.
+		if(e.inUse)
+		{
+			_misses++;
+			lock.unlock();
+			TrackingReference* reference = new TrackingReference();
+			reference->importFrame(keyframe);
+			return reference;
+		}
+
+		entries.splice(entries.begin(), entries, found->second);
+		e.inUse = true;
+
+		if(e.reference->depthVersion == keyframe->depthVersion)
+		{
+			_hits++;
+			lock.unlock();
+			e.reference->relockKeyframe();
+		}
+		else
+		{
+			_misses++;
+			lock.unlock();
+			e.reference->importFrame(keyframe);
+		}
+		return e.reference;
+	}
+
+	_misses++;
+	shrinkLocked(trackingReferenceCacheSize - 1);
+
+	entries.push_front(Entry());
+	entries.front().reference = new TrackingReference();
+	entries.front().inUse = true;
+	idToEntry[keyframe->id()] = entries.begin();
+
+	TrackingReference* reference = entries.front().reference;
+	lock.unlock();
+
+	reference->importFrame(keyframe);
+	return reference;
+}
+
+void TrackingReferenceCache::release( TrackingReference* reference )
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+
+	auto found = idToEntry.find(reference->frameID);
+	if(found == idToEntry.end() || found->second->reference != reference)
+	{
+		lock.unlock();
+		delete reference;
+		return;
+	}
+
+	reference->unlockKeyframe();
+	found->second->inUse = false;
+
+	shrinkLocked(trackingReferenceCacheSize);
+}
+
+void TrackingReferenceCache::clear()
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	shrinkLocked(0);
+}
+
+int TrackingReferenceCache::size()
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	return entries.size();
+}
+
+int TrackingReferenceCache::memorySize()
+{
+	boost::unique_lock<boost::mutex> lock(mutex);
+	int size = 0;
+	for(Entry &e : entries)
+		size += e.reference->memorySize();
+	return size;
+}
+
+void TrackingReferenceCache::shrinkLocked( int maxEntries )
+{
+	auto it = entries.end();
+	while(it != entries.begin())
+	{
+		--it;
+		if((int)entries.size() <= maxEntries && !FrameMemory::getInstance().overBudget())
+			return;
+		if(it->inUse)
+			continue;
+
+		idToEntry.erase(it->reference->frameID);
+		delete it->reference;
+		it = entries.erase(it);
+	}
+}
+
+}
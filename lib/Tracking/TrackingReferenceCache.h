@@ -0,0 +1,87 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+
+#include "DataStructures/Frame.h"
+
+namespace lsd_slam
+{
+
+class TrackingReference;
+
+/**
+ * LRU cache of keyframe TrackingReferences, so the point clouds of keyframes
+ * that are tracked against again and again are only built once.
+ *
+ * Entries are keyed by frame id and are rebuilt if the keyframe's
+ * depthVersion changed. Parked entries do not hold the keyframe's active
+ * lock. At most trackingReferenceCacheSize entries are kept, fewer while
+ * FrameMemory is over budget.
+ *
+ * Thread-safe.
+ */
+class TrackingReferenceCache
+{
+public:
+	TrackingReferenceCache();
+	~TrackingReferenceCache();
+
+	/** Returns a reference of keyframe, ready to track on, with keyframe
+	  * locked active. Must be handed back with release(). */
+	TrackingReference* acquire( const Frame::SharedPtr &keyframe );
+	void release( TrackingReference* reference );
+
+	/** Drops all entries that are not in use. */
+	void clear();
+
+	int hits() const { return _hits; }
+	int misses() const { return _misses; }
+	float hitRate() const
+	{
+		const int hits = _hits, misses = _misses;
+		return hits + misses > 0 ? hits / (float)(hits + misses) : 0;
+	}
+	int size();
+	int memorySize();
+
+private:
+	struct Entry
+	{
+		TrackingReference* reference;
+		bool inUse;
+	};
+
+	// drops unused entries, least recently used first, while over the limits.
+	void shrinkLocked( int maxEntries );
+
+	boost::mutex mutex;
+	std::list<Entry> entries;	// most recently used first
+	std::unordered_map<int, std::list<Entry>::iterator> idToEntry;
+
+	std::atomic<int> _hits;
+	std::atomic<int> _misses;
+};
+
+}
@@ -0,0 +1,112 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+// Small building blocks shared by the AVX2 tracking kernels.
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace lsd_slam
+{
+
+inline float hsum(const __m256& v)
+{
+	__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+	s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+	s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+	return _mm_cvtss_f32(s);
+}
+
+// mask of the lanes of the 8-block starting at i that lie below num.
+inline __m256 laneMask(int i, int num)
+{
+	return _mm256_castsi256_ps(_mm256_cmpgt_epi32(
+			_mm256_set1_epi32(num),
+			_mm256_add_epi32(_mm256_set1_epi32(i), _mm256_setr_epi32(0,1,2,3,4,5,6,7))));
+}
+
+// 8-lane getInterpolatedElement43: bilinear (dx, dy, I) at (u, v) from a
+// width-wide Eigen::Vector4f gradient image, passed as float*. All lanes
+// have to lie inside the image.
+inline void interpolate43(const float* gradients, const __m256& u, const __m256& v, int width, __m256* out)
+{
+	const __m256 ones = _mm256_set1_ps(1.0f);
+
+	__m256i ix = _mm256_cvttps_epi32(u);
+	__m256i iy = _mm256_cvttps_epi32(v);
+	__m256 dx = _mm256_sub_ps(u, _mm256_cvtepi32_ps(ix));
+	__m256 dy = _mm256_sub_ps(v, _mm256_cvtepi32_ps(iy));
+	__m256 dxdy = _mm256_mul_ps(dx, dy);
+	__m256 w11 = dxdy;
+	__m256 w01 = _mm256_sub_ps(dy, dxdy);
+	__m256 w10 = _mm256_sub_ps(dx, dxdy);
+	__m256 w00 = _mm256_add_ps(_mm256_sub_ps(_mm256_sub_ps(ones, dx), dy), dxdy);
+
+	__m256i bp00 = _mm256_slli_epi32(_mm256_add_epi32(ix, _mm256_mullo_epi32(iy, _mm256_set1_epi32(width))), 2);
+	__m256i bp10 = _mm256_add_epi32(bp00, _mm256_set1_epi32(4));
+	__m256i bp01 = _mm256_add_epi32(bp00, _mm256_set1_epi32(4*width));
+	__m256i bp11 = _mm256_add_epi32(bp01, _mm256_set1_epi32(4));
+
+	for(int c=0;c<3;c++)
+	{
+		const float* base = gradients + c;
+		out[c] = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(w11, _mm256_i32gather_ps(base, bp11, 4)),
+							  _mm256_mul_ps(w01, _mm256_i32gather_ps(base, bp01, 4))),
+				_mm256_add_ps(_mm256_mul_ps(w10, _mm256_i32gather_ps(base, bp10, 4)),
+							  _mm256_mul_ps(w00, _mm256_i32gather_ps(base, bp00, 4))));
+	}
+}
+
+// _mm256_permutevar8x32_ps indices moving the lanes set in an 8 bit mask to the front.
+struct LeftPackTable
+{
+	__m256i perm[256];
+
+	LeftPackTable()
+	{
+		for(int m=0;m<256;m++)
+		{
+			int lanes[8] = {0,0,0,0,0,0,0,0};
+			int n = 0;
+			for(int l=0;l<8;l++)
+				if(m & (1<<l)) lanes[n++] = l;
+			perm[m] = _mm256_setr_epi32(lanes[0],lanes[1],lanes[2],lanes[3],lanes[4],lanes[5],lanes[6],lanes[7]);
+		}
+	}
+
+	static const LeftPackTable& get()
+	{
+		static const LeftPackTable table;
+		return table;
+	}
+};
+
+// writes the selected lanes of v contiguously to dst. Always stores 8 floats.
+inline void leftPackStore(float* dst, const __m256& v, const __m256i& perm)
+{
+	_mm256_storeu_ps(dst, _mm256_permutevar8x32_ps(v, perm));
+}
+
+}
+
+#endif
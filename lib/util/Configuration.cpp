@@ -4,6 +4,16 @@ namespace lsd_slam {
 
   Configuration::Configuration() :
       doDepth( NO_STEREO ),
+      mappingQueuePolicy( MAPPING_QUEUE_BEST_BASELINE ),
+      mappingQueueSize( 50 ),
+      offlinePipelined( false ),
+      adaptiveLoadShedding( false ),
+      loadSheddingMaxLagMs( 500 ),
+      ingestThreads( 2 ),
+      ingestQueueDepth( 8 ),
+      ingestPrebuildPyramids( true ),
+      undistortThreads( 1 ),
+      asyncOutput( true ),
       stopOnFailedRead( true ),
       SLAMEnabled( true ),
       doKFReActivation( true ),
@@ -17,8 +27,11 @@ namespace lsd_slam {
 
       onSceenInfoDisplay( true ),
       displayDepthMap( true ),
+      depthMapDisplayHz( 10 ),
       dumpMap( false ),
-      doFullReConstraintTrack( false )
+      doFullReConstraintTrack( false ),
+      trackingTimeBudgetMs( 0 ),
+      trackingPointBudget( 0 )
   {;}
 
 }
@@ -33,6 +33,40 @@ public:
 
   enum { NO_STEREO = 0, STEREO_ZED } doDepth;
 
+  // what to do when tracking runs ahead of mapping by more than
+  // mappingQueueSize frames: stall tracking, drop the oldest queued frames,
+  // or drop the queued frames with the smallest baseline to their keyframe.
+  enum MappingQueuePolicy { MAPPING_QUEUE_BLOCK = 0, MAPPING_QUEUE_DROP_OLDEST, MAPPING_QUEUE_BEST_BASELINE } mappingQueuePolicy;
+  int mappingQueueSize;
+
+  // for offline input (fps == 0): map frame N while tracking frame N+1,
+  // instead of tracking and mapping taking turns.  Results are the same
+  // from run to run, but not identical to the non-pipelined mode: the frame
+  // after each new keyframe is tracked on the previous keyframe and isn't
+  // mapped.
+  bool offlinePipelined;
+
+  // lower mapping / tracking quality while mapping lags behind tracking
+  // by more than half the queue or loadSheddingMaxLagMs (see LoadController).
+  // Off by default.
+  bool adaptiveLoadShedding;
+  float loadSheddingMaxLagMs;
+
+  // input images are read, undistorted and turned into Frames (optionally
+  // with their tracking pyramids built) by ingestThreads worker threads,
+  // up to ingestQueueDepth frames ahead of tracking (see IngestPipeline).
+  int ingestThreads;
+  int ingestQueueDepth;
+  bool ingestPrebuildPyramids;
+
+  // rows of each frame undistorted through an UndistortMap are split over
+  // this many threads (for large input, e.g. HD1080 with few ingest threads).
+  int undistortThreads;
+
+  // publish to the Output3DWrapper from its own thread, coalescing what a
+  // slow receiver can't keep up with (see AsyncOutput3DWrapper).
+  bool asyncOutput;
+
   bool stopOnFailedRead;
   bool SLAMEnabled;
   bool doKFReActivation;
@@ -45,10 +79,20 @@ public:
  bool autoRunWithinFrame;
  int  debugDisplay;
  bool displayDepthMap;
+ float depthMapDisplayHz;		// max. rate of depth map renderings, 0 = after every update
  bool onSceenInfoDisplay;
  bool dumpMap;
  bool doFullReConstraintTrack;
 
+ // per-frame time budget (ms) for odometry tracking, 0 = unlimited.
+ // When exceeded, the tracker stops refining and skips the finer levels.
+ float trackingTimeBudgetMs;
+
+ // max. number of points a TrackingReference keeps on the finest tracked
+ // level (SE3TRACKING_MIN_LEVEL), a quarter of it per coarser level;
+ // 0 = all. Sets trackingPointBudget[] when the SlamSystem is created.
+ int trackingPointBudget;
+
 
 protected:
 
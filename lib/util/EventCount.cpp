@@ -0,0 +1,96 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/EventCount.h"
+
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace lsd_slam
+{
+
+#ifdef __linux__
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32bit word");
+
+bool EventCount::wait(uint32_t key, int timeoutMs)
+{
+	struct timespec timeout;
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+	bool notified = true;
+	while(epoch.load() == key)
+	{
+		struct timespec *timeoutPtr = nullptr;
+		if(timeoutMs >= 0)
+		{
+			long remainingNs = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if(remainingNs <= 0) { notified = false; break; }
+			timeout.tv_sec = remainingNs / 1000000000;
+			timeout.tv_nsec = remainingNs % 1000000000;
+			timeoutPtr = &timeout;
+		}
+
+		// returns immediately if the epoch moved on since key was read.
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAIT_PRIVATE, key, timeoutPtr, nullptr, 0);
+	}
+
+	waiters.fetch_sub(1);
+	return notified;
+}
+
+void EventCount::wake()
+{
+	syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+#else
+
+bool EventCount::wait(uint32_t key, int timeoutMs)
+{
+	bool notified = true;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if(timeoutMs < 0)
+			signal.wait(lock, [&]{ return epoch.load() != key; });
+		else
+			notified = signal.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&]{ return epoch.load() != key; });
+	}
+
+	waiters.fetch_sub(1);
+	return notified;
+}
+
+void EventCount::wake()
+{
+	// taking the lock orders the epoch change before a waiter's check.
+	{ std::lock_guard<std::mutex> lock(mutex); }
+	signal.notify_all();
+}
+
+#endif
+
+}
@@ -0,0 +1,87 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <stdint.h>
+
+namespace lsd_slam
+{
+
+/**
+ * Lets a consumer sleep until a lock-free producer signals new data,
+ * without the producer taking a lock when nobody is waiting.
+ *
+ * Consumer:
+ *   uint32_t key = ec.prepareWait();
+ *   if(haveData()) ec.cancelWait(); else ec.wait(key);
+ * Producer:
+ *   publish data; ec.notifyAll();
+ *
+ * On Linux, waiting is a futex on the epoch counter; elsewhere a
+ * mutex / condition variable pair that is only touched by waiters and by
+ * notifications that have a waiter to wake.
+ */
+class EventCount
+{
+public:
+	EventCount() : epoch(0), waiters(0) {}
+
+	uint32_t prepareWait()
+	{
+		waiters.fetch_add(1);
+		return epoch.load();
+	}
+
+	void cancelWait()
+	{
+		waiters.fetch_sub(1);
+	}
+
+	/** Blocks until notifyAll() is called after prepareWait() returned key,
+	 *  or timeoutMs (if >= 0) passes. Returns false on timeout. */
+	bool wait(uint32_t key, int timeoutMs = -1);
+
+	void notifyAll()
+	{
+		// pairs with the fetch_add in prepareWait().
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if(waiters.load(std::memory_order_relaxed) == 0) return;
+
+		epoch.fetch_add(1);
+		wake();
+	}
+
+private:
+	void wake();
+
+	std::atomic<uint32_t> epoch;
+	std::atomic<int> waiters;
+
+#ifndef __linux__
+	std::mutex mutex;
+	std::condition_variable signal;
+#endif
+};
+
+}
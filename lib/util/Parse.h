@@ -27,6 +27,12 @@ class Parse
             return index - 1;
         }
 
+        // true if the flag (an argument without value) is given.
+        static bool flag(int argc, char** argv, const char* str)
+        {
+            return findArg(argc, argv, str) > 0;
+        }
+
     private:
         Parse() {}
 
@@ -0,0 +1,240 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <stddef.h>
+
+#include "util/EventCount.h"
+
+namespace lsd_slam
+{
+
+/**
+ * Fixed-capacity lock-free FIFO for handing objects to one consumer thread.
+ *
+ * Slots are allocated once, up front. push() never blocks and never
+ * allocates: if the buffer is full the object is dropped and counted.
+ * pop() swaps the front object into the caller's instance, so a consumer
+ * that keeps reusing the same instance hands its old buffers (e.g. the
+ * data of a cv::Mat) back to the ring, and a producer using pushWith() can
+ * fill them in place without allocating.
+ *
+ * With MultiProducer = false only one thread may push; otherwise any
+ * number may. There must only ever be one consumer.
+ */
+template< typename T, bool MultiProducer = false >
+class RingBuffer
+{
+public:
+	/** Creates a buffer holding at least capacity objects (rounded up to a
+	 *  power of two). */
+	explicit RingBuffer(size_t capacity)
+		: _capacity(roundUp(capacity)),
+		  slots(new Slot[_capacity]),
+		  tail(0),
+		  head(0),
+		  _pushed(0),
+		  _dropped(0),
+		  _highWater(0)
+	{
+		for(size_t i=0;i<_capacity;i++)
+			slots[i].seq.store(i, std::memory_order_relaxed);
+	}
+
+	//=== producer(s) ===
+
+	bool push(const T &object)
+	{ return pushWith([&](T &slot) { slot = object; }); }
+
+	bool push(T &&object)
+	{ return pushWith([&](T &slot) { slot = std::move(object); }); }
+
+	/** Calls fill(T&) on a free slot and publishes it, or returns false if
+	 *  the buffer is full. The slot holds whatever a consumer swapped into
+	 *  it earlier. */
+	template< typename F >
+	bool pushWith(F fill)
+	{
+		size_t pos;
+		Slot *slot;
+		if(!claim(pos, slot))
+		{
+			_dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		fill(slot->value);
+		slot->seq.store(pos+1, std::memory_order_release);
+
+		_pushed.fetch_add(1, std::memory_order_relaxed);
+		// with several producers the consumer may already be past pos.
+		size_t h = head.load(std::memory_order_relaxed);
+		size_t depth = pos+1 > h ? pos+1 - h : 0;
+		size_t highWater = _highWater.load(std::memory_order_relaxed);
+		while(depth > highWater && !_highWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed))
+			;
+
+		available.notifyAll();
+		return true;
+	}
+
+	//=== consumer ===
+
+	/** Returns the front object, or nullptr if the buffer is empty. Valid
+	 *  until the next pop. */
+	T *front()
+	{
+		size_t pos = head.load(std::memory_order_relaxed);
+		Slot &slot = slots[pos & (_capacity-1)];
+		if(slot.seq.load(std::memory_order_acquire) != pos+1) return nullptr;
+		return &slot.value;
+	}
+
+	/** Swaps the front object into out. Returns false if the buffer is empty. */
+	bool tryPop(T &out)
+	{
+		T *obj = front();
+		if(obj == nullptr) return false;
+
+		using std::swap;
+		swap(out, *obj);
+
+		size_t pos = head.load(std::memory_order_relaxed);
+		slots[pos & (_capacity-1)].seq.store(pos + _capacity, std::memory_order_release);
+		head.store(pos+1, std::memory_order_relaxed);
+		return true;
+	}
+
+	/** Like tryPop(), but waits up to timeoutMs (forever if negative) for
+	 *  an object. Returns false on timeout. */
+	bool pop(T &out, int timeoutMs = -1)
+	{
+		// a short spin saves a sleep / wake pair when the producer is busy.
+		for(int i=0;i<SpinBeforeWait;i++)
+			if(tryPop(out)) return true;
+
+		// wakeups without an object to pop (e.g. another producer's
+		// notification) don't restart the timeout.
+		const std::chrono::steady_clock::time_point deadline =
+			std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeoutMs, 0));
+
+		while(!tryPop(out))
+		{
+			int remainingMs = -1;
+			if(timeoutMs >= 0)
+			{
+				// rounded up, so the wait doesn't end early.
+				const long long remainingUs = std::chrono::duration_cast<std::chrono::microseconds>(
+									deadline - std::chrono::steady_clock::now()).count();
+				if(remainingUs <= 0) return tryPop(out);
+				remainingMs = (int)((remainingUs + 999) / 1000);
+			}
+
+			uint32_t key = available.prepareWait();
+			if(front() != nullptr)
+				available.cancelWait();
+			else if(!available.wait(key, remainingMs))
+				return tryPop(out);
+		}
+		return true;
+	}
+
+	//=== any thread ===
+
+	/** Approximate when called concurrently with push / pop. */
+	size_t size() const
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t h = head.load(std::memory_order_relaxed);
+		return t > h ? std::min(t - h, _capacity) : 0;
+	}
+	bool empty() const { return size() == 0; }
+	size_t capacity() const { return _capacity; }
+
+	// metrics
+	size_t pushed() const { return _pushed.load(std::memory_order_relaxed); }
+	size_t dropped() const { return _dropped.load(std::memory_order_relaxed); }
+	size_t highWater() const { return _highWater.load(std::memory_order_relaxed); }
+
+private:
+	static const int SpinBeforeWait = 256;
+
+	struct Slot
+	{
+		// pos     : free for the producer claiming pos
+		// pos + 1 : holds the object pushed at pos
+		std::atomic<size_t> seq;
+		T value;
+	};
+
+	// a slot for pos is free once the consumer released pos - capacity.
+	bool claim(size_t &pos, Slot *&slot)
+	{
+		pos = tail.load(std::memory_order_relaxed);
+		for(;;)
+		{
+			slot = &slots[pos & (_capacity-1)];
+			size_t seq = slot->seq.load(std::memory_order_acquire);
+			if(seq != pos)
+			{
+				if(!MultiProducer || seq < pos) return false;
+				pos = tail.load(std::memory_order_relaxed);	// lost a race, retry
+			}
+			else if(!MultiProducer)
+			{
+				tail.store(pos+1, std::memory_order_relaxed);
+				return true;
+			}
+			else if(tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed))
+				return true;
+		}
+	}
+
+	static size_t roundUp(size_t capacity)
+	{
+		size_t c = 1;
+		while(c < capacity) c *= 2;
+		return c;
+	}
+
+	const size_t _capacity;
+	std::unique_ptr<Slot[]> slots;
+
+	// producer and consumer ends on separate cache lines.
+	char pad0[64];
+	std::atomic<size_t> tail;
+	char pad1[64];
+	std::atomic<size_t> head;
+	char pad2[64];
+
+	std::atomic<size_t> _pushed;
+	std::atomic<size_t> _dropped;
+	std::atomic<size_t> _highWater;
+
+	EventCount available;
+};
+
+}
@@ -0,0 +1,253 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "util/UndistortMap.h"
+
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#include "util/IndexThreadReduce.h"
+
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace lsd_slam
+{
+
+const uint32_t UndistortMap::Invalid;
+
+UndistortMap::UndistortMap( const std::vector<float> &calibration, const ImageSize &inputSize,
+														const Camera &outputCamera, const ImageSize &outputSize )
+	: _inputSize( inputSize ),
+		_outputSize( outputSize )
+{
+	Model model;
+	if( calibration.size() == 5 )
+		model = (calibration[4] == 0) ? PINHOLE : FOV;
+	else {
+		CHECK( calibration.size() == 8 || calibration.size() == 9 ) << "Unsupported calibration with " << calibration.size() << " parameters";
+		model = RADTAN;
+	}
+
+	CHECK( inputSize.width >= 2 && inputSize.height >= 2 ) << "Input image is too small";
+
+	buildTable( model, calibration, outputCamera );
+}
+
+UndistortMap *UndistortMap::fromCalibFile( const std::string &calibFile,
+																					 const Camera &outputCamera, const ImageSize &outputSize )
+{
+	std::ifstream f( calibFile.c_str() );
+	std::string line;
+
+	std::vector<float> calibration;
+	if( std::getline( f, line ) ) {
+		std::istringstream l( line );
+		float v;
+		while( l >> v ) calibration.push_back( v );
+	}
+
+	ImageSize inputSize;
+	if( std::getline( f, line ) ) {
+		std::istringstream l( line );
+		l >> inputSize.width >> inputSize.height;
+	}
+
+	if( calibration.size() != 5 && calibration.size() != 8 && calibration.size() != 9 ) {
+		LOG(WARNING) << "Unsupported calibration in " << calibFile << ", not using the fused undistortion";
+		return nullptr;
+	}
+
+	if( inputSize.width < 2 || inputSize.height < 2 ) {
+		LOG(WARNING) << "No input image size in " << calibFile << ", not using the fused undistortion";
+		return nullptr;
+	}
+
+	return new UndistortMap( calibration, inputSize, outputCamera, outputSize );
+}
+
+void UndistortMap::buildTable( Model model, const std::vector<float> &c, const Camera &outputCamera )
+{
+	const int inW = _inputSize.width, inH = _inputSize.height;
+	const int outW = _outputSize.width, outH = _outputSize.height;
+
+	// input camera, with pixel (0,0) at the center of the top-left pixel.
+	float fx, fy, cx, cy;
+	if( model == RADTAN ) {
+		fx = c[0]; fy = c[1]; cx = c[2]; cy = c[3];
+	} else {
+		fx = c[0] * inW; fy = c[1] * inH;
+		cx = c[2] * inW - 0.5f; cy = c[3] * inH - 0.5f;
+	}
+
+	const float omega = (model == FOV) ? c[4] : 0;
+	const float d2t = 2.0f * tanf( omega / 2.0f );
+
+	_offset.assign( outW * outH, 0 );
+	_weights.assign( outW * outH, Invalid );
+	_rowSimdSafe.assign( outH, true );
+
+	// a gather reads 4 bytes at the top-left neighbour and at the one below.
+	const int lastSafeOffset = inW * inH - inW - 4;
+
+	for( int y = 0; y < outH; ++y )
+		for( int x = 0; x < outW; ++x )
+		{
+			float nx = (x - outputCamera.cx) / outputCamera.fx;
+			float ny = (y - outputCamera.cy) / outputCamera.fy;
+
+			if( model == FOV ) {
+				float r = sqrtf( nx*nx + ny*ny );
+				float fac = (r == 0) ? 1 : atanf( r * d2t ) / (omega * r);
+				nx *= fac; ny *= fac;
+			} else if( model == RADTAN ) {
+				const float k1 = c[4], k2 = c[5], p1 = c[6], p2 = c[7];
+				const float k3 = (c.size() > 8) ? c[8] : 0;
+
+				float r2 = nx*nx + ny*ny;
+				float radial = 1 + r2*(k1 + r2*(k2 + r2*k3));
+				float dx = 2*p1*nx*ny + p2*(r2 + 2*nx*nx);
+				float dy = p1*(r2 + 2*ny*ny) + 2*p2*nx*ny;
+				nx = nx*radial + dx;
+				ny = ny*radial + dy;
+			}
+
+			float ix = fx*nx + cx;
+			float iy = fy*ny + cy;
+
+			// make rounding resistant, so that exact border pixels stay valid.
+			const float eps = 0.01f;
+			if( !(ix > -eps && iy > -eps && ix < inW-1+eps && iy < inH-1+eps) ) continue;
+			ix = std::max( 0.0f, std::min( ix, (float)(inW-1) ) );
+			iy = std::max( 0.0f, std::min( iy, (float)(inH-1) ) );
+
+			// the bottom / right border is interpolated from the pixel before
+			// it with a fraction of one.
+			int x0 = std::min( (int)ix, inW-2 );
+			int y0 = std::min( (int)iy, inH-2 );
+			uint32_t wx = (uint32_t)lrintf( (ix - x0) * 256.0f );
+			uint32_t wy = (uint32_t)lrintf( (iy - y0) * 256.0f );
+
+			const int idx = x + y*outW;
+			_offset[idx] = x0 + y0*inW;
+			_weights[idx] = wx | (wy << 16);
+
+			if( _offset[idx] > lastSafeOffset ) _rowSimdSafe[y] = false;
+		}
+}
+
+UndistortMap::~UndistortMap()
+{
+}
+
+void UndistortMap::remap( const unsigned char *in, float *out, int numThreads ) const
+{
+	const int height = _outputSize.height;
+
+	// ingest workers remap frames concurrently; one at a time gets the pool.
+	std::unique_lock<std::mutex> lock( _poolMutex, std::defer_lock );
+	if( numThreads <= 1 || !lock.try_lock() ) {
+		remapRows( in, out, 0, height, true );
+		return;
+	}
+
+	if( !_pool ) _pool.reset( new IndexThreadReduce );
+
+	const int step = (height + numThreads - 1) / numThreads;
+	_pool->reduce( boost::bind( &UndistortMap::remapRows, this, in, out, _1, _2, true ), 0, height, step );
+}
+
+void UndistortMap::remapScalar( const unsigned char *in, float *out ) const
+{
+	remapRows( in, out, 0, _outputSize.height, false );
+}
+
+void UndistortMap::remapRows( const unsigned char *in, float *out, int yMin, int yMax, bool simd ) const
+{
+	const int width = _outputSize.width;
+	const int inW = _inputSize.width;
+
+	// value = bilinear interpolation scaled by 256*256
+	const float scale = 1.0f / 65536.0f;
+
+	for( int y = yMin; y < yMax; ++y )
+	{
+		const int32_t *offset = &_offset[y*width];
+		const uint32_t *weights = &_weights[y*width];
+		float *dst = out + y*width;
+
+		int x = 0;
+
+#if defined(ENABLE_SSE) && defined(__AVX2__)
+		if( simd && _rowSimdSafe[y] ) {
+			const __m256i byteMask = _mm256_set1_epi32( 0xFF );
+			const __m256i fracMask = _mm256_set1_epi32( 0xFFFF );
+			const __m256i invalid = _mm256_set1_epi32( (int)Invalid );
+			const __m256 scale8 = _mm256_set1_ps( scale );
+
+			for( ; x + 8 <= width; x += 8 )
+			{
+				__m256i off = _mm256_loadu_si256( (const __m256i *)(offset + x) );
+				__m256i w = _mm256_loadu_si256( (const __m256i *)(weights + x) );
+
+				// bytes 0 and 1 of each lane are the left and right neighbour.
+				__m256i top = _mm256_i32gather_epi32( (const int *)in, off, 1 );
+				__m256i bot = _mm256_i32gather_epi32( (const int *)(in + inW), off, 1 );
+
+				__m256i p00 = _mm256_and_si256( top, byteMask );
+				__m256i p01 = _mm256_and_si256( _mm256_srli_epi32( top, 8 ), byteMask );
+				__m256i p10 = _mm256_and_si256( bot, byteMask );
+				__m256i p11 = _mm256_and_si256( _mm256_srli_epi32( bot, 8 ), byteMask );
+
+				__m256i wx = _mm256_and_si256( w, fracMask );
+				__m256i wy = _mm256_srli_epi32( w, 16 );
+
+				__m256i t = _mm256_add_epi32( _mm256_slli_epi32( p00, 8 ), _mm256_mullo_epi32( _mm256_sub_epi32( p01, p00 ), wx ) );
+				__m256i b = _mm256_add_epi32( _mm256_slli_epi32( p10, 8 ), _mm256_mullo_epi32( _mm256_sub_epi32( p11, p10 ), wx ) );
+				__m256i v = _mm256_add_epi32( _mm256_slli_epi32( t, 8 ), _mm256_mullo_epi32( _mm256_sub_epi32( b, t ), wy ) );
+
+				v = _mm256_andnot_si256( _mm256_cmpeq_epi32( w, invalid ), v );
+
+				_mm256_storeu_ps( dst + x, _mm256_mul_ps( _mm256_cvtepi32_ps( v ), scale8 ) );
+			}
+		}
+#endif
+
+		for( ; x < width; ++x )
+		{
+			if( weights[x] == Invalid ) {
+				dst[x] = 0;
+				continue;
+			}
+
+			const unsigned char *p = in + offset[x];
+			const int wx = weights[x] & 0xFFFF, wy = weights[x] >> 16;
+
+			int t = (p[0] << 8) + (p[1] - p[0]) * wx;
+			int b = (p[inW] << 8) + (p[inW+1] - p[inW]) * wx;
+			dst[x] = ((t << 8) + (b - t) * wy) * scale;
+		}
+	}
+}
+
+}
@@ -0,0 +1,100 @@
+/**
+* This file is part of LSD-SLAM.
+*
+* Copyright 2013 Jakob Engel <engelj at in dot tum dot de> (Technical University of Munich)
+* For more information see <http://vision.in.tum.de/lsdslam>
+*
+* LSD-SLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* LSD-SLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with LSD-SLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <mutex>
+#include <memory>
+
+#include "util/Configuration.h"
+
+namespace lsd_slam
+{
+
+class IndexThreadReduce;
+
+// Fused undistortion and conversion of 8 bit input images to float.
+//
+// The bilinear remap from the output (slam) image into the input image is
+// computed once per calibration and stored in fixed point: for every
+// output pixel the offset of the top-left input pixel and the 8 bit
+// fractions (0..256) in x and y. remap() then writes the undistorted
+// float image in one pass over the input, with an AVX2 kernel where
+// available. Integer arithmetic makes the SIMD and plain paths give
+// identical results.
+//
+// The distortion model is read from the calibration file: the FOV (ATAN)
+// and pinhole models (5 parameters, normalized by the image size) and the
+// OpenCV radial-tangential model (8 or 9 parameters, in pixels). The
+// output camera is the one the libvideoio undistorter reports, so both
+// paths see the same geometry.
+class UndistortMap
+{
+public:
+
+	UndistortMap( const std::vector<float> &calibration, const ImageSize &inputSize,
+								const Camera &outputCamera, const ImageSize &outputSize );
+	~UndistortMap();
+
+	// Returns nullptr if the file's model isn't supported.
+	static UndistortMap *fromCalibFile( const std::string &calibFile,
+																			const Camera &outputCamera, const ImageSize &outputSize );
+
+	const ImageSize &inputSize() const { return _inputSize; }
+	const ImageSize &outputSize() const { return _outputSize; }
+
+	// Writes the undistorted image into out (outputSize, row-major). Pixels
+	// that map outside the input image are set to 0. With numThreads > 1 the
+	// rows are split into that many parts for a thread pool the map keeps;
+	// while another caller is using the pool, the rows are done here.
+	void remap( const unsigned char *in, float *out, int numThreads = 1 ) const;
+
+	// remap() without the SIMD kernel, which must give the same result.
+	void remapScalar( const unsigned char *in, float *out ) const;
+
+private:
+
+	enum Model { PINHOLE, FOV, RADTAN };
+
+	void buildTable( Model model, const std::vector<float> &calibration, const Camera &outputCamera );
+
+	void remapRows( const unsigned char *in, float *out, int yMin, int yMax, bool simd ) const;
+
+	ImageSize _inputSize, _outputSize;
+
+	// per output pixel: input offset of the top-left neighbour, and the x
+	// and y fractions in the low and high 16 bits (Invalid: outside).
+	static const uint32_t Invalid = 0xFFFFFFFF;
+	std::vector<int32_t> _offset;
+	std::vector<uint32_t> _weights;
+
+	// rows whose gathers stay inside the input buffer (all but those
+	// sampling next to the bottom-right corner).
+	std::vector<bool> _rowSimdSafe;
+
+	// created on the first remap() with numThreads > 1.
+	mutable std::mutex _poolMutex;
+	mutable std::unique_ptr<IndexThreadReduce> _pool;
+};
+
+}
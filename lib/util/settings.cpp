@@ -21,6 +21,7 @@
 #include "util/settings.h"
 #include <opencv2/opencv.hpp>
 #include <boost/bind.hpp>
+#include <algorithm>
 
 
 
@@ -69,6 +70,16 @@ float KFDistWeight = 3;
 
 float minUseGrad = 5;
 float cameraPixelNoise2 = 4*4;
+int trackingPointBudget[PYRAMID_LEVELS] = {0};
+
+void setTrackingPointBudget(int finestLevelBudget)
+{
+	for(int lvl=0;lvl<PYRAMID_LEVELS;lvl++)
+	{
+		int shift = 2*std::max(0, lvl - SE3TRACKING_MIN_LEVEL);
+		trackingPointBudget[lvl] = finestLevelBudget > 0 ? std::max(1, finestLevelBudget >> shift) : 0;
+	}
+}
 float depthSmoothingFactor = 1;
 
 bool allowNegativeIdepths = true;
@@ -80,15 +91,21 @@ bool useAffineLightningEstimation = false;
 
 
 bool useFabMap = false;
+bool useThumbnailIndex = false;
+float thumbnailMatchTH = 0.9;
 bool doSlam = true;
 bool doKFReActivation = true;
 bool doMapping = true;
 
 int maxLoopClosureCandidates = 10;
+int poseGraphLocalWindow = 4;
+int trackingReferenceCacheSize = 20;
+float frameMemoryBudgetMB = 0;
 int maxOptimizationIterations = 100;
 int propagateKeyFrameDepthCount = 0;
 float loopclosureStrictness = 1.5;
 float relocalizationTH = 0.7;
+int relocalizationThumbnailCandidates = 100;
 
 
 bool saveKeyframes =  false;
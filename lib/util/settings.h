@@ -104,6 +104,9 @@ namespace lsd_slam
 	#define RELOCALIZE_THREADS 6
 #endif
 
+// keyframes scored per work item in the relocalizer's ranking stage.
+#define RELOCALIZE_SCORE_BATCH 32
+
 #define SE3TRACKING_MIN_LEVEL 1
 #define SE3TRACKING_MAX_LEVEL 5
 
@@ -116,6 +119,10 @@ namespace lsd_slam
 
 #define PYRAMID_DIVISOR (0x1<<PYRAMID_LEVELS)
 
+// side length (in pixels of the respective level) of the grid cells the
+// tracking point budget is balanced over.
+#define TRACKING_POINT_GRID_CELL 8
+
 
 
 
@@ -229,16 +236,37 @@ extern float freeDebugParam5;
 extern float KFDistWeight;
 extern float KFUsageWeight;
 extern int maxLoopClosureCandidates;
+// pose-graph optimization only covers keyframes within this many constraints
+// of new ones. New constraints spanning more count as loop closures and make
+// the next optimization global. 0 = always optimize the whole graph.
+extern int poseGraphLocalWindow;
+// number of built keyframe TrackingReferences the constraint search keeps.
+extern int trackingReferenceCacheSize;
+// soft cap on FrameMemory buffers in use, 0 = none. Caches shrink above it.
+extern float frameMemoryBudgetMB;
 extern int propagateKeyFrameDepthCount;
 extern float loopclosureStrictness;
 extern float relocalizationTH;
+// number of most similar thumbnails the relocalizer scores per frame.
+extern int relocalizationThumbnailCandidates;
 
 
 extern float minUseGrad;
 extern float cameraPixelNoise2;
+
+// max. number of points per pyramid level in a TrackingReference (0 = all).
+// Keep it well above MIN_GOODPERALL_PIXEL * area of the level, else tracking
+// will be flagged as bad.
+extern int trackingPointBudget[PYRAMID_LEVELS];
+// sets trackingPointBudget[] from the budget of SE3TRACKING_MIN_LEVEL.
+void setTrackingPointBudget(int finestLevelBudget);
 extern float depthSmoothingFactor;
 
 extern bool useFabMap;
+// thumbnail index for appearance-based loop closures and relocalization (--thumbnail-index).
+extern bool useThumbnailIndex;
+// min. thumbnail NCC of an appearance-based loop closure candidate.
+extern float thumbnailMatchTH;
 // extern bool doSlam;
 // extern bool doMapping;
 
@@ -381,6 +409,9 @@ public:
 
 		var_weight = 1.0;
 		huber_d = 3;
+
+		maxTimeMs = 0;
+		minLevel = SE3TRACKING_MIN_LEVEL;
 	}
 
 	float lambdaSuccessFac;
@@ -397,6 +428,12 @@ public:
 
 	float huber_d;
 	float var_weight;
+
+	// time budget for one SE3Tracker::trackFrame() call, 0 = unlimited.
+	float maxTimeMs;
+
+	// finest pyramid level SE3Tracker::trackFrame() tracks on.
+	int minLevel;
 };
 
 extern RunningStats runningStats;
@@ -0,0 +1,144 @@
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include "DepthEstimation/DepthMapRenderer.h"
+#include "util/settings.h"
+
+using namespace lsd_slam;
+
+namespace {
+
+  // not a multiple of eight, so the AVX2 loop leaves a tail.
+  const int Width = 37, Height = 5, Size = Width*Height;
+  const int LastFrameID = 10;
+
+  // renders one snapshot and waits for the published image.
+  class RenderOnce
+  {
+  public:
+    RenderOnce()
+      : _done( false )
+    {
+      _conf.slamImage = SlamImageSize( Width, Height );
+      _conf.depthMapDisplayHz = 0;
+      _conf.onSceenInfoDisplay = false;
+    }
+
+    std::vector<unsigned char> operator()( const DepthMapRenderer::Snapshot &snap )
+    {
+      DepthMapRenderer renderer( _conf, [this]( cv::Mat &img ) {
+        std::lock_guard<std::mutex> lock( _mutex );
+        _pixels.assign( img.data, img.data + 3*Size );
+        _done = true;
+        _cond.notify_all();
+      });
+
+      DepthMapRenderer::Snapshot *s = renderer.beginSnapshot();
+      EXPECT_NE( s, nullptr );
+      *s = snap;
+      renderer.submit();
+
+      std::unique_lock<std::mutex> lock( _mutex );
+      _cond.wait( lock, [this]() { return _done; } );
+      _done = false;
+      return _pixels;
+    }
+
+  private:
+    Configuration _conf;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+    bool _done;
+    std::vector<unsigned char> _pixels;
+  };
+
+  DepthMapPixelHypothesis randomHypothesis( std::mt19937 &rng, int mode )
+  {
+    std::uniform_real_distribution<float> idepth( -0.5f, 4.5f ), logVar( -8, 2 );
+    std::uniform_int_distribution<int> validity( 0, VALIDITY_COUNTER_MAX + VALIDITY_COUNTER_MAX_VARIABLE + 5 ), skip( -5, 120 );
+
+    DepthMapPixelHypothesis h( idepth( rng ), idepth( rng ), std::pow( 10.f, logVar( rng ) ), std::pow( 10.f, logVar( rng ) ),
+                               validity( rng ), mode );
+    h.nextStereoFrameMinID = LastFrameID + skip( rng );
+    return h;
+  }
+
+  // the table quantizes inverse depths to 1/256 and variances to 7
+  // mantissa bits, which may move a channel by one.
+  int tolerance( int mode )
+  {
+    return (mode == 2 || mode == 5) ? 0 : 1;
+  }
+
+}
+
+TEST( DepthMapRenderer, LutMatchesGetVisualizationColor )
+{
+  RenderOnce render;
+  std::mt19937 rng( 5 );
+
+  for( int mode = 0; mode <= 5; ++mode ) {
+    DepthMapRenderer::Snapshot snap;
+    snap.resize( Width, Height );
+    snap.mode = mode;
+    snap.markBlacklisted = false;
+
+    std::vector<DepthMapPixelHypothesis> hypotheses;
+    for( int i = 0; i < Size; ++i ) {
+      hypotheses.push_back( randomHypothesis( rng, mode ) );
+      snap.image[i] = 0;
+      snap.value[i] = DepthMapRenderer::displayValue( hypotheses.back(), mode, LastFrameID );
+      snap.blacklisted[i] = 0;
+    }
+
+    std::vector<unsigned char> pixels( render( snap ) );
+    ASSERT_EQ( pixels.size(), (size_t)3*Size );
+
+    for( int i = 0; i < Size; ++i ) {
+      cv::Vec3b expected = hypotheses[i].getVisualizationColor( LastFrameID );
+      for( int c = 0; c < 3; ++c )
+        ASSERT_LE( std::abs( pixels[3*i + c] - expected[c] ), tolerance( mode ) )
+            << "mode " << mode << ", pixel " << i << ", value " << snap.value[i];
+    }
+  }
+}
+
+// pixels without a valid hypothesis show the keyframe image, or red if
+// blacklisted ones are marked.
+TEST( DepthMapRenderer, InvalidPixelsShowImage )
+{
+  RenderOnce render;
+
+  for( int mark = 0; mark <= 1; ++mark ) {
+    DepthMapRenderer::Snapshot snap;
+    snap.resize( Width, Height );
+    snap.mode = 0;
+    snap.markBlacklisted = mark;
+
+    for( int i = 0; i < Size; ++i ) {
+      snap.image[i] = (i * 7) % 300 - 20;
+      snap.value[i] = NAN;
+      snap.blacklisted[i] = (i % 3) == 0;
+    }
+
+    std::vector<unsigned char> pixels( render( snap ) );
+
+    for( int i = 0; i < Size; ++i ) {
+      if( mark && snap.blacklisted[i] ) {
+        ASSERT_EQ( pixels[3*i], 0 );
+        ASSERT_EQ( pixels[3*i + 1], 0 );
+        ASSERT_EQ( pixels[3*i + 2], 255 );
+      } else {
+        const int gray = std::max( 0, std::min( 255, (int)lrintf( snap.image[i] ) ) );
+        for( int c = 0; c < 3; ++c ) ASSERT_EQ( pixels[3*i + c], gray ) << "pixel " << i;
+      }
+    }
+  }
+}
@@ -0,0 +1,169 @@
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "GlobalMapping/KeyFrameSpatialIndex.h"
+
+using namespace lsd_slam;
+
+namespace {
+
+  const int Width = 32, Height = 24;
+
+  Configuration indexConf()
+  {
+    Configuration conf;
+    conf.slamImage = SlamImageSize( Width, Height );
+    conf.camera = Camera( 30, 30, 16, 12 );
+    conf.camera.K << 30, 0, 16, 0, 30, 12, 0, 0, 1;
+    conf.camera.Kinv = conf.camera.K.inverse();
+    return conf;
+  }
+
+  struct Scene {
+    std::vector<Frame::SharedPtr> keyframes;
+    std::mt19937 rng;
+
+    Scene() : rng( 17 ) {}
+
+    double uniform( double lo, double hi ) { return std::uniform_real_distribution<double>( lo, hi )( rng ); }
+
+    Eigen::Vector3d randomDirection()
+    {
+      Eigen::Vector3d d( uniform( -1, 1 ), uniform( -1, 1 ), uniform( -1, 1 ) );
+      return d.norm() > 1e-3 ? d.normalized() : Eigen::Vector3d( 0, 0, 1 );
+    }
+
+    // keyframes spread over a few powers of two of distFac.
+    void addKeyframes( const Configuration &conf, int count )
+    {
+      std::vector<float> image( Width*Height, 0.f );
+      for( int i = 0; i < count; ++i ) {
+        const int id = keyframes.size();
+        Frame::SharedPtr kf( new Frame( id, conf, id, image.data() ) );
+        kf->meanIdepth = std::pow( 2.0, uniform( -3, 3 ) );
+        keyframes.push_back( kf );
+      }
+    }
+
+    PoseSnapshot::ConstPtr randomPoses( int version )
+    {
+      std::shared_ptr<PoseSnapshot> poses( new PoseSnapshot( version ) );
+      for( const Frame::SharedPtr &kf : keyframes ) {
+        Eigen::Quaterniond q( Eigen::AngleAxisd( uniform( 0, M_PI ), randomDirection() ) );
+        Sim3 camToWorld( Sophus::RxSO3d( uniform( 0.5, 2 ), q.toRotationMatrix() ),
+                         Eigen::Vector3d( uniform( -8, 8 ), uniform( -8, 8 ), uniform( -8, 8 ) ) );
+        poses->set( kf->id(), camToWorld );
+      }
+      return poses;
+    }
+  };
+
+  // what the index has to return, by checking every keyframe.
+  std::vector<int> linearScan( const Scene &scene, const PoseSnapshot &poses,
+                               const Eigen::Vector3d &pos, const Eigen::Vector3d &viewingDir,
+                               float distanceTH, float cosAngleTH, bool checkBothScales, float distFacReciprocal )
+  {
+    std::vector<int> result;
+    for( size_t i = 0; i < scene.keyframes.size(); ++i ) {
+      Sim3 camToWorld = poses.getCamToWorld( *scene.keyframes[i]->pose );
+
+      float distFac = scene.keyframes[i]->meanIdepth / camToWorld.scale();
+      if( checkBothScales && distFacReciprocal < distFac ) distFac = distFacReciprocal;
+      Eigen::Vector3d dist = (pos - camToWorld.translation()) * distFac;
+      if( dist.dot( dist ) > distanceTH ) continue;
+
+      if( camToWorld.rotationMatrix().rightCols<1>().dot( viewingDir ) < cosAngleTH ) continue;
+      result.push_back( i );
+    }
+    return result;
+  }
+
+  void expectMatchesLinearScan( Scene &scene, const KeyFrameSpatialIndex &index, const PoseSnapshot &poses, int numQueries )
+  {
+    std::vector<int> found;
+    for( int q = 0; q < numQueries; ++q ) {
+      const Eigen::Vector3d pos( scene.uniform( -9, 9 ), scene.uniform( -9, 9 ), scene.uniform( -9, 9 ) );
+      const Eigen::Vector3d dir( scene.randomDirection() );
+      const float distanceTH = scene.uniform( 0.01, 16 );
+      const float cosAngleTH = scene.uniform( -1, 1 );
+      const bool checkBothScales = (q % 2) == 1;
+      const float distFacReciprocal = std::pow( 2.0, scene.uniform( -3, 3 ) );
+
+      index.query( pos, dir, distanceTH, cosAngleTH, checkBothScales, distFacReciprocal, found );
+      ASSERT_EQ( found, linearScan( scene, poses, pos, dir, distanceTH, cosAngleTH, checkBothScales, distFacReciprocal ) )
+          << "query " << q;
+    }
+  }
+
+}
+
+TEST( KeyFrameSpatialIndex, MatchesLinearScan )
+{
+  Configuration conf( indexConf() );
+  Scene scene;
+  scene.addKeyframes( conf, 300 );
+  PoseSnapshot::ConstPtr poses = scene.randomPoses( 1 );
+
+  KeyFrameSpatialIndex index;
+  index.update( scene.keyframes, *poses );
+  ASSERT_EQ( index.size(), 300 );
+
+  expectMatchesLinearScan( scene, index, *poses, 500 );
+}
+
+TEST( KeyFrameSpatialIndex, FollowsNewKeyframesAndPoses )
+{
+  Configuration conf( indexConf() );
+  Scene scene;
+  scene.addKeyframes( conf, 100 );
+  PoseSnapshot::ConstPtr poses = scene.randomPoses( 1 );
+
+  KeyFrameSpatialIndex index;
+  index.update( scene.keyframes, *poses );
+
+  // keyframes appended under the same version are added incrementally.
+  scene.addKeyframes( conf, 100 );
+  std::shared_ptr<PoseSnapshot> grown( new PoseSnapshot( 1 ) );
+  for( const Frame::SharedPtr &kf : scene.keyframes ) {
+    Sim3 camToWorld;
+    if( poses->find( kf->id(), camToWorld ) ) grown->set( kf->id(), camToWorld );
+    else grown->set( kf->id(), Sim3( Sophus::RxSO3d(), Eigen::Vector3d( scene.uniform( -8, 8 ), 0, 0 ) ) );
+  }
+  index.update( scene.keyframes, *grown );
+  ASSERT_EQ( index.size(), 200 );
+  expectMatchesLinearScan( scene, index, *grown, 200 );
+
+  // a new version moves every keyframe.
+  PoseSnapshot::ConstPtr moved = scene.randomPoses( 2 );
+  index.update( scene.keyframes, *moved );
+  ASSERT_EQ( index.size(), 200 );
+  expectMatchesLinearScan( scene, index, *moved, 200 );
+}
+
+// keyframes without a usable distFac aren't gridded, but are still found.
+TEST( KeyFrameSpatialIndex, KeepsKeyframesWithoutDepth )
+{
+  Configuration conf( indexConf() );
+  Scene scene;
+  scene.addKeyframes( conf, 50 );
+  scene.keyframes[3]->meanIdepth = 0;
+  scene.keyframes[7]->meanIdepth = NAN;
+  PoseSnapshot::ConstPtr poses = scene.randomPoses( 1 );
+
+  KeyFrameSpatialIndex index;
+  index.update( scene.keyframes, *poses );
+  ASSERT_EQ( index.size(), 50 );
+
+  // with checkBothScales, distFacReciprocal bounds every distance.
+  std::vector<int> found;
+  index.query( Eigen::Vector3d::Zero(), Eigen::Vector3d( 0, 0, 1 ), 1e6, -1, true, 0.01, found );
+  ASSERT_EQ( found, linearScan( scene, *poses, Eigen::Vector3d::Zero(), Eigen::Vector3d( 0, 0, 1 ), 1e6, -1, true, 0.01 ) );
+  ASSERT_TRUE( std::find( found.begin(), found.end(), 3 ) != found.end() );
+
+  expectMatchesLinearScan( scene, index, *poses, 200 );
+}
@@ -0,0 +1,143 @@
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "IOWrapper/RawFrameFile.h"
+#include "IOWrapper/RawFrameSource.h"
+
+using namespace lsd_slam;
+
+namespace {
+
+  // odd sizes, so frames don't end on the alignment.
+  const int Width = 33, Height = 17, NumFrames = 5;
+
+  std::string tempPath( const std::string &name )
+  {
+    return std::string( P_tmpdir ) + "/lsdslam_" + name + ".raw";
+  }
+
+  unsigned char pixel( int frame, int x, int y )
+  {
+    return (frame * 31 + x * 7 + y * 13) & 0xFF;
+  }
+
+  bool writeFrames( RawFrameWriter &writer )
+  {
+    cv::Mat img( Height, Width, CV_8UC1 );
+    for( int f = 0; f < NumFrames; ++f ) {
+      for( int y = 0; y < Height; ++y )
+        for( int x = 0; x < Width; ++x ) img.ptr( y )[x] = pixel( f, x, y );
+      if( !writer.write( img, 1.0 + f * 0.25 ) ) return false;
+    }
+    return true;
+  }
+
+  bool writeSequence( const std::string &path )
+  {
+    RawFrameWriter writer;
+    return writer.open( path, Width, Height, 15.0 ) && writeFrames( writer ) && writer.close();
+  }
+
+  // a copy of path without its last bytes.
+  void truncate( const std::string &path, const std::string &to, size_t bytes )
+  {
+    std::ifstream in( path.c_str(), std::ios::binary );
+    std::string data( (std::istreambuf_iterator<char>( in )), std::istreambuf_iterator<char>() );
+    std::ofstream( to.c_str(), std::ios::binary ).write( data.data(), data.size() - bytes );
+  }
+
+}
+
+TEST( RawFrameFile, RoundTrip )
+{
+  const std::string path( tempPath( "roundtrip" ) );
+  ASSERT_TRUE( writeSequence( path ) );
+  ASSERT_TRUE( RawFrameSource::isRawFrameFile( path ) );
+
+  RawFrameSource source;
+  ASSERT_TRUE( source.open( path ) );
+  ASSERT_EQ( source.numFrames(), NumFrames );
+  ASSERT_EQ( source.width(), Width );
+  ASSERT_EQ( source.height(), Height );
+  ASSERT_EQ( source.fps(), 15.0f );
+
+  cv::Mat img;
+  ASSERT_EQ( source.data(), nullptr );
+  ASSERT_LT( source.getImage( img ), 0 );
+
+  for( int f = 0; f < NumFrames; ++f ) {
+    ASSERT_TRUE( source.grab() );
+    ASSERT_DOUBLE_EQ( source.timestamp(), 1.0 + f * 0.25 );
+
+    const unsigned char *view = source.data();
+    ASSERT_NE( view, nullptr );
+
+    // getImage() copies, the view stays read-only.
+    ASSERT_EQ( source.getImage( img ), 0 );
+    ASSERT_NE( (const unsigned char *)img.data, view );
+
+    for( int y = 0; y < Height; ++y )
+      for( int x = 0; x < Width; ++x ) {
+        ASSERT_EQ( view[y*Width + x], pixel( f, x, y ) );
+        ASSERT_EQ( img.ptr( y )[x], pixel( f, x, y ) );
+      }
+  }
+  ASSERT_FALSE( source.grab() );
+
+  std::remove( path.c_str() );
+}
+
+TEST( RawFrameFile, UnclosedFileHasNoFrames )
+{
+  const std::string path( tempPath( "unclosed" ) );
+
+  // the index and frame count are only written by close().
+  RawFrameWriter writer;
+  ASSERT_TRUE( writer.open( path, Width, Height ) );
+  ASSERT_TRUE( writeFrames( writer ) );
+  ASSERT_EQ( writer.numFrames(), NumFrames );
+
+  RawFrameSource source;
+  if( source.open( path ) ) ASSERT_EQ( source.numFrames(), 0 );
+  ASSERT_FALSE( source.grab() );
+
+  ASSERT_TRUE( writer.close() );
+  ASSERT_TRUE( source.open( path ) );
+  ASSERT_EQ( source.numFrames(), NumFrames );
+  ASSERT_EQ( source.fps(), 0.0f );
+
+  std::remove( path.c_str() );
+}
+
+TEST( RawFrameFile, MalformedFilesAreRejected )
+{
+  const std::string path( tempPath( "complete" ) ), truncated( tempPath( "truncated" ) ), magicOnly( tempPath( "magic" ) );
+  ASSERT_TRUE( writeSequence( path ) );
+
+  truncate( path, truncated, 8 );
+  std::ofstream( magicOnly.c_str(), std::ios::binary ).write( RawFrameMagic, sizeof(RawFrameMagic) );
+  ASSERT_TRUE( RawFrameSource::isRawFrameFile( magicOnly ) );
+
+  RawFrameSource source;
+  ASSERT_FALSE( source.open( truncated ) );
+  ASSERT_FALSE( source.open( magicOnly ) );
+  ASSERT_FALSE( source.open( tempPath( "missing" ) ) );
+  ASSERT_FALSE( RawFrameSource::isRawFrameFile( tempPath( "missing" ) ) );
+
+  ASSERT_EQ( source.numFrames(), 0 );
+  ASSERT_FALSE( source.grab() );
+
+  // a failed open leaves the source usable for the next.
+  ASSERT_TRUE( source.open( path ) );
+  ASSERT_EQ( source.numFrames(), NumFrames );
+
+  std::remove( path.c_str() );
+  std::remove( truncated.c_str() );
+  std::remove( magicOnly.c_str() );
+}
@@ -0,0 +1,96 @@
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "util/RingBuffer.h"
+
+using namespace lsd_slam;
+
+TEST( RingBuffer, RoundsCapacityUp )
+{
+  RingBuffer<int> buffer( 5 );
+  ASSERT_EQ( buffer.capacity(), 8u );
+  ASSERT_TRUE( buffer.empty() );
+}
+
+TEST( RingBuffer, DropsWhenFull )
+{
+  RingBuffer<int> buffer( 4 );
+
+  for( int i = 0; i < 4; ++i ) ASSERT_TRUE( buffer.push( i ) );
+  ASSERT_FALSE( buffer.push( 4 ) );
+  ASSERT_EQ( buffer.size(), 4u );
+  ASSERT_EQ( buffer.dropped(), 1u );
+
+  int out;
+  for( int i = 0; i < 4; ++i ) {
+    ASSERT_TRUE( buffer.tryPop( out ) );
+    ASSERT_EQ( out, i );
+  }
+  ASSERT_FALSE( buffer.tryPop( out ) );
+  ASSERT_EQ( buffer.front(), nullptr );
+}
+
+TEST( RingBuffer, PopTimesOut )
+{
+  RingBuffer<int> buffer( 4 );
+
+  int out;
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_FALSE( buffer.pop( out, 20 ) );
+  ASSERT_GE( std::chrono::steady_clock::now() - start, std::chrono::milliseconds( 20 ) );
+}
+
+// One producer, one consumer: every object arrives, in order.
+TEST( RingBuffer, SingleProducerStress )
+{
+  const int count = 200000;
+  RingBuffer<int> buffer( 64 );
+
+  std::thread producer( [&]() {
+    for( int i = 0; i < count; ++i )
+      while( !buffer.push( i ) ) std::this_thread::yield();
+  });
+
+  int out;
+  for( int i = 0; i < count; ++i ) {
+    ASSERT_TRUE( buffer.pop( out ) );
+    ASSERT_EQ( out, i );
+  }
+  producer.join();
+
+  ASSERT_TRUE( buffer.empty() );
+  ASSERT_EQ( buffer.pushed(), (size_t)count );
+}
+
+// Several producers: every object arrives exactly once, and each
+// producer's objects arrive in the order it pushed them.
+TEST( RingBuffer, MultiProducerStress )
+{
+  const int numProducers = 4, perProducer = 50000;
+  RingBuffer<int, true> buffer( 64 );
+
+  std::vector<std::thread> producers;
+  for( int p = 0; p < numProducers; ++p )
+    producers.push_back( std::thread( [&buffer, p]() {
+      for( int i = 0; i < perProducer; ++i )
+        while( !buffer.push( p * perProducer + i ) ) std::this_thread::yield();
+    }));
+
+  std::vector<int> next( numProducers, 0 );
+  int out;
+  for( int n = 0; n < numProducers * perProducer; ++n ) {
+    ASSERT_TRUE( buffer.pop( out, 5000 ) );
+    const int p = out / perProducer;
+    ASSERT_EQ( out % perProducer, next[p] );
+    ++next[p];
+  }
+
+  for( auto &t : producers ) t.join();
+
+  for( int p = 0; p < numProducers; ++p ) ASSERT_EQ( next[p], perProducer );
+  ASSERT_FALSE( buffer.tryPop( out ) );
+  ASSERT_EQ( buffer.pushed(), (size_t)(numProducers * perProducer) );
+}
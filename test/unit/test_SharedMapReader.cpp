@@ -0,0 +1,183 @@
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "IOWrapper/SharedMemoryOutput3DWrapper.h"
+#include "IOWrapper/SharedMapReader.h"
+#include "DataStructures/Frame.h"
+
+using namespace lsd_slam;
+
+namespace {
+
+  const int Width = 64, Height = 48;
+
+  Configuration mapConf()
+  {
+    Configuration conf;
+    conf.slamImage = SlamImageSize( Width, Height );
+    conf.camera = Camera( 50, 50, 32, 24 );
+    conf.camera.K << 50, 0, 32, 0, 50, 24, 0, 0, 1;
+    conf.camera.Kinv = conf.camera.K.inverse();
+    return conf;
+  }
+
+  std::string regionName( const std::string &test )
+  {
+    return "/lsdslam_test_" + test + "_" + std::to_string( getpid() );
+  }
+
+  // keyframe id with idepth planes that differ from those of every other id.
+  Frame::SharedPtr makeKeyframe( const Configuration &conf, int id )
+  {
+    std::vector<float> image( Width*Height ), depth( Width*Height );
+    for( int i = 0; i < Width*Height; ++i ) {
+      image[i] = (i * 37 + id * 11) % 256;
+      depth[i] = 1.0f + id + (i % Width) * 0.01f;
+    }
+
+    Frame::SharedPtr kf( new Frame( id, conf, id * 0.5, image.data() ) );
+    kf->setDepthFromGroundTruth( depth.data() );
+    return kf;
+  }
+
+}
+
+TEST( SharedMapReader, OpensOnlyOnceWritten )
+{
+  const Configuration conf( mapConf() );
+  const std::string name( regionName( "open" ) );
+
+  SharedMapReader reader;
+  ASSERT_FALSE( reader.open( name ) );
+
+  {
+    SharedMemoryOutput3DWrapper writer( name, conf, 4, 8 );
+    ASSERT_TRUE( writer.valid() );
+
+    ASSERT_TRUE( reader.open( name ) );
+    ASSERT_EQ( reader.header().width, (uint32_t)Width );
+    ASSERT_EQ( reader.header().height, (uint32_t)Height );
+
+    shm::Pose pose;
+    ASSERT_EQ( reader.latestPose( pose ), 0u );
+
+    std::vector<SharedMapReader::KeyframeView> views;
+    ASSERT_EQ( reader.keyframes( views ), 0u );
+  }
+
+  reader.close();
+  ASSERT_FALSE( reader.open( name ) );
+}
+
+TEST( SharedMapReader, InvalidNameDisablesWriter )
+{
+  SharedMemoryOutput3DWrapper writer( "/not/a/valid/name", mapConf() );
+  ASSERT_FALSE( writer.valid() );
+
+  // publishing to it is a no-op, not a crash.
+  writer.publishPose( Sophus::Sim3f() );
+}
+
+// every pose a reader gets while the writer keeps publishing is one the
+// writer published whole: its translation is (seq, 2 seq, 3 seq).
+TEST( SharedMapReader, PosesAreConsistentUnderConcurrentWrites )
+{
+  const std::string name( regionName( "poses" ) );
+  SharedMemoryOutput3DWrapper writer( name, mapConf(), 4, 4 );
+  ASSERT_TRUE( writer.valid() );
+
+  SharedMapReader reader;
+  ASSERT_TRUE( reader.open( name ) );
+
+  const int count = 200000;
+  std::atomic<bool> done( false );
+  std::thread writerThread( [&]() {
+    for( int i = 1; i <= count; ++i ) {
+      Sophus::Sim3f pose;
+      pose.translation() = Eigen::Vector3f( i, 2*i, 3*i );
+      writer.publishPose( pose );
+    }
+    done = true;
+  });
+
+  int reads = 0;
+  uint64_t lastSeq = 0;
+  while( !done ) {
+    shm::Pose pose;
+    const uint64_t seq = reader.latestPose( pose );
+    if( seq == 0 ) continue;
+
+    ASSERT_EQ( pose[3], (float)seq );
+    ASSERT_EQ( pose[7], (float)(2*seq) );
+    ASSERT_EQ( pose[11], (float)(3*seq) );
+    ASSERT_GE( seq, lastSeq );
+    lastSeq = seq;
+    ++reads;
+  }
+  writerThread.join();
+
+  shm::Pose pose;
+  ASSERT_EQ( reader.latestPose( pose ), (uint64_t)count );
+  ASSERT_GT( reads, 0 );
+}
+
+// keyframe views that are still valid() after reading their planes hold
+// exactly what was published for their frame id, never a mix of two.
+TEST( SharedMapReader, KeyframesAreConsistentUnderConcurrentWrites )
+{
+  const Configuration conf( mapConf() );
+  const std::string name( regionName( "keyframes" ) );
+  SharedMemoryOutput3DWrapper writer( name, conf, 4, 4 );
+  ASSERT_TRUE( writer.valid() );
+
+  SharedMapReader reader;
+  ASSERT_TRUE( reader.open( name ) );
+
+  const int numIds = 8;
+  const size_t planeBytes = Width*Height*sizeof(float);
+  std::vector<Frame::SharedPtr> keyframes;
+  for( int id = 0; id < numIds; ++id ) keyframes.push_back( makeKeyframe( conf, id ) );
+
+  const int count = 5000;
+  std::atomic<bool> done( false );
+  std::thread writerThread( [&]() {
+    for( int i = 0; i < count; ++i ) writer.publishKeyframe( keyframes[i % numIds] );
+    done = true;
+  });
+
+  int checked = 0;
+  std::vector<float> idepth( Width*Height ), idepthVar( Width*Height );
+  std::vector<SharedMapReader::KeyframeView> views;
+  while( !done ) {
+    reader.keyframes( views );
+    for( const SharedMapReader::KeyframeView &view : views ) {
+      memcpy( idepth.data(), view.idepth, planeBytes );
+      memcpy( idepthVar.data(), view.idepthVar, planeBytes );
+      if( !view.valid() ) continue;
+
+      ASSERT_GE( view.frameId, 0 );
+      ASSERT_LT( view.frameId, numIds );
+      const Frame::SharedPtr &kf = keyframes[view.frameId];
+      ASSERT_EQ( view.timestamp, kf->timestamp() );
+      ASSERT_EQ( memcmp( idepth.data(), kf->idepth(0), planeBytes ), 0 ) << "torn keyframe " << view.frameId;
+      ASSERT_EQ( memcmp( idepthVar.data(), kf->idepthVar(0), planeBytes ), 0 ) << "torn keyframe " << view.frameId;
+      ++checked;
+    }
+  }
+  writerThread.join();
+
+  ASSERT_GT( checked, 0 );
+
+  // at rest, the ring holds the last keyframes published, newest first.
+  ASSERT_EQ( reader.keyframes( views ), 4u );
+  ASSERT_EQ( views.front().frameId, (count - 1) % numIds );
+  for( const SharedMapReader::KeyframeView &view : views ) ASSERT_TRUE( view.valid() );
+}
@@ -0,0 +1,134 @@
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+#include "DataStructures/TrackedFrameQueue.h"
+
+using namespace lsd_slam;
+
+namespace {
+
+  const int Width = 64, Height = 48;
+
+  Configuration queueConf()
+  {
+    Configuration conf;
+    conf.slamImage = SlamImageSize( Width, Height );
+    conf.camera = Camera( 50, 50, 32, 24 );
+    conf.camera.K << 50, 0, 32, 0, 50, 24, 0, 0, 1;
+    conf.camera.Kinv = conf.camera.K.inverse();
+    return conf;
+  }
+
+  // frames with the given baseline to their (absent) tracking parent.
+  Frame::SharedPtr makeFrame( const Configuration &conf, int id, double baseline = 0 )
+  {
+    std::vector<float> image( Width*Height, 0.f );
+    Frame::SharedPtr frame( new Frame( id, conf, id * 0.1, image.data() ) );
+    frame->pose->thisToParent_raw.translation() = Sophus::Vector3d( baseline, 0, 0 );
+    return frame;
+  }
+
+  std::vector<int> ids( const TrackedFrameQueue &queue )
+  {
+    std::vector<int> result;
+    for( const Frame::SharedPtr &frame : queue.batch() ) result.push_back( frame->id() );
+    return result;
+  }
+
+}
+
+TEST( TrackedFrameQueue, BatchIsAViewOfTheQueue )
+{
+  Configuration conf( queueConf() );
+  TrackedFrameQueue queue( 4, Configuration::MAPPING_QUEUE_DROP_OLDEST );
+
+  for( int i = 0; i < 3; ++i ) ASSERT_TRUE( queue.push( makeFrame( conf, i ) ) );
+
+  TrackedFrameQueue::Batch batch = queue.batch();
+  ASSERT_EQ( batch.size(), 3u );
+  ASSERT_EQ( batch.front()->id(), 0 );
+  ASSERT_EQ( batch.back()->id(), 2 );
+
+  // the producer may keep pushing while the consumer maps a batch.
+  ASSERT_TRUE( queue.push( makeFrame( conf, 3 ) ) );
+  ASSERT_EQ( batch.size(), 3u );
+  ASSERT_EQ( ids( queue ), std::vector<int>({ 0, 1, 2, 3 }) );
+
+  ASSERT_EQ( queue.popFront()->id(), 0 );
+  ASSERT_EQ( ids( queue ), std::vector<int>({ 1, 2, 3 }) );
+  ASSERT_EQ( queue.highWater(), 4 );
+
+  queue.clear();
+  ASSERT_TRUE( queue.empty() );
+  ASSERT_FALSE( (bool)queue.popFront() );
+}
+
+TEST( TrackedFrameQueue, DropOldestTrimsToBound )
+{
+  Configuration conf( queueConf() );
+  TrackedFrameQueue queue( 3, Configuration::MAPPING_QUEUE_DROP_OLDEST );
+
+  for( int i = 0; i < 5; ++i ) ASSERT_TRUE( queue.push( makeFrame( conf, i ) ) );
+  ASSERT_EQ( queue.size(), 5u );
+
+  ASSERT_EQ( queue.trim(), 2 );
+  ASSERT_EQ( ids( queue ), std::vector<int>({ 2, 3, 4 }) );
+  ASSERT_EQ( queue.dropped(), 2 );
+
+  ASSERT_EQ( queue.trim(), 0 );
+}
+
+TEST( TrackedFrameQueue, BestBaselineKeepsWidestAndNewest )
+{
+  Configuration conf( queueConf() );
+  TrackedFrameQueue queue( 3, Configuration::MAPPING_QUEUE_BEST_BASELINE );
+
+  const double baselines[] = { 0.5, 0.1, 0.4, 0.2, 0.0 };
+  for( int i = 0; i < 5; ++i ) ASSERT_TRUE( queue.push( makeFrame( conf, i, baselines[i] ) ) );
+
+  ASSERT_EQ( queue.trim(), 2 );
+
+  // the newest frame stays regardless of its baseline; the rest keep their order.
+  ASSERT_EQ( ids( queue ), std::vector<int>({ 0, 2, 4 }) );
+}
+
+TEST( TrackedFrameQueue, NonBlockingPushDropsOnlyWhenRingIsFull )
+{
+  Configuration conf( queueConf() );
+  TrackedFrameQueue queue( 2, Configuration::MAPPING_QUEUE_BLOCK );
+
+  // the ring holds twice the bound.
+  for( int i = 0; i < 4; ++i ) ASSERT_TRUE( queue.push( makeFrame( conf, i ), false ) );
+  ASSERT_FALSE( queue.push( makeFrame( conf, 4 ), false ) );
+  ASSERT_EQ( queue.dropped(), 1 );
+
+  // trim() never drops with the blocking policy.
+  ASSERT_EQ( queue.trim(), 0 );
+  ASSERT_EQ( queue.size(), 4u );
+}
+
+TEST( TrackedFrameQueue, BlockingPushWaitsForConsumer )
+{
+  Configuration conf( queueConf() );
+  TrackedFrameQueue queue( 2, Configuration::MAPPING_QUEUE_BLOCK );
+
+  const int count = 50;
+  std::thread producer( [&]() {
+    for( int i = 0; i < count; ++i ) queue.push( makeFrame( conf, i ) );
+  });
+
+  for( int i = 0; i < count; ++i ) {
+    while( queue.empty() ) std::this_thread::yield();
+    ASSERT_LE( queue.size(), 2u );
+    ASSERT_EQ( queue.popFront()->id(), i );
+  }
+  producer.join();
+
+  queue.waitUntilEmpty();
+  ASSERT_EQ( queue.pushed(), count );
+  ASSERT_EQ( queue.dropped(), 0 );
+  ASSERT_LE( queue.highWater(), 2 );
+}
@@ -0,0 +1,137 @@
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "GlobalMapping/TrajectoryStore.h"
+#include "DataStructures/Frame.h"
+
+using namespace lsd_slam;
+
+namespace {
+
+  const int Width = 32, Height = 24;
+
+  Configuration trajectoryConf()
+  {
+    Configuration conf;
+    conf.slamImage = SlamImageSize( Width, Height );
+    conf.camera = Camera( 30, 30, 16, 12 );
+    conf.camera.K << 30, 0, 16, 0, 30, 12, 0, 0, 1;
+    conf.camera.Kinv = conf.camera.K.inverse();
+    return conf;
+  }
+
+  // a tree of tracked frames: each one is tracked on one of the few
+  // frames before it, so chains are long but branch.
+  struct Trajectory {
+    Configuration conf;
+    std::vector<Frame::SharedPtr> frames;
+    std::mt19937 rng;
+
+    Trajectory() : conf( trajectoryConf() ), rng( 23 ) {}
+
+    double uniform( double lo, double hi ) { return std::uniform_real_distribution<double>( lo, hi )( rng ); }
+
+    Sim3 randomMotion()
+    {
+      Eigen::Vector3d axis( uniform( -1, 1 ), uniform( -1, 1 ), uniform( -1, 1 ) );
+      Eigen::Quaterniond q( Eigen::AngleAxisd( uniform( 0, 0.1 ), axis.normalized() ) );
+      return Sim3( Sophus::RxSO3d( uniform( 0.99, 1.01 ), q.toRotationMatrix() ),
+                   Eigen::Vector3d( uniform( -0.1, 0.1 ), uniform( -0.1, 0.1 ), uniform( -0.1, 0.1 ) ) );
+    }
+
+    void addFrames( int count )
+    {
+      std::vector<float> image( Width*Height, 0.f );
+      for( int i = 0; i < count; ++i ) {
+        const int id = frames.size();
+        Frame::SharedPtr f( new Frame( id, conf, id, image.data() ) );
+        if( id > 0 ) {
+          f->setTrackingParent( frames[std::max( 0, id - 1 - (int)uniform( 0, 4 ) )] );
+          f->pose->thisToParent_raw = randomMotion();
+        }
+        frames.push_back( f );
+      }
+    }
+  };
+
+  // the definition getCamToWorld() and the store have to agree with:
+  // a pinned pose, or the parent's pose times thisToParent_raw.
+  Sim3 recursiveCamToWorld( Frame &frame, const PoseSnapshot *poses = nullptr )
+  {
+    Sim3 camToWorld;
+    if( poses && poses->find( frame.id(), camToWorld ) ) return camToWorld;
+    if( !frame.hasTrackingParent() ) return Sim3();
+    return recursiveCamToWorld( *frame.trackingParent(), poses ) * frame.pose->thisToParent_raw;
+  }
+
+  ::testing::AssertionResult samePose( const Sim3 &a, const Sim3 &b )
+  {
+    const double diff = (a.matrix() - b.matrix()).cast<double>().norm();
+    if( diff <= 1e-4 * (1 + b.matrix().cast<double>().norm()) ) return ::testing::AssertionSuccess();
+    return ::testing::AssertionFailure() << "poses differ by " << diff;
+  }
+
+}
+
+TEST( FramePoseStruct, GetCamToWorldMatchesRecursive )
+{
+  Trajectory trajectory;
+  trajectory.addFrames( 500 );
+
+  // deepest first, so the first call walks the whole chain.
+  for( int i = trajectory.frames.size() - 1; i >= 0; --i )
+    ASSERT_TRUE( samePose( trajectory.frames[i]->getCamToWorld(), recursiveCamToWorld( *trajectory.frames[i] ) ) ) << "frame " << i;
+
+  // changing one thisToParent_raw moves the frames tracked on it.
+  Frame &moved = *trajectory.frames[200];
+  moved.pose->thisToParent_raw = trajectory.randomMotion();
+  moved.pose->invalidateCache();
+
+  for( size_t i = 0; i < trajectory.frames.size(); ++i )
+    ASSERT_TRUE( samePose( trajectory.frames[i]->getCamToWorld(), recursiveCamToWorld( *trajectory.frames[i] ) ) ) << "frame " << i;
+}
+
+TEST( TrajectoryStore, MatchesRecursiveCamToWorld )
+{
+  Trajectory trajectory;
+  TrajectoryStore store;
+
+  trajectory.addFrames( 300 );
+  for( const Frame::SharedPtr &f : trajectory.frames ) store.add( f->pose );
+
+  PoseSnapshot none( 0 );
+  store.update( none );
+  ASSERT_EQ( store.size(), 300 );
+  for( int i = 0; i < store.size(); ++i )
+    ASSERT_TRUE( samePose( store.getCamToWorld( i ), recursiveCamToWorld( *trajectory.frames[i] ) ) ) << "frame " << i;
+
+  // a new snapshot pins some frames, and everything tracked on them follows.
+  PoseSnapshot optimized( 1 );
+  for( int i = 0; i < 300; i += 37 ) optimized.set( i, trajectory.randomMotion() );
+  store.update( optimized );
+  for( int i = 0; i < store.size(); ++i )
+    ASSERT_TRUE( samePose( store.getCamToWorld( i ), recursiveCamToWorld( *trajectory.frames[i], &optimized ) ) ) << "frame " << i;
+
+  // frames added under the same version are computed incrementally.
+  trajectory.addFrames( 100 );
+  for( size_t i = 300; i < trajectory.frames.size(); ++i ) store.add( trajectory.frames[i]->pose );
+  ASSERT_EQ( store.size(), 300 );
+  store.update( optimized );
+  ASSERT_EQ( store.size(), 400 );
+
+  // as are changes to a thisToParent_raw.
+  Frame &moved = *trajectory.frames[150];
+  moved.pose->thisToParent_raw = trajectory.randomMotion();
+  moved.pose->invalidateCache();
+  store.update( optimized );
+
+  std::vector<Sim3, Eigen::aligned_allocator<Sim3> > all;
+  store.getAll( all );
+  ASSERT_EQ( all.size(), 400u );
+  for( size_t i = 0; i < all.size(); ++i )
+    ASSERT_TRUE( samePose( all[i], recursiveCamToWorld( *trajectory.frames[i], &optimized ) ) ) << "frame " << i;
+}
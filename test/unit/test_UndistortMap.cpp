@@ -0,0 +1,82 @@
+
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "util/UndistortMap.h"
+
+using namespace lsd_slam;
+
+namespace {
+
+  std::vector<unsigned char> randomImage( const ImageSize &size )
+  {
+    std::vector<unsigned char> image( size.area() );
+    srand( 42 );
+    for( auto &p : image ) p = rand() & 0xFF;
+    return image;
+  }
+
+  // the SIMD kernel (where built) and the plain loop must agree exactly.
+  void expectSimdMatchesScalar( const UndistortMap &map )
+  {
+    std::vector<unsigned char> in( randomImage( map.inputSize() ) );
+    std::vector<float> simd( map.outputSize().area() ), scalar( map.outputSize().area() ), threaded( map.outputSize().area() );
+
+    map.remap( in.data(), simd.data() );
+    map.remapScalar( in.data(), scalar.data() );
+    map.remap( in.data(), threaded.data(), 4 );
+
+    for( size_t i = 0; i < scalar.size(); ++i ) {
+      ASSERT_EQ( simd[i], scalar[i] ) << "at pixel " << i;
+      ASSERT_EQ( threaded[i], scalar[i] ) << "at pixel " << i;
+    }
+  }
+
+}
+
+// without distortion and with the input camera as output camera, every
+// output pixel samples its input pixel with zero fractions.
+TEST( UndistortMap, IdentityCopiesInput )
+{
+  const ImageSize size( 61, 37 );
+  const std::vector<float> calibration = { 50, 50, 30, 18, 0, 0, 0, 0 };
+  UndistortMap map( calibration, size, Camera( 50, 50, 30, 18 ), size );
+
+  std::vector<unsigned char> in( randomImage( size ) );
+  std::vector<float> out( size.area() );
+  map.remap( in.data(), out.data() );
+
+  for( int i = 0; i < size.area(); ++i )
+    ASSERT_EQ( out[i], (float)in[i] ) << "at pixel " << i;
+}
+
+TEST( UndistortMap, FovSimdMatchesScalar )
+{
+  const std::vector<float> calibration = { 0.6, 0.8, 0.5, 0.5, 0.9 };
+  expectSimdMatchesScalar( UndistortMap( calibration, ImageSize( 160, 120 ), Camera( 90, 90, 63, 47 ), ImageSize( 127, 95 ) ) );
+}
+
+TEST( UndistortMap, RadTanSimdMatchesScalar )
+{
+  const std::vector<float> calibration = { 200, 200, 80, 60, -0.3, 0.1, 0.001, -0.002 };
+  expectSimdMatchesScalar( UndistortMap( calibration, ImageSize( 160, 120 ), Camera( 180, 180, 64, 48 ), ImageSize( 128, 96 ) ) );
+}
+
+// output pixels beyond the input image are 0, on both paths.
+TEST( UndistortMap, OutsideInputIsZero )
+{
+  const std::vector<float> calibration = { 100, 100, 40, 30, 0, 0, 0, 0 };
+  UndistortMap map( calibration, ImageSize( 80, 60 ), Camera( 50, 50, 60, 45 ), ImageSize( 120, 90 ) );
+
+  std::vector<unsigned char> in( 80*60, 200 );
+  std::vector<float> out( 120*90 );
+  map.remap( in.data(), out.data() );
+
+  ASSERT_EQ( out[0], 0.f );
+  ASSERT_EQ( out[120*90 - 1], 0.f );
+  ASSERT_EQ( out[45*120 + 60], 200.f );
+
+  expectSimdMatchesScalar( map );
+}
@@ -38,6 +38,7 @@
 
 #include "App/App.h"
 #include "App/InputThread.h"
+#include "IOWrapper/SharedMemoryOutput3DWrapper.h"
 #include "ParseArgs.h"
 
 
@@ -57,14 +58,22 @@ int main( int argc, char** argv )
   conf.slamImage  = args.undistorter->outputImageSize();
   conf.camera     = args.undistorter->getCamera();
 
+  args.applyTo( conf );
+
   LOG(INFO) << "Slam image: " << conf.slamImage.width << " x " << conf.slamImage.height;
 
   CHECK( (conf.camera.fx) > 0 && (conf.camera.fy > 0) ) << "Camera focal length is zero";
 
 	std::shared_ptr<SlamSystem> system( new SlamSystem(conf) );
 
+  if( !args.shmName.empty() ) {
+    std::shared_ptr<SharedMemoryOutput3DWrapper> shm( new SharedMemoryOutput3DWrapper( args.shmName, conf ) );
+    if( shm->valid() ) system->set3DOutputWrapper( shm );
+  }
+
   LOG(INFO) << "Starting input thread.";
   InputThread input( system, args.dataSource, args.undistorter );
+  input.setUndistortMap( args.undistortMap );
   boost::thread inputThread( boost::ref(input) );
   input.inputReady.wait();
 
@@ -0,0 +1,105 @@
+/**
+*  Converts a folder of images into a raw frame file (see
+*  lib/IOWrapper/RawFrameFile.h), which LSD replays memory-mapped
+*  instead of decoding every image:
+*
+*    MakeRawFrames -f FOLDER -o OUTPUT [-r FPS]
+*
+*  Without -r, the timestamps are 0.03 s apart, like those LSD makes up
+*  for image folders. Colour images are converted to grayscale; images
+*  of another depth, or of another size than the first, are skipped.
+*/
+
+#include "util/Parse.h"
+
+#include "libvideoio/ImageSource.h"
+
+#include "IOWrapper/RawFrameFile.h"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <boost/filesystem.hpp>
+#include <g3log/g3log.hpp>
+#include "libg3logger/g3logger.h"
+
+using namespace lsd_slam;
+
+namespace fs = boost::filesystem;
+
+int main( int argc, char** argv )
+{
+  libg3logger::G3Logger logWorker( argv[0] );
+
+  std::string source, output, rate;
+  if( !(Parse::arg(argc, argv, "-f", source) > 0) || !(Parse::arg(argc, argv, "-o", output) > 0) )
+  {
+    printf("usage: %s -f FOLDER -o OUTPUT [-r FPS]\n", argv[0]);
+    exit(0);
+  }
+
+  double fps = 0;
+  if( Parse::arg(argc, argv, "-r", rate) > 0 ) fps = atof( rate.c_str() );
+
+  std::vector<fs::path> files;
+  if( getdir(source, files) < 0 || files.empty() )
+  {
+    printf("could not load file list from %s! wrong path / file?\n", source.c_str());
+    exit(1);
+  }
+
+  libvideoio::ImageFilesSource images( files );
+  RawFrameWriter writer;
+
+  cv::Mat image;
+  int n = 0, width = 0, height = 0;
+  for( int i = 0; images.grab(); ++i )
+  {
+    if( images.getImage( image ) < 0 ) {
+      LOG(WARNING) << "Could not read image " << i << ", skipping it";
+      continue;
+    }
+
+    if( image.depth() != CV_8U || (image.channels() != 1 && image.channels() != 3 && image.channels() != 4) ) {
+      LOG(WARNING) << "Image " << i << " isn't 8 bit grayscale or colour, skipping it";
+      continue;
+    }
+
+    if( image.channels() == 3 )
+      cv::cvtColor( image, image, CV_BGR2GRAY );
+    else if( image.channels() == 4 )
+      cv::cvtColor( image, image, CV_BGRA2GRAY );
+
+    if( n == 0 ) {
+      if( !writer.open( output, image.cols, image.rows, fps ) ) {
+        printf("could not open %s for writing!\n", output.c_str());
+        exit(1);
+      }
+      width = image.cols;
+      height = image.rows;
+    } else if( image.cols != width || image.rows != height ) {
+      LOG(WARNING) << "Image " << i << " is " << image.cols << "x" << image.rows
+                   << ", not " << width << "x" << height << ", skipping it";
+      continue;
+    }
+
+    if( !writer.write( image, (fps > 0) ? n / fps : n * 0.03 ) ) {
+      printf("error writing to %s!\n", output.c_str());
+      exit(1);
+    }
+    ++n;
+  }
+
+  if( n == 0 )
+  {
+    printf("no images written: found no readable 8 bit images in %s!\n", source.c_str());
+    exit(1);
+  }
+
+  if( !writer.close() ) {
+    printf("error writing to %s!\n", output.c_str());
+    exit(1);
+  }
+
+  LOG(INFO) << "Wrote " << n << " of " << files.size() << " images to " << output;
+  return 0;
+}
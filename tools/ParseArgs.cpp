@@ -3,6 +3,9 @@
 
 #include "ParseArgs.h"
 
+#include "IOWrapper/RawFrameSource.h"
+#include "util/settings.h"
+
 #include <boost/filesystem.hpp>
 
 
@@ -16,7 +19,12 @@ namespace lsd_slam {
 
   ParseArgs::ParseArgs( int argc, char **argv )
     : dataSource( nullptr ),
-      undistorter( nullptr )
+      undistorter( nullptr ),
+      undistortMap( nullptr ),
+      pipelined( false ),
+      loadShedding( false ),
+      trackingBudgetMs( 0 ),
+      pointBudget( 0 )
   {
 
     std::string calibFile;
@@ -31,14 +39,53 @@ namespace lsd_slam {
 
     CHECK( undistorter != NULL ) << "Could not create undistorter.";
 
+    if( Parse::flag(argc, argv, "--fast-undistort") )
+    {
+      undistortMap.reset( UndistortMap::fromCalibFile( calibFile, undistorter->getCamera(), undistorter->outputImageSize() ) );
+
+      if( undistortMap &&
+          (undistortMap->inputSize().width != undistorter->inputImageSize().width ||
+           undistortMap->inputSize().height != undistorter->inputImageSize().height) ) {
+        LOG(WARNING) << "Input size in " << calibFile << " doesn't match the undistorter's, not using the fused undistortion";
+        undistortMap.reset();
+      }
+    }
+
+    pipelined = Parse::flag(argc, argv, "--pipelined");
+    loadShedding = Parse::flag(argc, argv, "--load-shedding");
+
+    // a global setting, not part of Configuration
+    if( Parse::flag(argc, argv, "--thumbnail-index") ) useThumbnailIndex = true;
+
+    std::string budget;
+    if( Parse::arg(argc, argv, "--tracking-budget", budget) > 0 ) trackingBudgetMs = atof( budget.c_str() );
+    if( Parse::arg(argc, argv, "--point-budget", budget) > 0 ) pointBudget = atoi( budget.c_str() );
+
+    if( Parse::arg(argc, argv, "--shm", shmName) > 0 && shmName.empty() ) {
+      printf("--shm needs a name, e.g. --shm /lsdslam\n");
+      exit(0);
+    }
+
     // open image files: first try to open as file.
     std::string source;
     if(!(Parse::arg(argc, argv, "-f", source) > 0))
     {
-      printf("need source files! (set using -f FOLDER or KLG)\n");
+      printf("need source files! (set using -f FOLDER, KLG or raw frame file)\n");
       exit(0);
     }
 
+    if( RawFrameSource::isRawFrameFile(source) )
+    {
+      std::shared_ptr<RawFrameSource> rawSource( new RawFrameSource() );
+      if( !rawSource->open(source) )
+      {
+        printf("could not replay raw frame file %s!\n", source.c_str());
+        exit(1);
+      }
+      dataSource = rawSource;
+      return;
+    }
+
     std::vector<fs::path> files;
 
     if( getdir(source, files) >= 0)
@@ -56,5 +103,13 @@ namespace lsd_slam {
 
   }
 
+  void ParseArgs::applyTo( Configuration &conf ) const
+  {
+    conf.offlinePipelined = pipelined;
+    conf.adaptiveLoadShedding = loadShedding;
+    conf.trackingTimeBudgetMs = trackingBudgetMs;
+    conf.trackingPointBudget = pointBudget;
+  }
+
 
 }
@@ -5,6 +5,9 @@
 #include "libvideoio/ImageSource.h"
 #include "libvideoio/Undistorter.h"
 
+#include "util/UndistortMap.h"
+#include "util/Configuration.h"
+
 namespace lsd_slam {
 
 struct ParseArgs {
@@ -14,6 +17,32 @@ struct ParseArgs {
   std::shared_ptr<libvideoio::ImageSource> dataSource;
   std::shared_ptr<libvideoio::Undistorter> undistorter;
 
+  // set with --fast-undistort, if the calibration's model is supported.
+  std::shared_ptr<UndistortMap> undistortMap;
+
+  // --pipelined: offline input overlaps tracking and mapping instead of
+  // alternating.
+  bool pipelined;
+
+  // --load-shedding: drop frames and track coarser while mapping lags
+  // behind (Configuration::adaptiveLoadShedding).
+  bool loadShedding;
+
+  // --tracking-budget MS: per-frame time budget of odometry tracking
+  // (Configuration::trackingTimeBudgetMs), 0 = unlimited.
+  float trackingBudgetMs;
+
+  // --point-budget N: max. tracked points on the finest level
+  // (Configuration::trackingPointBudget), 0 = all.
+  int pointBudget;
+
+  // --shm NAME: publish the map for consumers in other processes (see
+  // SharedMapReader). Empty if not given.
+  std::string shmName;
+
+  // Sets the Configuration fields given on the command line.
+  void applyTo( Configuration &conf ) const;
+
 };
 
 